@@ -0,0 +1,65 @@
+#!/bin/sh
+# Times bosh in batch mode over a set of core files and reports how
+# many cores a minute it gets through.
+#
+#   batch-rate.sh [-n RUNS] [-x FILE] EXE CORE...
+#
+# Each core is loaded with "bosh --batch EXE CORE" running the commands
+# in FILE, or "backtrace" by default, with the output thrown away.  The whole set is gone through RUNS times (default 1).
+# BOSH names the bosh to run, by default the one in ../bosh.
+
+: ${BOSH:=`dirname $0`/../bosh/bosh}
+
+runs=1
+commands=
+
+usage ()
+{
+  echo "Usage: $0 [-n RUNS] [-x FILE] EXE CORE..." >&2
+  exit 1
+}
+
+while test $# -gt 0; do
+  case "$1" in
+    -n) test $# -ge 2 || usage; runs=$2; shift 2 ;;
+    -x) test $# -ge 2 || usage; commands=$2; shift 2 ;;
+    -*) usage ;;
+    *) break ;;
+  esac
+done
+test $# -ge 2 || usage
+
+exe=$1
+shift
+
+now_ns ()
+{
+  date +%s%N
+}
+
+n=0
+failed=0
+start=`now_ns`
+run=0
+while test $run -lt $runs; do
+  for core in "$@"; do
+    if test -n "$commands"; then
+      $BOSH --batch -x "$commands" "$exe" "$core" > /dev/null 2>&1
+    else
+      $BOSH --batch --ex backtrace "$exe" "$core" > /dev/null 2>&1
+    fi
+    test $? -eq 0 || failed=`expr $failed + 1`
+    n=`expr $n + 1`
+  done
+  run=`expr $run + 1`
+done
+end=`now_ns`
+
+awk -v n=$n -v failed=$failed -v ns=`expr $end - $start` 'BEGIN {
+  s = ns / 1e9;
+  printf "%d cores in %.3f s: %.1f ms/core, %.1f cores/min\n",
+         n, s, s * 1000 / n, n * 60 / s;
+  if (failed)
+    printf "%d runs failed\n", failed;
+}'
+test $failed -eq 0
@@ -0,0 +1,695 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Microbenchmarks for the command line hot paths.
+ *
+ * "make bench" builds and runs them all.  Each benchmark is run in
+ * batches big enough to be timed reliably and we report the mean time
+ * per operation along with percentiles over the batches, plus how many
+ * glib allocations each operation makes.
+ *
+ *   bosh-bench [--filter PATTERN] [--samples N]
+ *              [--json FILE] [--baseline FILE] [--threshold PERCENT]
+ *
+ * --json saves the results, and a saved file can be given back with
+ * --baseline to see what changed.  A benchmark whose median got slower
+ * by more than the threshold, or that allocates more than it used to,
+ * is a regression and makes us exit with a non zero status. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib-object.h>
+#include <json-glib/json-glib.h>
+
+#include <gswat/gswat.h>
+
+#include "cli-decode.h"
+#include "cli-setshow.h"
+#include "completer.h"
+
+#include "bosh-commands.h"
+#include "bosh-main.h"
+#include "bosh-maint.h"
+#include "bosh-utils.h"
+
+/* Each batch should take at least this long to keep clock overhead
+ * out of the numbers */
+#define BENCH_MIN_BATCH_NS 1000000
+#define BENCH_HUGE_FILE_LINES 200000
+
+typedef struct _BenchCase
+{
+  const char *name;
+  gboolean (*setup) (void);
+  void (*run) (void);
+  void (*teardown) (void);
+} BenchCase;
+
+typedef struct _BenchResult
+{
+  const char *name;
+  guint64 ops;
+  double ns_per_op;
+  double p50;
+  double p90;
+  double p99;
+  /* Negative if allocations can't be counted */
+  double allocs_per_op;
+  double bytes_per_op;
+} BenchResult;
+
+/* bosh-main.c isn't linked in, so we provide what the rest of bosh
+ * expects from it */
+GSwatDebuggable *_bosh_current_debuggable;
+guint bosh_debug_flags;
+
+GSwatDebuggable *
+bosh_get_default_debuggable (void)
+{
+  return _bosh_current_debuggable;
+}
+
+int
+bosh_get_target_pid (void)
+{
+  return -1;
+}
+
+void
+bosh_main_watch_debuggable (GSwatDebuggable *debuggable)
+{
+}
+
+void
+bosh_main_step_finished (GSwatDebuggable *debuggable)
+{
+}
+
+static char *filter = NULL;
+static int n_samples = 100;
+static char *json_filename = NULL;
+static char *baseline_filename = NULL;
+static double threshold = 10;
+
+static GOptionEntry bench_args[] = {
+      { "filter", 0, 0, G_OPTION_ARG_STRING, &filter,
+        "Only run benchmarks matching PATTERN", "PATTERN" },
+      { "samples", 0, 0, G_OPTION_ARG_INT, &n_samples,
+        "Number of timed batches per benchmark (default: 100)", "N" },
+      { "json", 0, 0, G_OPTION_ARG_FILENAME, &json_filename,
+        "Save the results to FILE", "FILE" },
+      { "baseline", 0, 0, G_OPTION_ARG_FILENAME, &baseline_filename,
+        "Compare against results saved with --json", "FILE" },
+      { "threshold", 0, 0, G_OPTION_ARG_DOUBLE, &threshold,
+        "Slowdown in percent that counts as a regression (default: 10)",
+        "PERCENT" },
+      { NULL, },
+};
+
+static gboolean alloc_counting;
+
+static void
+discard_print (const gchar *string)
+{
+}
+
+static guint64
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (guint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * The benchmarks
+ */
+
+static char lookup_line[] = "info inferiors";
+static char lookup_prefix_line[] = "show output-format";
+
+static void
+bench_lookup_cmd_1 (void)
+{
+  struct cmd_list_element *result_list = NULL;
+  char *line = lookup_line;
+
+  lookup_cmd_1 (&line, cmdlist, &result_list, 1);
+}
+
+static void
+bench_lookup_command (void)
+{
+  char *line = lookup_prefix_line;
+
+  bosh_lookup_command (&line, cmdlist, "", 0, NULL);
+}
+
+static char complete_buffer[] = "info s";
+
+static void
+bench_complete_line (void)
+{
+  g_strfreev (complete_line ("s", complete_buffer, 6));
+}
+
+static void
+bench_complete_on_cmdlist (void)
+{
+  g_strfreev (complete_on_cmdlist (cmdlist, "s", "s"));
+}
+
+static char *small_file;
+static char *small_uri;
+static char *huge_file;
+static char *huge_uri;
+
+static char *
+write_source_file (int n_lines, char **uri)
+{
+  GError *error = NULL;
+  char *filename;
+  FILE *file;
+  int fd;
+  int i;
+
+  fd = g_file_open_tmp ("bosh-bench-XXXXXX.c", &filename, &error);
+  if (fd < 0)
+    {
+      fprintf (stderr, "%s\n", error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  file = fdopen (fd, "w");
+  for (i = 1; i <= n_lines; i++)
+    fprintf (file, "  result = compute_something (state, %d, \"line\");\n",
+             i);
+  fclose (file);
+
+  *uri = g_filename_to_uri (filename, NULL, NULL);
+  return filename;
+}
+
+static gboolean
+setup_small_file (void)
+{
+  small_file = write_source_file (40, &small_uri);
+  return small_file != NULL;
+}
+
+static void
+bench_print_file_range_small (void)
+{
+  bosh_utils_print_file_range (small_uri, 15, 25);
+}
+
+static void
+teardown_small_file (void)
+{
+  g_unlink (small_file);
+  g_free (small_file);
+  g_free (small_uri);
+}
+
+static gboolean
+setup_huge_file (void)
+{
+  huge_file = write_source_file (BENCH_HUGE_FILE_LINES, &huge_uri);
+  return huge_file != NULL;
+}
+
+/* Listing near the end of a big file, which is the worst case since
+ * everything before it has to be read */
+static void
+bench_print_file_range_huge (void)
+{
+  bosh_utils_print_file_range (huge_uri,
+                               BENCH_HUGE_FILE_LINES - 10,
+                               BENCH_HUGE_FILE_LINES);
+}
+
+static void
+teardown_huge_file (void)
+{
+  g_unlink (huge_file);
+  g_free (huge_file);
+  g_free (huge_uri);
+}
+
+static struct cmd_list_element *set_output_format_cmd;
+static struct cmd_list_element *set_height_cmd;
+static struct cmd_list_element *show_output_format_cmd;
+
+static struct cmd_list_element *
+lookup_setting (struct cmd_list_element *list, const char *name)
+{
+  char *copy = g_strdup (name);
+  char *line = copy;
+  struct cmd_list_element *c = bosh_lookup_command (&line, list, "",
+                                                    0, NULL);
+  g_free (copy);
+  return c;
+}
+
+static gboolean
+setup_setshow (void)
+{
+  set_output_format_cmd = lookup_setting (setlist, "output-format");
+  set_height_cmd = lookup_setting (setlist, "height");
+  show_output_format_cmd = lookup_setting (showlist, "output-format");
+
+  return set_output_format_cmd && set_height_cmd && show_output_format_cmd;
+}
+
+static void
+bench_setshow_enum (void)
+{
+  char arg[] = "text";
+
+  do_setshow_command (arg, 0, set_output_format_cmd);
+}
+
+static void
+bench_setshow_uinteger (void)
+{
+  char arg[] = "0";
+
+  do_setshow_command (arg, 0, set_height_cmd);
+}
+
+static void
+bench_setshow_show (void)
+{
+  do_setshow_command (NULL, 0, show_output_format_cmd);
+}
+
+static GSwatDebuggableFrame bench_frame;
+
+static gboolean
+setup_frame (void)
+{
+  static const char *args[][2] = {
+        { "self", "0x8051f40" },
+        { "name", "0x8049a2c \"bosh\"" },
+        { "flags", "3" },
+  };
+  int i;
+
+  if (bench_frame.function)
+    return TRUE;
+
+  bench_frame.level = 3;
+  bench_frame.function = "compute_something";
+  bench_frame.source_uri = "file:///usr/src/bosh/bosh/bosh-commands.c";
+  bench_frame.line = 1234;
+
+  for (i = 0; i < G_N_ELEMENTS (args); i++)
+    {
+      GSwatDebuggableFrameArgument *arg =
+        g_new0 (GSwatDebuggableFrameArgument, 1);
+      arg->name = (char *)args[i][0];
+      arg->value = (char *)args[i][1];
+      bench_frame.arguments = g_list_append (bench_frame.arguments, arg);
+    }
+
+  return TRUE;
+}
+
+static void
+bench_print_frame (void)
+{
+  bosh_utils_print_frame (&bench_frame);
+}
+
+static gboolean
+setup_frame_json (void)
+{
+  char command[] = "set output-format json";
+
+  bosh_execute_command (command, 0);
+  return setup_frame ();
+}
+
+static void
+teardown_frame_json (void)
+{
+  char command[] = "set output-format text";
+
+  bosh_execute_command (command, 0);
+}
+
+static const BenchCase bench_cases[] = {
+      { "lookup_cmd_1", NULL, bench_lookup_cmd_1, NULL },
+      { "bosh_lookup_command", NULL, bench_lookup_command, NULL },
+      { "complete_line", NULL, bench_complete_line, NULL },
+      { "complete_on_cmdlist", NULL, bench_complete_on_cmdlist, NULL },
+      { "print_file_range/small", setup_small_file,
+        bench_print_file_range_small, teardown_small_file },
+      { "print_file_range/huge", setup_huge_file,
+        bench_print_file_range_huge, teardown_huge_file },
+      { "do_setshow_command/enum", setup_setshow, bench_setshow_enum, NULL },
+      { "do_setshow_command/uinteger", setup_setshow,
+        bench_setshow_uinteger, NULL },
+      { "do_setshow_command/show", setup_setshow, bench_setshow_show, NULL },
+      { "print_frame/text", setup_frame, bench_print_frame, NULL },
+      { "print_frame/json", setup_frame_json, bench_print_frame,
+        teardown_frame_json },
+};
+
+/*
+ * Running them
+ */
+
+static guint64
+time_batch (const BenchCase *bench, guint64 batch)
+{
+  guint64 start = now_ns ();
+  guint64 i;
+
+  for (i = 0; i < batch; i++)
+    bench->run ();
+
+  return now_ns () - start;
+}
+
+static int
+compare_doubles (const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static double
+percentile (const double *sorted, int n, double p)
+{
+  return sorted[(int)((n - 1) * p / 100 + 0.5)];
+}
+
+static gboolean
+bench_run (const BenchCase *bench, BenchResult *result)
+{
+  double *samples;
+  guint64 batch = 1;
+  guint64 elapsed;
+  guint64 total = 0;
+  guint64 allocs_before;
+  guint64 bytes_before;
+  guint64 allocs_after;
+  guint64 bytes_after;
+  int i;
+
+  if (bench->setup && !bench->setup ())
+    {
+      fprintf (stderr, "Failed to set up %s\n", bench->name);
+      return FALSE;
+    }
+
+  /* The first run warms up caches, then we find a batch size */
+  bench->run ();
+  while ((elapsed = time_batch (bench, batch)) < BENCH_MIN_BATCH_NS)
+    {
+      if (elapsed == 0)
+        batch *= 16;
+      else
+        batch = MAX (batch * 2, batch * BENCH_MIN_BATCH_NS / elapsed);
+    }
+
+  samples = g_new (double, n_samples);
+  bosh_maint_get_allocations (&allocs_before, &bytes_before);
+  for (i = 0; i < n_samples; i++)
+    {
+      elapsed = time_batch (bench, batch);
+      total += elapsed;
+      samples[i] = (double)elapsed / batch;
+    }
+  bosh_maint_get_allocations (&allocs_after, &bytes_after);
+
+  result->name = bench->name;
+  result->ops = batch * n_samples;
+  result->ns_per_op = (double)total / result->ops;
+  if (alloc_counting)
+    {
+      /* Allocations made by the timing itself (samples is already
+       * allocated) don't get in here */
+      result->allocs_per_op =
+        (double)(allocs_after - allocs_before) / result->ops;
+      result->bytes_per_op =
+        (double)(bytes_after - bytes_before) / result->ops;
+    }
+  else
+    result->allocs_per_op = result->bytes_per_op = -1;
+
+  qsort (samples, n_samples, sizeof (double), compare_doubles);
+  result->p50 = percentile (samples, n_samples, 50);
+  result->p90 = percentile (samples, n_samples, 90);
+  result->p99 = percentile (samples, n_samples, 99);
+  g_free (samples);
+
+  if (bench->teardown)
+    bench->teardown ();
+
+  return TRUE;
+}
+
+static JsonObject *
+lookup_baseline (JsonNode *baseline, const char *name)
+{
+  JsonArray *benchmarks;
+  guint i;
+
+  if (!baseline || JSON_NODE_TYPE (baseline) != JSON_NODE_OBJECT)
+    return NULL;
+
+  benchmarks = json_object_get_array_member (json_node_get_object (baseline),
+                                             "benchmarks");
+  if (!benchmarks)
+    return NULL;
+
+  for (i = 0; i < json_array_get_length (benchmarks); i++)
+    {
+      JsonObject *entry = json_array_get_object_element (benchmarks, i);
+      if (entry
+          && json_object_has_member (entry, "name")
+          && strcmp (json_object_get_string_member (entry, "name"),
+                     name) == 0)
+        return entry;
+    }
+
+  return NULL;
+}
+
+/* Prints how RESULT compares to BASELINE and returns TRUE if it's a
+ * regression */
+static gboolean
+print_comparison (const BenchResult *result, JsonObject *baseline)
+{
+  gboolean regressed = FALSE;
+  double old_p50;
+  double change;
+
+  if (!baseline || !json_object_has_member (baseline, "p50"))
+    {
+      printf ("  (new)");
+      return FALSE;
+    }
+
+  old_p50 = json_object_get_double_member (baseline, "p50");
+  change = old_p50 > 0 ? (result->p50 - old_p50) * 100 / old_p50 : 0;
+  printf ("  %+6.1f%%", change);
+  if (change > threshold)
+    regressed = TRUE;
+
+  if (result->allocs_per_op >= 0
+      && json_object_has_member (baseline, "allocs_per_op"))
+    {
+      double old_allocs =
+        json_object_get_double_member (baseline, "allocs_per_op");
+
+      if (old_allocs >= 0 && result->allocs_per_op > old_allocs + 0.5)
+        {
+          printf (" allocs %.1f->%.1f", old_allocs, result->allocs_per_op);
+          regressed = TRUE;
+        }
+    }
+
+  if (regressed)
+    printf (" REGRESSION");
+
+  return regressed;
+}
+
+static gboolean
+save_results (const char *filename, BenchResult *results, int n_results,
+              GError **error)
+{
+  JsonBuilder *builder = json_builder_new ();
+  JsonGenerator *generator;
+  JsonNode *root;
+  gboolean ret;
+  int i;
+
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "benchmarks");
+  json_builder_begin_array (builder);
+  for (i = 0; i < n_results; i++)
+    {
+      json_builder_begin_object (builder);
+      json_builder_set_member_name (builder, "name");
+      json_builder_add_string_value (builder, results[i].name);
+      json_builder_set_member_name (builder, "ops");
+      json_builder_add_int_value (builder, results[i].ops);
+      json_builder_set_member_name (builder, "ns_per_op");
+      json_builder_add_double_value (builder, results[i].ns_per_op);
+      json_builder_set_member_name (builder, "p50");
+      json_builder_add_double_value (builder, results[i].p50);
+      json_builder_set_member_name (builder, "p90");
+      json_builder_add_double_value (builder, results[i].p90);
+      json_builder_set_member_name (builder, "p99");
+      json_builder_add_double_value (builder, results[i].p99);
+      json_builder_set_member_name (builder, "allocs_per_op");
+      json_builder_add_double_value (builder, results[i].allocs_per_op);
+      json_builder_set_member_name (builder, "bytes_per_op");
+      json_builder_add_double_value (builder, results[i].bytes_per_op);
+      json_builder_end_object (builder);
+    }
+  json_builder_end_array (builder);
+  json_builder_end_object (builder);
+
+  root = json_builder_get_root (builder);
+  generator = json_generator_new ();
+  json_generator_set_root (generator, root);
+  g_object_set (generator, "pretty", TRUE, NULL);
+  ret = json_generator_to_file (generator, filename, error);
+
+  g_object_unref (generator);
+  json_node_free (root);
+  g_object_unref (builder);
+
+  return ret;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *option_context;
+  GError *error = NULL;
+  JsonParser *parser = NULL;
+  JsonNode *baseline = NULL;
+  BenchResult *results;
+  int n_results = 0;
+  int n_regressions = 0;
+  int i;
+
+  /* GSlice would hide most small allocations from us, and both of
+   * these have to happen before glib allocates anything */
+  setenv ("G_SLICE", "always-malloc", 1);
+  alloc_counting = bosh_maint_count_allocations ();
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+  g_type_init ();
+
+  option_context = g_option_context_new ("- benchmark bosh");
+  g_option_context_add_main_entries (option_context, bench_args, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (option_context);
+  n_samples = MAX (n_samples, 1);
+
+  if (baseline_filename)
+    {
+      parser = json_parser_new ();
+      if (!json_parser_load_from_file (parser, baseline_filename, &error))
+        {
+          fprintf (stderr, "Failed to read baseline %s: %s\n",
+                   baseline_filename, error->message);
+          return 1;
+        }
+      baseline = json_parser_get_root (parser);
+    }
+
+  bosh_init_commands ();
+  g_set_print_handler (discard_print);
+
+  if (!alloc_counting)
+    printf ("Allocations can't be counted with this version of glib\n");
+  printf ("%-28s %10s %10s %10s %10s %9s %10s%s\n",
+          "benchmark", "ns/op", "p50", "p90", "p99", "allocs/op", "bytes/op",
+          baseline ? "  vs baseline" : "");
+
+  results = g_new0 (BenchResult, G_N_ELEMENTS (bench_cases));
+  for (i = 0; i < G_N_ELEMENTS (bench_cases); i++)
+    {
+      const BenchCase *bench = &bench_cases[i];
+      BenchResult *result = &results[n_results];
+
+      if (filter && !g_pattern_match_simple (filter, bench->name))
+        continue;
+
+      if (!bench_run (bench, result))
+        continue;
+      n_results++;
+
+      printf ("%-28s %10.1f %10.1f %10.1f %10.1f %9.1f %10.1f",
+              result->name, result->ns_per_op,
+              result->p50, result->p90, result->p99,
+              result->allocs_per_op, result->bytes_per_op);
+      if (baseline
+          && print_comparison (result,
+                               lookup_baseline (baseline, result->name)))
+        n_regressions++;
+      printf ("\n");
+      fflush (stdout);
+    }
+
+  if (json_filename
+      && !save_results (json_filename, results, n_results, &error))
+    {
+      fprintf (stderr, "Failed to save results to %s: %s\n",
+               json_filename, error->message);
+      return 1;
+    }
+
+  if (parser)
+    g_object_unref (parser);
+  g_free (results);
+
+  if (n_regressions)
+    {
+      printf ("%d regression%s against %s\n", n_regressions,
+              n_regressions == 1 ? "" : "s", baseline_filename);
+      return 1;
+    }
+
+  return 0;
+}
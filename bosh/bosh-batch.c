@@ -0,0 +1,267 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Commands given on the command line with --ex and -x are queued here
+ * and fed through the same dispatch path as interactive input, but
+ * without readline, a prompt or any per-line flushing of stdout.
+ *
+ * Lines typed at the prompt while the target is running are queued
+ * here too ("type-ahead") and run in order once it stops.  Only the
+ * last stop of a type-ahead batch is rendered.
+ *
+ * Commands in class_run (next, step, continue...) are asynchronous so
+ * after dispatching one we wait for the debuggable to stop again before
+ * moving on to the next command. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include <gswat/gswat.h>
+
+#include "cli-decode.h"
+
+#include "bosh-batch.h"
+#include "bosh-commands.h"
+#include "bosh-main.h"
+#include "bosh-step.h"
+#include "bosh-utils.h"
+
+/* If a run command hasn't set the target running within this many
+ * milliseconds then we assume it was refused (e.g. "Ignoring next
+ * command while not interrupted") and carry on. */
+#define BOSH_BATCH_RUN_GRACE_MS 250
+
+static GQueue batch_commands = G_QUEUE_INIT;
+static GMainLoop *batch_loop;
+static gboolean batch_active;
+static gboolean batch_exit_when_done;
+static gboolean batch_waiting;
+static gboolean batch_type_ahead;
+static guint batch_resume_id;
+static guint batch_grace_id;
+
+void
+bosh_batch_add_command (const char *command)
+{
+  g_queue_push_tail (&batch_commands, g_strdup (command));
+}
+
+/* Queue COMMANDS, a NULL terminated array, to run next and in order,
+ * ahead of anything already queued */
+void
+bosh_batch_insert_commands (char **commands)
+{
+  int i;
+
+  for (i = commands ? g_strv_length (commands) : 0; i > 0; i--)
+    g_queue_push_head (&batch_commands, g_strdup (commands[i - 1]));
+}
+
+gboolean
+bosh_batch_add_file (const char *filename, GError **error)
+{
+  char *contents;
+  char **lines;
+  int i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, error))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      char *line = g_strstrip (lines[i]);
+      if (*line == '\0' || *line == '#')
+        continue;
+      bosh_batch_add_command (line);
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+  return TRUE;
+}
+
+gboolean
+bosh_batch_is_active (void)
+{
+  return batch_active;
+}
+
+static void
+batch_print (const gchar *string)
+{
+  /* Unlike the default handler we don't fflush after every string */
+  fputs (string, stdout);
+}
+
+static void
+batch_finish (void)
+{
+  batch_active = FALSE;
+  batch_type_ahead = FALSE;
+  fflush (stdout);
+
+  if (batch_exit_when_done)
+    g_main_loop_quit (batch_loop);
+  else
+    bosh_utils_update_prompt ();
+}
+
+static gboolean batch_run_next (gpointer data);
+
+static void
+batch_resume (void)
+{
+  batch_waiting = FALSE;
+  if (batch_grace_id)
+    {
+      g_source_remove (batch_grace_id);
+      batch_grace_id = 0;
+    }
+  if (!batch_resume_id)
+    batch_resume_id = g_idle_add (batch_run_next, NULL);
+}
+
+static gboolean
+batch_grace_expired (gpointer data)
+{
+  GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
+
+  batch_grace_id = 0;
+  if (!debuggable
+      || (gswat_debuggable_get_state (debuggable) != GSWAT_DEBUGGABLE_RUNNING
+          && !bosh_step_is_active ()))
+    batch_resume ();
+
+  return FALSE;
+}
+
+static gboolean
+batch_run_next (gpointer data)
+{
+  GSwatDebuggable *debuggable;
+  struct cmd_list_element *c;
+  char *command;
+
+  batch_resume_id = 0;
+
+  command = g_queue_pop_head (&batch_commands);
+  if (!command)
+    {
+      batch_finish ();
+      return FALSE;
+    }
+
+  c = bosh_execute_command (command, 0);
+  g_free (command);
+
+  debuggable = bosh_get_default_debuggable ();
+  if (c && c->class == class_run && debuggable)
+    {
+      batch_waiting = TRUE;
+      if (gswat_debuggable_get_state (debuggable) != GSWAT_DEBUGGABLE_RUNNING)
+        batch_grace_id = g_timeout_add (BOSH_BATCH_RUN_GRACE_MS,
+                                        batch_grace_expired, NULL);
+      return FALSE;
+    }
+
+  batch_resume ();
+  return FALSE;
+}
+
+/* Called from the debuggable's notify::state handler in place of the
+ * usual prompt handling while there are queued commands. */
+void
+bosh_batch_state_changed (GSwatDebuggable *debuggable)
+{
+  if (!batch_waiting)
+    return;
+
+  if (gswat_debuggable_get_state (debuggable) == GSWAT_DEBUGGABLE_RUNNING)
+    {
+      if (batch_grace_id)
+        {
+          g_source_remove (batch_grace_id);
+          batch_grace_id = 0;
+        }
+      return;
+    }
+
+  batch_resume ();
+}
+
+/* Start running the queued commands from LOOP.  If EXIT_WHEN_DONE is
+ * TRUE then LOOP is quit once the queue is empty, otherwise we fall
+ * back to an interactive prompt. */
+void
+bosh_batch_run (GMainLoop *loop, gboolean exit_when_done)
+{
+  GSwatDebuggable *debuggable;
+
+  batch_loop = loop;
+  batch_exit_when_done = exit_when_done;
+  batch_active = TRUE;
+
+  if (exit_when_done)
+    {
+      /* Nobody is watching the output as it's produced so let stdio
+       * buffer it fully. */
+      setvbuf (stdout, NULL, _IOFBF, 64 * 1024);
+      g_set_print_handler (batch_print);
+    }
+
+  /* If the target is already on its way somewhere then the first
+   * command waits for it to stop */
+  debuggable = bosh_get_default_debuggable ();
+  if (bosh_step_is_active ()
+      || (debuggable
+          && gswat_debuggable_get_state (debuggable)
+             == GSWAT_DEBUGGABLE_RUNNING))
+    batch_waiting = TRUE;
+  else
+    batch_resume ();
+}
+
+/* Queue a line typed at the prompt, starting a batch to run it if
+ * there isn't one already. */
+void
+bosh_batch_type_ahead (const char *command)
+{
+  bosh_batch_add_command (command);
+
+  if (batch_active)
+    return;
+
+  batch_type_ahead = TRUE;
+  bosh_batch_run (NULL, FALSE);
+}
+
+/* TRUE if the target has stopped with more typed-ahead commands still
+ * to run, so there's no point rendering where it stopped. */
+gboolean
+bosh_batch_collapse_stop (void)
+{
+  return batch_active && batch_type_ahead
+    && !g_queue_is_empty (&batch_commands);
+}
+
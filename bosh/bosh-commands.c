@@ -19,6 +19,7 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <glib.h>
 #include <glib/gi18n.h>
@@ -29,9 +30,23 @@
 #include "completer.h"
 #include "cli-decode.h"
 #include "cli-setshow.h"
+#include "cli-utils.h"
 
+#include "bosh-batch.h"
 #include "bosh-commands.h"
+#include "bosh-core.h"
+#include "bosh-dump.h"
+#include "bosh-inferior.h"
+#include "bosh-journal.h"
+#include "bosh-log.h"
 #include "bosh-main.h"
+#include "bosh-maint.h"
+#include "bosh-memory.h"
+#include "bosh-output.h"
+#include "bosh-pause.h"
+#include "bosh-pipe.h"
+#include "bosh-snapshot.h"
+#include "bosh-step.h"
 #include "bosh-utils.h"
 
 /* Chain containing all defined commands.  */
@@ -39,9 +54,11 @@ struct cmd_list_element *cmdlist;
 
 struct cmd_list_element *infolist;
 
-static char *last_command = NULL;
+struct cmd_list_element *setlist;
+
+struct cmd_list_element *showlist;
 
-static int list_position = -1;
+static char *last_command = NULL;
 
 /* Utility used everywhere when at least one argument is needed and
    none is supplied. */
@@ -52,6 +69,21 @@ bosh_command_error_no_argument (char *why)
   g_print (_("Argument required (%s)."), why);
 }
 
+/* The full name of the command C as INPUT spelled it, e.g. "info
+   inferiors" for "i inf".  */
+
+char *
+bosh_command_full_name (struct cmd_list_element *c, char *input)
+{
+  struct cmd_list_element *result_list = NULL;
+  char *line = input;
+
+  lookup_cmd_1 (&line, cmdlist, &result_list, 1);
+  if (result_list && result_list->prefixname)
+    return g_strconcat (result_list->prefixname, c->name, NULL);
+  return g_strdup (c->name);
+}
+
 /* Provide documentation on command or list given by COMMAND.  FROM_TTY
    is ignored.  */
 
@@ -74,6 +106,51 @@ bosh_echo_command (char *text, int from_tty)
   g_print ("%s", text);
 }
 
+/* The "info" command is defined as a prefix, with allow_unknown = 0.
+   Therefore, its own definition is called only for "info" with no
+   args.  */
+
+static void
+bosh_info_command (char *arg, int from_tty)
+{
+  g_print (_("\"info\" must be followed by the name of an info "
+             "command.\n"));
+  help_list (infolist, "info ", -1, NULL);
+}
+
+static void
+bosh_set_command (char *arg, int from_tty)
+{
+  g_print (_("\"set\" must be followed by the name of a set "
+             "subcommand.\n"));
+  help_list (setlist, "set ", -1, NULL);
+}
+
+static void
+bosh_show_command (char *arg, int from_tty)
+{
+  cmd_show_list (showlist, from_tty, "");
+}
+
+static void
+show_lines_per_page (GIOChannel *file, int from_tty,
+                     struct cmd_list_element *c, const char *value)
+{
+  if (lines_per_page == 0)
+    g_print (_("Number of lines bosh thinks are in a page is the height of "
+               "the terminal.\n"));
+  else
+    g_print (_("Number of lines bosh thinks are in a page is %s.\n"),
+             value);
+}
+
+static void
+show_pagination_enabled (GIOChannel *file, int from_tty,
+                         struct cmd_list_element *c, const char *value)
+{
+  g_print (_("State of pagination is %s.\n"), value);
+}
+
 static void
 bosh_start_command (char *command, int from_tty)
 {
@@ -109,22 +186,47 @@ is_debuggable_interrupted (GSwatDebuggable *debuggable, char *command)
   return TRUE;
 }
 
+static gboolean
+get_step_count (char *arg, guint *count)
+{
+  long value;
+
+  *count = 1;
+  if (!arg || !*arg)
+    return TRUE;
+
+  value = parse_and_eval_long (arg);
+  if (value <= 0 || value > G_MAXUINT)
+    {
+      g_print (_("Invalid step count \"%s\".\n"), arg);
+      return FALSE;
+    }
+  *count = value;
+  return TRUE;
+}
+
 static void
 bosh_next_command (char *command, int from_tty)
 {
   GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
-  if (!is_debuggable_interrupted (debuggable, "next"))
+  guint count;
+
+  if (!is_debuggable_interrupted (debuggable, "next")
+      || !get_step_count (command, &count))
     return;
-  gswat_debuggable_next (debuggable);
+  bosh_step_start (debuggable, BOSH_STEP_NEXT, count);
 }
 
 static void
 bosh_step_command (char *command, int from_tty)
 {
   GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
-  if (!is_debuggable_interrupted (debuggable, "step"))
+  guint count;
+
+  if (!is_debuggable_interrupted (debuggable, "step")
+      || !get_step_count (command, &count))
     return;
-  gswat_debuggable_step (debuggable);
+  bosh_step_start (debuggable, BOSH_STEP_STEP, count);
 }
 
 static void
@@ -136,29 +238,89 @@ bosh_finish_command (char *command, int from_tty)
   gswat_debuggable_finish (debuggable);
 }
 
+/* "-a" asks for all threads.  gswat only drives gdb in all-stop mode
+ * so every thread is interrupted together anyway, and we accept it for
+ * anyone used to non-stop gdb. */
+static gboolean
+parse_all_threads_arg (char *args, const char *command)
+{
+  if (!args || !*args)
+    return TRUE;
+  args = g_strstrip (args);
+  if (strcmp (args, "-a") == 0)
+    return TRUE;
+  g_print (_("Usage: %s [-a]\n"), command);
+  return FALSE;
+}
+
 static void
 bosh_continue_command (char *command, int from_tty)
 {
   GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
+
+  /* "continue -a" only means something in non-stop mode, where
+   * threads can be resumed one at a time. */
+  if (command)
+    command = g_strstrip (command);
+  if (command
+      && (strcmp (command, "-a") == 0 || g_str_has_prefix (command, "-a ")))
+    {
+      g_print (_("Non-stop mode is not supported, "
+                 "so \"continue -a\" can't be used.\n"));
+      return;
+    }
   if (!is_debuggable_interrupted (debuggable, "continue"))
     return;
   gswat_debuggable_continue (debuggable);
 }
 
+static void
+bosh_interrupt_command (char *command, int from_tty)
+{
+  GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
+
+  if (!parse_all_threads_arg (command, "interrupt"))
+    return;
+  if (!debuggable
+      || gswat_debuggable_get_state (debuggable)
+         != GSWAT_DEBUGGABLE_RUNNING)
+    {
+      g_print (_("The program is not running.\n"));
+      return;
+    }
+
+  /* The stop is picked up by any commands typed ahead */
+  if (bosh_step_is_active ())
+    bosh_step_cancel ();
+  gswat_debuggable_interrupt (debuggable);
+}
+
 static void
 bosh_backtrace_command (char *command, int from_tty)
 {
   GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
+  BoshCore *core = bosh_core_get_current ();
   GQueue *stack = NULL;
   GList *l;
   int i;
 
+  /* With no live target a loaded core is unwound directly */
+  if (!debuggable && core)
+    {
+      bosh_core_backtrace (core);
+      return;
+    }
+
   if (!is_debuggable_interrupted (debuggable, "backtrace"))
     return;
 
+  /* gswat can only hand us the whole stack in one go, so quitting the
+   * pager saves the printing but not the time spent fetching it */
   stack = gswat_debuggable_get_stack (GSWAT_DEBUGGABLE (debuggable));
-  for(l = stack->head, i = 0; l; l = l->next, i++)
+  bosh_output_begin_list ("stack");
+  for(l = stack->head, i = 0; l && !output_cancelled (); l = l->next, i++)
     bosh_utils_print_frame (l->data);
+  bosh_output_end_list ();
 
   gswat_debuggable_stack_free (stack);
 }
@@ -172,7 +334,7 @@ bosh_frame_command (char *command, int from_tty)
   if (!is_debuggable_interrupted (debuggable, "frame"))
     return;
 
-  list_position = -1;
+  bosh_inferior_get_current ()->list_position = -1;
 
   if (command)
     {
@@ -187,12 +349,14 @@ static void
 bosh_list_command (char *command, int from_tty)
 {
   GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
+  BoshInferior *inferior;
   char *uri;
   int line;
   int progress_direction = 1;
 
   if (!is_debuggable_interrupted (debuggable, "backtrace"))
     return;
+  inferior = bosh_inferior_get_current ();
 
   /* XXX: We currently only support lines specified as:
    * -
@@ -209,29 +373,29 @@ bosh_list_command (char *command, int from_tty)
           if (strv[0] && strv[1])
             {
               uri = gswat_debuggable_get_uri_for_file (debuggable, strv[0]);
-              list_position = strtoul (strv[1], &endptr, 10);
+              inferior->list_position = strtoul (strv[1], &endptr, 10);
               if (endptr == strv[0])
-                list_position = -1;
+                inferior->list_position = -1;
             }
           else
-            list_position = strtoul (strv[0], &endptr, 10);
+            inferior->list_position = strtoul (strv[0], &endptr, 10);
           g_strfreev (strv);
         }
     }
   else
     uri = gswat_debuggable_get_source_uri (debuggable);
 
-  if (list_position == -1)
+  if (inferior->list_position == -1)
     line = gswat_debuggable_get_source_line (debuggable);
   else
-    line = list_position;
+    line = inferior->list_position;
 
   if (uri)
     {
       if (line >= 5)
         line -= 5;
       if (bosh_utils_print_file_range (uri, line, line + 10))
-        list_position = line + 10 * progress_direction;
+        inferior->list_position = line + 10 * progress_direction;
       g_free (uri);
     }
 }
@@ -267,11 +431,58 @@ bosh_init_commands (void)
 
   c = bosh_add_command ("help", class_support, bosh_help_command,
                         _("Print list of commands."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
   bosh_command_set_completer (c, command_completer);
   bosh_add_command_alias ("h", "help", class_support, 1);
 
-  bosh_add_command ("echo", class_support, bosh_echo_command,
-                    _("Print a constant string."));
+  c = bosh_add_command ("echo", class_support, bosh_echo_command,
+                        _("Print a constant string."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+
+  c = bosh_command_list_add_prefix (&cmdlist, "info", class_info,
+                                    bosh_info_command,
+                                    _("Generic command for showing things "
+                                      "about the program being debugged."),
+                                    &infolist, "info ", 0);
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+  bosh_add_command_alias ("i", "info", class_info, 1);
+
+  c = bosh_command_list_add_prefix (&cmdlist, "set", class_vars,
+                                    bosh_set_command,
+                                    _("Modify parts of the bosh environment.\n"
+                                      "You can see these environment settings "
+                                      "with the \"show\" command."),
+                                    &setlist, "set ", 0);
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+
+  c = bosh_command_list_add_prefix (&cmdlist, "show", class_info,
+                                    bosh_show_command,
+                                    _("Generic command for showing things "
+                                      "about the debugger."),
+                                    &showlist, "show ", 0);
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+
+  add_setshow_uinteger_cmd ("height", class_support, &lines_per_page,
+                            _("Set number of lines bosh thinks are in a "
+                              "page."),
+                            _("Show number of lines bosh thinks are in a "
+                              "page."),
+                            _("Output longer than a page stops with a "
+                              "prompt to continue.  By default the\n"
+                              "height of the terminal is used; \"set height "
+                              "0\" turns paging off."),
+                            NULL,
+                            show_lines_per_page,
+                            &setlist, &showlist);
+
+  add_setshow_boolean_cmd ("pagination", class_support,
+                           &pagination_enabled,
+                           _("Set state of pagination."),
+                           _("Show state of pagination."),
+                           NULL,
+                           NULL,
+                           show_pagination_enabled,
+                           &setlist, &showlist);
 
 #if 0
   c = bosh_add_command ("run", class_run, bosh_run_command,
@@ -331,13 +542,27 @@ bosh_init_commands (void)
   bosh_add_command_alias ("c", "cont", class_run, 1);
   bosh_add_command_alias ("fg", "cont", class_run, 1);
 
+  c = bosh_add_command ("interrupt", class_run, bosh_interrupt_command,
+                        _("Interrupt the execution of the debugged "
+                          "program.\n"
+                          "Usage: interrupt [-a]\n"
+                          "\n"
+                          "This can be typed while the program is running.  "
+                          "All threads are\n"
+                          "stopped, with or without -a."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+
   bosh_add_command ("backtrace", class_stack, bosh_backtrace_command,
                     _("Print backtrace of all stack frames, or innermost "
                       "COUNT frames.\n"
                       "With a negative argument, print outermost -COUNT "
                       "frames.\n"
                       "Use of the 'full' qualifier also prints the values "
-                      "of the local variables.\n"));
+                      "of the local variables.\n"
+                      "With only a core file loaded, the stack of the thread "
+                      "that got the signal\n"
+                      "is unwound from the core by following frame "
+                      "pointers.\n"));
   bosh_add_command_alias ("bt", "backtrace", class_stack, 0);
 
   bosh_add_command ("frame", class_stack, bosh_frame_command,
@@ -370,40 +595,54 @@ bosh_init_commands (void)
                       "away from the other arg."));
   bosh_add_command_alias ("l", "list", class_files, 1);
 
-  bosh_add_command ("quit", class_support, bosh_quit_command, _("Exit bosh."));
+  c = bosh_add_command ("quit", class_support, bosh_quit_command,
+                        _("Exit bosh."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
   bosh_add_command_alias ("q", "quit", class_support, 1);
+
+  bosh_core_init_commands ();
+  bosh_memory_init_commands ();
+  bosh_dump_init_commands ();
+  bosh_snapshot_init_commands ();
+  bosh_log_init_commands ();
+  bosh_journal_init_commands ();
+  bosh_pipe_init_commands ();
+  bosh_step_init_commands ();
+  bosh_pause_init_commands ();
+  bosh_inferior_init_commands ();
+  bosh_output_init_commands ();
+  bosh_maint_init_commands ();
 }
 
-void
-bosh_readline_cb (char *user_line)
+/* Look up LINE in the command table and run it.  This is the dispatch
+   path shared by the readline callback and by commands queued up from
+   the command line, so it never touches the prompt.
+
+   Returns the command that was run, or NULL if LINE didn't name one.  */
+struct cmd_list_element *
+bosh_execute_command (char *line, int from_tty)
 {
-  char *line = user_line;
+  /* How many commands are running, counting those run by other
+   * commands such as "pipe" and "inferior apply" */
+  static int depth = 0;
   struct cmd_list_element *c;
-  int from_tty = 1;
+  char *input = line;
   char *arg;
   GError *error = NULL;
 
-  bosh_utils_disable_prompt ();
-
-  /* Repeat the last command if the user simply presses <enter>... */
-  if (strcmp (line, "") == 0 && last_command)
-    {
-      line = last_command;
-      c = bosh_lookup_command (&line, cmdlist, "", 1, &error);
-    }
-  else
-    {
-      /* Save the line for possible repeating later via <enter> later */
-      if (last_command)
-        g_free (last_command);
-      last_command = strdup (user_line);
-      c = bosh_lookup_command (&line, cmdlist, "", 1, &error);
-    }
+  bosh_journal_command_start (line);
+  reinitialize_more_filter (from_tty);
 
+  c = bosh_lookup_command (&line, cmdlist, "", 1, &error);
   if (!c)
     {
-      bosh_utils_enable_prompt ();
-      return;
+      if (error)
+        {
+          g_print ("%s", error->message);
+          g_error_free (error);
+        }
+      bosh_journal_command_end (NULL);
+      return NULL;
     }
 
   /* NB: If a command is found line will be updated to point at the first
@@ -415,13 +654,120 @@ bosh_readline_cb (char *user_line)
   if (c->flags & DEPRECATED_WARN_USER)
     deprecated_cmd_warning (&line);
 
+  bosh_maint_command_start (c, input);
+  depth++;
   if (c->type == set_cmd || c->type == show_cmd)
     do_setshow_command (arg, from_tty, c);
   else if (!bosh_command_has_callback (c))
     g_print (_("That is not a command, just a help topic."));
   else
     bosh_command_call (c, arg, from_tty);
+  depth--;
+  bosh_maint_command_end ();
 
-  bosh_utils_enable_prompt ();
+  /* Don't let a list or record a command left open, say by returning
+   * early on an error, spoil the output of the commands after it */
+  if (depth == 0)
+    bosh_output_reset ();
+
+  bosh_journal_command_end (c);
+
+  return c;
+}
+
+/* TRUE if LINE names a command that doesn't need the target to be
+ * stopped, so it can run straight away even while the target runs.
+ * Only settings and the commands explicitly marked as not touching the
+ * target qualify; commands that run other commands (pipe, journal
+ * replay) never do since what they run may need the target. */
+static gboolean
+runs_while_busy (char *line)
+{
+  struct cmd_list_element *last_list = NULL;
+  struct cmd_list_element *c;
+
+  c = lookup_cmd_1 (&line, cmdlist, &last_list, 1);
+  if (!c || c == (struct cmd_list_element *) -1)
+    return FALSE;
+  if (c->cmd_pointer)
+    c = c->cmd_pointer;
+
+  return c->type == set_cmd || c->type == show_cmd
+    || (c->flags & CMD_RUNS_WHILE_BUSY);
+}
+
+/* TRUE if the target is running, or being stepped, so a line typed now
+ * that needs it stopped can't be run straight away */
+gboolean
+bosh_target_is_busy (void)
+{
+  GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
+
+  return bosh_step_is_active ()
+    || (debuggable
+        && gswat_debuggable_get_state (debuggable)
+           == GSWAT_DEBUGGABLE_RUNNING);
+}
+
+/* TRUE if LINE has to wait until the target stops, and until any
+ * commands queued ahead of it have run, before it can be run */
+gboolean
+bosh_command_must_wait (char *line)
+{
+  return (bosh_batch_is_active () || bosh_target_is_busy ())
+    && !runs_while_busy (line);
 }
 
+void
+bosh_readline_cb (char *user_line)
+{
+  char *line = user_line;
+
+  bosh_utils_disable_prompt ();
+
+  if (strpbrk (user_line, "\r\n"))
+    {
+      /* A bracketed paste of several lines arrives as one line and is
+       * run as one batch */
+      char **lines = g_strsplit_set (user_line, "\r\n", -1);
+      int i;
+
+      for (i = 0; lines[i]; i++)
+        {
+          char *command = g_strstrip (lines[i]);
+          if (*command == '\0')
+            continue;
+          bosh_batch_type_ahead (command);
+          g_free (last_command);
+          last_command = g_strdup (command);
+        }
+      g_strfreev (lines);
+    }
+  else
+    {
+      /* Repeat the last command if the user simply presses <enter>... */
+      if (strcmp (line, "") == 0 && last_command)
+        line = last_command;
+      else
+        {
+          /* Save the line for possible repeating later via <enter> later */
+          if (last_command)
+            g_free (last_command);
+          last_command = strdup (user_line);
+        }
+
+      /* Lines typed while the target runs are queued up to run in order
+       * once it stops, unless they can run without it stopping */
+      if (bosh_command_must_wait (line))
+        {
+          if (*line)
+            bosh_batch_type_ahead (line);
+        }
+      else
+        bosh_execute_command (line, 1);
+    }
+
+  /* The prompt is left empty if the line set the target running or
+   * queued up commands */
+  bosh_utils_enable_prompt ();
+}
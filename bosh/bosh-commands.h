@@ -24,10 +24,21 @@ extern struct cmd_list_element *cmdlist;
 
 extern struct cmd_list_element *infolist;
 
+extern struct cmd_list_element *setlist;
+
+extern struct cmd_list_element *showlist;
+
 void bosh_init_commands (void);
 
 void bosh_command_error_no_argument (char *why);
 
+char *bosh_command_full_name (struct cmd_list_element *c, char *input);
+
+struct cmd_list_element *bosh_execute_command (char *line, int from_tty);
+
+gboolean bosh_target_is_busy (void);
+gboolean bosh_command_must_wait (char *line);
+
 void bosh_readline_cb (char *line);
 
 #endif /* !defined (CLI_CMDS_H) */
@@ -0,0 +1,876 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* A lazy core file target.
+ *
+ * The whole core file is mmap'd but only the ELF headers and the
+ * PT_NOTE segments (thread status and registers, the auxiliary vector
+ * and the list of file mappings) are looked at up front.  PT_LOAD
+ * segments are only touched, a page at a time, when something actually
+ * reads target memory, so opening a core costs the same whatever its
+ * size.
+ *
+ * On x86 the stack of the thread that got the signal can be unwound
+ * straight from the core, by following the frame pointer chain from
+ * its registers.  Return addresses are named from the symbol tables of
+ * the files the core says were mapped there, each opened the first
+ * time it's needed.  Frames of code built without frame pointers are
+ * missed.
+ *
+ * Only cores with the same ELF class and layout as the host are
+ * understood. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/procfs.h>
+#if defined (__x86_64__) || defined (__i386__)
+#include <sys/user.h>
+#endif
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "cli-decode.h"
+#include "cli-utils.h"
+#include "completer.h"
+
+#include "bosh-commands.h"
+#include "bosh-core.h"
+#include "bosh-output.h"
+
+#if __ELF_NATIVE_CLASS == 64
+#define BOSH_CORE_ELF_CLASS ELFCLASS64
+#define BOSH_CORE_ST_TYPE ELF64_ST_TYPE
+#else
+#define BOSH_CORE_ELF_CLASS ELFCLASS32
+#define BOSH_CORE_ST_TYPE ELF32_ST_TYPE
+#endif
+
+/* Stop unwinding at this depth, in case the frame chain loops */
+#define BOSH_CORE_MAX_FRAMES 4096
+
+/* An ELF file mapped by the dumped process, mapped here in turn to read
+ * its symbol table */
+typedef struct _CoreObject
+{
+  const guint8 *data;
+  gsize size;
+  const ElfW(Phdr) *phdrs;
+  int n_phdrs;
+  const ElfW(Sym) *symbols;
+  gsize n_symbols;
+  const char *strings;
+  gsize strings_size;
+} CoreObject;
+
+static BoshCore *current_core;
+static char *core_executable;
+
+GQuark
+bosh_core_error_quark (void)
+{
+  return g_quark_from_static_string ("bosh-core-error-quark");
+}
+
+static gboolean
+check_elf_header (const ElfW(Ehdr) *ehdr, gsize size)
+{
+  if (size < sizeof (ElfW(Ehdr))
+      || memcmp (ehdr->e_ident, ELFMAG, SELFMAG) != 0
+      || ehdr->e_ident[EI_CLASS] != BOSH_CORE_ELF_CLASS
+      || ehdr->e_type != ET_CORE
+      || ehdr->e_phentsize != sizeof (ElfW(Phdr))
+      || ehdr->e_phoff + ehdr->e_phnum * sizeof (ElfW(Phdr)) > size)
+    return FALSE;
+  return TRUE;
+}
+
+gboolean
+bosh_core_file_is_core (const char *filename)
+{
+  ElfW(Ehdr) ehdr;
+  gboolean is_core = FALSE;
+  int fd = open (filename, O_RDONLY);
+
+  if (fd == -1)
+    return FALSE;
+  if (read (fd, &ehdr, sizeof (ehdr)) == sizeof (ehdr))
+    {
+      is_core = (memcmp (ehdr.e_ident, ELFMAG, SELFMAG) == 0
+                 && ehdr.e_type == ET_CORE);
+    }
+  close (fd);
+  return is_core;
+}
+
+static void
+parse_prstatus (BoshCore *core, const guint8 *desc, gsize descsz)
+{
+  const struct elf_prstatus *prstatus = (const void *)desc;
+  BoshCoreThread thread;
+
+  if (descsz < sizeof (struct elf_prstatus))
+    return;
+
+  thread.tid = prstatus->pr_pid;
+  thread.signal = prstatus->pr_cursig;
+  thread.registers = (const guint8 *)&prstatus->pr_reg;
+  thread.registers_size = sizeof (prstatus->pr_reg);
+#if defined (__x86_64__)
+  thread.pc = ((const struct user_regs_struct *)thread.registers)->rip;
+#elif defined (__i386__)
+  thread.pc = ((const struct user_regs_struct *)thread.registers)->eip;
+#else
+  thread.pc = 0;
+#endif
+
+  g_array_append_val (core->threads, thread);
+}
+
+static void
+parse_prpsinfo (BoshCore *core, const guint8 *desc, gsize descsz)
+{
+  const struct elf_prpsinfo *prpsinfo = (const void *)desc;
+
+  if (descsz < sizeof (struct elf_prpsinfo))
+    return;
+
+  g_free (core->command_line);
+  core->command_line = g_strndup (prpsinfo->pr_psargs,
+                                  sizeof (prpsinfo->pr_psargs));
+  g_strchomp (core->command_line);
+}
+
+/* The NT_FILE note is:
+ *   long count, long page_size,
+ *   count * { long start, long end, long file_offset (in pages) },
+ *   count * NUL terminated filenames */
+static void
+parse_file_note (BoshCore *core, const guint8 *desc, gsize descsz)
+{
+  const ElfW(Addr) *words = (const void *)desc;
+  const char *name;
+  const char *desc_end = (const char *)desc + descsz;
+  ElfW(Addr) count;
+  ElfW(Addr) page_size;
+  ElfW(Addr) i;
+
+  if (descsz < 2 * sizeof (ElfW(Addr)))
+    return;
+  count = words[0];
+  page_size = words[1];
+  if (count > (descsz / sizeof (ElfW(Addr)) - 2) / 3)
+    return;
+
+  name = (const char *)(words + 2 + count * 3);
+  for (i = 0; i < count && name < desc_end; i++)
+    {
+      BoshCoreMapping mapping;
+
+      mapping.start = words[2 + i * 3];
+      mapping.end = words[2 + i * 3 + 1];
+      mapping.file_offset = words[2 + i * 3 + 2] * page_size;
+      mapping.path = name;
+      g_array_append_val (core->mappings, mapping);
+
+      name += strnlen (name, desc_end - name) + 1;
+    }
+}
+
+static void
+parse_notes (BoshCore *core, const guint8 *notes, gsize size)
+{
+  gsize offset = 0;
+
+  while (offset + sizeof (ElfW(Nhdr)) <= size)
+    {
+      const ElfW(Nhdr) *nhdr = (const void *)(notes + offset);
+      const guint8 *desc;
+
+      offset += sizeof (ElfW(Nhdr));
+      offset += (nhdr->n_namesz + 3) & ~3;
+      desc = notes + offset;
+      offset += (nhdr->n_descsz + 3) & ~3;
+      if (offset > size)
+        break;
+
+      switch (nhdr->n_type)
+        {
+        case NT_PRSTATUS:
+          parse_prstatus (core, desc, nhdr->n_descsz);
+          break;
+        case NT_PRPSINFO:
+          parse_prpsinfo (core, desc, nhdr->n_descsz);
+          break;
+        case NT_AUXV:
+          core->auxv = desc;
+          core->auxv_size = nhdr->n_descsz;
+          break;
+        case NT_FILE:
+          parse_file_note (core, desc, nhdr->n_descsz);
+          break;
+        default:
+          break;
+        }
+    }
+}
+
+static void
+core_object_free (gpointer data)
+{
+  CoreObject *object = data;
+
+  /* Files that couldn't be opened are remembered as NULL */
+  if (!object)
+    return;
+  munmap ((void *)object->data, object->size);
+  g_free (object);
+}
+
+/* Maps the ELF file PATH and finds its symbol table, preferring the
+ * full .symtab to .dynsym.  Returns NULL if PATH can't be read or has
+ * no symbols. */
+static CoreObject *
+core_object_open (const char *path)
+{
+  CoreObject *object;
+  const ElfW(Ehdr) *ehdr;
+  const ElfW(Shdr) *shdrs;
+  const ElfW(Shdr) *symtab = NULL;
+  const ElfW(Shdr) *strtab;
+  struct stat st;
+  void *data;
+  int fd;
+  int i;
+
+  fd = open (path, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+  if (fstat (fd, &st) == -1 || st.st_size < sizeof (ElfW(Ehdr)))
+    {
+      close (fd);
+      return NULL;
+    }
+  data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED)
+    return NULL;
+
+  object = g_new0 (CoreObject, 1);
+  object->data = data;
+  object->size = st.st_size;
+
+  ehdr = data;
+  if (memcmp (ehdr->e_ident, ELFMAG, SELFMAG) != 0
+      || ehdr->e_ident[EI_CLASS] != BOSH_CORE_ELF_CLASS
+      || ehdr->e_phentsize != sizeof (ElfW(Phdr))
+      || ehdr->e_shentsize != sizeof (ElfW(Shdr))
+      || ehdr->e_phoff + ehdr->e_phnum * sizeof (ElfW(Phdr)) > object->size
+      || ehdr->e_shoff + ehdr->e_shnum * sizeof (ElfW(Shdr)) > object->size)
+    goto error;
+
+  object->phdrs = (const void *)(object->data + ehdr->e_phoff);
+  object->n_phdrs = ehdr->e_phnum;
+
+  shdrs = (const void *)(object->data + ehdr->e_shoff);
+  for (i = 0; i < ehdr->e_shnum; i++)
+    {
+      if (shdrs[i].sh_type == SHT_SYMTAB)
+        {
+          symtab = &shdrs[i];
+          break;
+        }
+      if (shdrs[i].sh_type == SHT_DYNSYM)
+        symtab = &shdrs[i];
+    }
+  if (!symtab || symtab->sh_link >= ehdr->e_shnum)
+    goto error;
+  strtab = &shdrs[symtab->sh_link];
+
+  if (symtab->sh_offset > object->size
+      || symtab->sh_size > object->size - symtab->sh_offset
+      || strtab->sh_offset > object->size
+      || strtab->sh_size > object->size - strtab->sh_offset)
+    goto error;
+
+  object->symbols = (const void *)(object->data + symtab->sh_offset);
+  object->n_symbols = symtab->sh_size / sizeof (ElfW(Sym));
+  object->strings = (const char *)object->data + strtab->sh_offset;
+  object->strings_size = strtab->sh_size;
+
+  return object;
+
+error:
+  core_object_free (object);
+  return NULL;
+}
+
+/* Names the function at OFFSET bytes into OBJECT's file, as mapped by
+ * the dumped process, setting *SYMBOL_OFFSET to how far into it OFFSET
+ * is. */
+static const char *
+core_object_lookup (CoreObject *object,
+                    guint64 offset,
+                    guint64 *symbol_offset)
+{
+  const ElfW(Sym) *best = NULL;
+  guint64 address = 0;
+  gsize i;
+
+  /* Symbols hold addresses, not file offsets */
+  for (i = 0; i < object->n_phdrs; i++)
+    {
+      const ElfW(Phdr) *phdr = &object->phdrs[i];
+
+      if (phdr->p_type == PT_LOAD
+          && offset >= phdr->p_offset
+          && offset < phdr->p_offset + phdr->p_filesz)
+        break;
+    }
+  if (i == object->n_phdrs)
+    return NULL;
+  address = object->phdrs[i].p_vaddr + offset - object->phdrs[i].p_offset;
+
+  for (i = 0; i < object->n_symbols; i++)
+    {
+      const ElfW(Sym) *symbol = &object->symbols[i];
+      int type = BOSH_CORE_ST_TYPE (symbol->st_info);
+
+      if ((type != STT_FUNC && type != STT_GNU_IFUNC)
+          || symbol->st_shndx == SHN_UNDEF
+          || symbol->st_value > address
+          || (symbol->st_size && address >= symbol->st_value + symbol->st_size)
+          || symbol->st_name >= object->strings_size)
+        continue;
+
+      if (!best || symbol->st_value > best->st_value)
+        best = symbol;
+    }
+  if (!best)
+    return NULL;
+
+  *symbol_offset = address - best->st_value;
+  return object->strings + best->st_name;
+}
+
+/* Finds what was mapped at ADDRESS in the dumped process, setting
+ * *PATH to the file and returning the function there, or NULL if
+ * there are no symbols for it. */
+static const char *
+core_lookup_symbol (BoshCore *core,
+                    guint64 address,
+                    const char **path,
+                    guint64 *symbol_offset)
+{
+  BoshCoreMapping *mapping = NULL;
+  const char *object_path;
+  CoreObject *object;
+  guint64 entry;
+  guint i;
+
+  *path = NULL;
+  for (i = 0; i < core->mappings->len; i++)
+    {
+      mapping = &g_array_index (core->mappings, BoshCoreMapping, i);
+      if (address >= mapping->start && address < mapping->end)
+        break;
+    }
+  if (i == core->mappings->len)
+    return NULL;
+  *path = object_path = mapping->path;
+
+  /* The program's entry point tells us which file is the executable,
+   * which may have been given on the command line */
+  if (core->executable
+      && bosh_core_lookup_auxv (core, AT_ENTRY, &entry))
+    {
+      for (i = 0; i < core->mappings->len; i++)
+        {
+          BoshCoreMapping *main_mapping =
+            &g_array_index (core->mappings, BoshCoreMapping, i);
+
+          if (entry >= main_mapping->start && entry < main_mapping->end)
+            {
+              if (strcmp (main_mapping->path, mapping->path) == 0)
+                object_path = core->executable;
+              break;
+            }
+        }
+    }
+
+  if (!g_hash_table_lookup_extended (core->objects, object_path,
+                                     NULL, (gpointer *)&object))
+    {
+      object = core_object_open (object_path);
+      g_hash_table_insert (core->objects, g_strdup (object_path), object);
+    }
+  if (!object)
+    return NULL;
+
+  return core_object_lookup (object,
+                             address - mapping->start + mapping->file_offset,
+                             symbol_offset);
+}
+
+/* Returns the return addresses up THREAD's stack, innermost first,
+ * found by following the chain of saved frame pointers */
+static GArray *
+core_unwind (BoshCore *core, BoshCoreThread *thread)
+{
+  GArray *pcs = g_array_new (FALSE, FALSE, sizeof (guint64));
+#if defined (__x86_64__) || defined (__i386__)
+  const struct user_regs_struct *regs = (const void *)thread->registers;
+  guint64 pc = thread->pc;
+  guint64 fp;
+
+  if (thread->registers_size < sizeof (struct user_regs_struct))
+    return pcs;
+#if defined (__x86_64__)
+  fp = regs->rbp;
+#else
+  fp = regs->ebp;
+#endif
+
+  while (pc && pcs->len < BOSH_CORE_MAX_FRAMES)
+    {
+      /* The caller's frame pointer, then the return address */
+      ElfW(Addr) link[2];
+
+      g_array_append_val (pcs, pc);
+
+      if (!fp
+          || bosh_core_read_memory (core, fp, link, sizeof (link))
+             != sizeof (link))
+        break;
+      /* The stack grows down so each caller's frame must be above its
+       * callee's; if not then we've lost track of the chain */
+      if (link[0] && link[0] <= fp)
+        break;
+
+      fp = link[0];
+      pc = link[1];
+    }
+#endif
+
+  return pcs;
+}
+
+/* Prints the stack of the thread that got the signal */
+void
+bosh_core_backtrace (BoshCore *core)
+{
+  BoshCoreThread *thread;
+  GArray *pcs;
+  guint i;
+
+#if !defined (__x86_64__) && !defined (__i386__)
+  g_print (_("Backtraces from core files are only supported on x86.\n"));
+  return;
+#endif
+
+  if (!core->threads->len)
+    {
+      g_print (_("No threads in %s.\n"), core->filename);
+      return;
+    }
+
+  thread = &g_array_index (core->threads, BoshCoreThread, 0);
+  pcs = core_unwind (core, thread);
+
+  bosh_output_begin_list ("stack");
+  for (i = 0; i < pcs->len && !output_cancelled (); i++)
+    {
+      guint64 pc = g_array_index (pcs, guint64, i);
+      const char *function;
+      const char *path;
+      guint64 offset = 0;
+
+      /* A return address can be the first byte of the next function,
+       * so look up the call instruction before it */
+      function = core_lookup_symbol (core, i ? pc - 1 : pc, &path, &offset);
+      if (function && i)
+        offset++;
+
+      bosh_output_begin_record ("frame");
+      bosh_output_field_int ("level", i);
+      bosh_output_text (") ");
+      bosh_output_field_string ("function", function ? function : "??");
+      if (function)
+        {
+          bosh_output_text ("+");
+          bosh_output_field_fmt ("offset", "0x%" G_GINT64_MODIFIER "x",
+                                 offset);
+        }
+      bosh_output_text (" (");
+      bosh_output_field_fmt ("address", "0x%016" G_GINT64_MODIFIER "x", pc);
+      bosh_output_text (")");
+      if (path)
+        {
+          bosh_output_text (" ");
+          bosh_output_field_string ("library", path);
+        }
+      bosh_output_text ("\n");
+      bosh_output_end_record ();
+    }
+  bosh_output_end_list ();
+
+  g_array_free (pcs, TRUE);
+}
+
+static gint
+compare_segments (gconstpointer a, gconstpointer b)
+{
+  const BoshCoreSegment *segment_a = a;
+  const BoshCoreSegment *segment_b = b;
+
+  if (segment_a->vaddr < segment_b->vaddr)
+    return -1;
+  return segment_a->vaddr > segment_b->vaddr;
+}
+
+BoshCore *
+bosh_core_open (const char *filename, GError **error)
+{
+  BoshCore *core;
+  const ElfW(Ehdr) *ehdr;
+  const ElfW(Phdr) *phdrs;
+  struct stat st;
+  void *data;
+  int fd;
+  int i;
+
+  fd = open (filename, O_RDONLY);
+  if (fd == -1 || fstat (fd, &st) == -1)
+    {
+      g_set_error (error, BOSH_CORE_ERROR, BOSH_CORE_ERROR_OPEN,
+                   _("Failed to open %s: %s"), filename, g_strerror (errno));
+      if (fd != -1)
+        close (fd);
+      return NULL;
+    }
+
+  data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    {
+      g_set_error (error, BOSH_CORE_ERROR, BOSH_CORE_ERROR_OPEN,
+                   _("Failed to map %s: %s"), filename, g_strerror (errno));
+      close (fd);
+      return NULL;
+    }
+
+  /* We jump around the file following the debugger rather than reading
+   * it front to back so read-ahead would only waste I/O */
+  madvise (data, st.st_size, MADV_RANDOM);
+
+  ehdr = data;
+  if (!check_elf_header (ehdr, st.st_size))
+    {
+      g_set_error (error, BOSH_CORE_ERROR, BOSH_CORE_ERROR_FORMAT,
+                   _("%s is not a core file for this architecture"),
+                   filename);
+      munmap (data, st.st_size);
+      close (fd);
+      return NULL;
+    }
+
+  core = g_new0 (BoshCore, 1);
+  core->filename = g_strdup (filename);
+  core->fd = fd;
+  core->data = data;
+  core->size = st.st_size;
+  core->segments = g_array_new (FALSE, FALSE, sizeof (BoshCoreSegment));
+  core->threads = g_array_new (FALSE, FALSE, sizeof (BoshCoreThread));
+  core->mappings = g_array_new (FALSE, FALSE, sizeof (BoshCoreMapping));
+  core->objects = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         g_free, core_object_free);
+
+  phdrs = (const void *)(core->data + ehdr->e_phoff);
+  for (i = 0; i < ehdr->e_phnum; i++)
+    {
+      const ElfW(Phdr) *phdr = &phdrs[i];
+
+      if (phdr->p_offset > core->size
+          || phdr->p_filesz > core->size - phdr->p_offset)
+        continue;
+
+      if (phdr->p_type == PT_NOTE)
+        parse_notes (core, core->data + phdr->p_offset, phdr->p_filesz);
+      else if (phdr->p_type == PT_LOAD)
+        {
+          BoshCoreSegment segment;
+          segment.vaddr = phdr->p_vaddr;
+          segment.memsz = phdr->p_memsz;
+          segment.filesz = phdr->p_filesz;
+          segment.offset = phdr->p_offset;
+          segment.flags = phdr->p_flags;
+          g_array_append_val (core->segments, segment);
+        }
+    }
+  g_array_sort (core->segments, compare_segments);
+
+  return core;
+}
+
+void
+bosh_core_free (BoshCore *core)
+{
+  munmap ((void *)core->data, core->size);
+  close (core->fd);
+  g_array_free (core->segments, TRUE);
+  g_array_free (core->threads, TRUE);
+  g_array_free (core->mappings, TRUE);
+  g_hash_table_destroy (core->objects);
+  g_free (core->executable);
+  g_free (core->command_line);
+  g_free (core->filename);
+  g_free (core);
+}
+
+static BoshCoreSegment *
+find_segment (BoshCore *core, guint64 address)
+{
+  guint lo = 0;
+  guint hi = core->segments->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      BoshCoreSegment *segment =
+        &g_array_index (core->segments, BoshCoreSegment, mid);
+
+      if (address < segment->vaddr)
+        hi = mid;
+      else if (address >= segment->vaddr + segment->memsz)
+        lo = mid + 1;
+      else
+        return segment;
+    }
+  return NULL;
+}
+
+/* Copies up to LEN bytes of target memory at ADDRESS into BUF.  Pages
+ * of the core are only faulted in as they are copied.  Returns the
+ * number of bytes read, which will be short if the range runs into
+ * memory that wasn't dumped. */
+gsize
+bosh_core_read_memory (BoshCore *core, guint64 address, void *buf, gsize len)
+{
+  guint8 *dest = buf;
+  gsize done = 0;
+
+  while (done < len)
+    {
+      BoshCoreSegment *segment = find_segment (core, address + done);
+      guint64 segment_offset;
+      gsize count;
+
+      if (!segment)
+        break;
+
+      segment_offset = address + done - segment->vaddr;
+      count = MIN (len - done, segment->memsz - segment_offset);
+
+      if (segment_offset < segment->filesz)
+        {
+          gsize from_file = MIN (count, segment->filesz - segment_offset);
+          memcpy (dest + done,
+                  core->data + segment->offset + segment_offset,
+                  from_file);
+          /* The rest of the segment wasn't dumped and reads as zero */
+          memset (dest + done + from_file, 0, count - from_file);
+        }
+      else
+        memset (dest + done, 0, count);
+
+      done += count;
+    }
+
+  return done;
+}
+
+gboolean
+bosh_core_lookup_auxv (BoshCore *core, guint64 type, guint64 *value)
+{
+  const ElfW(auxv_t) *auxv = (const void *)core->auxv;
+  gsize n = core->auxv_size / sizeof (ElfW(auxv_t));
+  gsize i;
+
+  for (i = 0; i < n && auxv[i].a_type != AT_NULL; i++)
+    if (auxv[i].a_type == type)
+      {
+        *value = auxv[i].a_un.a_val;
+        return TRUE;
+      }
+  return FALSE;
+}
+
+/* Takes the main executable's symbols from FILENAME for cores loaded
+ * from now on */
+void
+bosh_core_set_executable (const char *filename)
+{
+  g_free (core_executable);
+  core_executable = g_strdup (filename);
+}
+
+BoshCore *
+bosh_core_get_current (void)
+{
+  return current_core;
+}
+
+static void
+bosh_core_file_command (char *args, int from_tty)
+{
+  GError *error = NULL;
+  BoshCore *core;
+  GTimer *timer;
+  double elapsed;
+
+  if (!args)
+    {
+      if (current_core)
+        {
+          bosh_core_free (current_core);
+          current_core = NULL;
+          g_print (_("No core file now.\n"));
+        }
+      else
+        g_print (_("No core file to forget.\n"));
+      return;
+    }
+
+  timer = g_timer_new ();
+  core = bosh_core_open (g_strstrip (args), &error);
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+  if (!core)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  core->executable = g_strdup (core_executable);
+  if (current_core)
+    bosh_core_free (current_core);
+  current_core = core;
+
+  if (core->command_line)
+    g_print (_("Core was generated by `%s'.\n"), core->command_line);
+  if (core->threads->len)
+    {
+      BoshCoreThread *thread =
+        &g_array_index (core->threads, BoshCoreThread, 0);
+      g_print (_("Program terminated with signal %d.\n"), thread->signal);
+    }
+  g_print (_("Loaded %u threads, %u segments (%" G_GSIZE_FORMAT " bytes) "
+             "in %.3fms\n"),
+           core->threads->len, core->segments->len, core->size,
+           elapsed * 1000);
+}
+
+static void
+bosh_info_core_command (char *args, int from_tty)
+{
+  BoshCore *core = current_core;
+  guint i;
+
+  if (!core)
+    {
+      g_print (_("No core file loaded.\n"));
+      return;
+    }
+
+  bosh_output_begin_record ("core");
+  bosh_output_text (_("Core file: "));
+  bosh_output_field_string ("file", core->filename);
+  bosh_output_text ("\n");
+  bosh_output_end_record ();
+
+  bosh_output_text (_("\nThreads:\n"));
+  bosh_output_begin_list ("threads");
+  for (i = 0; i < core->threads->len; i++)
+    {
+      BoshCoreThread *thread =
+        &g_array_index (core->threads, BoshCoreThread, i);
+
+      bosh_output_begin_record ("thread");
+      bosh_output_field_string ("current", i == 0 ? "*" : " ");
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("num", "%-3u", i + 1);
+      bosh_output_text (" LWP ");
+      bosh_output_field_fmt ("lwp", "%-8d", thread->tid);
+      bosh_output_text (" signal ");
+      bosh_output_field_fmt ("signal", "%-3d", thread->signal);
+      bosh_output_text (" pc ");
+      bosh_output_field_fmt ("pc", "0x%016" G_GINT64_MODIFIER "x",
+                             thread->pc);
+      bosh_output_text ("\n");
+      bosh_output_end_record ();
+    }
+  bosh_output_end_list ();
+
+  bosh_output_text (_("\nMapped files:\n"));
+  bosh_output_begin_list ("mappings");
+  for (i = 0; i < core->mappings->len; i++)
+    {
+      BoshCoreMapping *mapping =
+        &g_array_index (core->mappings, BoshCoreMapping, i);
+
+      bosh_output_begin_record ("mapping");
+      bosh_output_field_fmt ("start", "0x%016" G_GINT64_MODIFIER "x",
+                             mapping->start);
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("end", "0x%016" G_GINT64_MODIFIER "x",
+                             mapping->end);
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("offset", "0x%08" G_GINT64_MODIFIER "x",
+                             mapping->file_offset);
+      bosh_output_text (" ");
+      bosh_output_field_string ("path", mapping->path);
+      bosh_output_text ("\n");
+      bosh_output_end_record ();
+    }
+  bosh_output_end_list ();
+}
+
+void
+bosh_core_init_commands (void)
+{
+  struct cmd_list_element *c;
+
+  c = bosh_add_command ("core-file", class_files, bosh_core_file_command,
+                        _("Use FILE as core dump for examining memory and "
+                          "registers.\n"
+                          "No arg means have no core file."));
+  bosh_command_set_completer (c, filename_completer);
+
+  c = bosh_add_info_command ("core", bosh_info_core_command,
+                             _("Threads and mapped files of the current core "
+                               "file."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+}
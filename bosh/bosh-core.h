@@ -0,0 +1,106 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_CORE_H
+#define BOSH_CORE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define BOSH_CORE_ERROR (bosh_core_error_quark ())
+
+typedef enum {
+  BOSH_CORE_ERROR_OPEN,
+  BOSH_CORE_ERROR_FORMAT,
+} BoshCoreError;
+
+typedef struct _BoshCoreThread
+{
+  int tid;
+  int signal;
+  guint64 pc;
+  /* Points into the mapped core file */
+  const guint8 *registers;
+  gsize registers_size;
+} BoshCoreThread;
+
+typedef struct _BoshCoreMapping
+{
+  guint64 start;
+  guint64 end;
+  guint64 file_offset;
+  const char *path;
+} BoshCoreMapping;
+
+typedef struct _BoshCoreSegment
+{
+  guint64 vaddr;
+  guint64 memsz;
+  guint64 filesz;
+  guint64 offset;
+  guint32 flags;
+} BoshCoreSegment;
+
+typedef struct _BoshCore
+{
+  char *filename;
+  int fd;
+  const guint8 *data;
+  gsize size;
+
+  char *command_line;
+  /* Sorted by vaddr */
+  GArray *segments;
+  GArray *threads;
+  GArray *mappings;
+  const guint8 *auxv;
+  gsize auxv_size;
+
+  /* The program given on the command line, if any, to take the symbols
+   * of the main executable from instead of the path the core names */
+  char *executable;
+  /* The mapped files opened so far to look up symbols, by path */
+  GHashTable *objects;
+} BoshCore;
+
+GQuark bosh_core_error_quark (void);
+
+gboolean bosh_core_file_is_core (const char *filename);
+
+BoshCore *bosh_core_open (const char *filename, GError **error);
+void bosh_core_free (BoshCore *core);
+
+gsize bosh_core_read_memory (BoshCore *core,
+                             guint64 address,
+                             void *buf,
+                             gsize len);
+gboolean bosh_core_lookup_auxv (BoshCore *core,
+                                guint64 type,
+                                guint64 *value);
+
+void bosh_core_backtrace (BoshCore *core);
+
+void bosh_core_set_executable (const char *filename);
+
+BoshCore *bosh_core_get_current (void);
+void bosh_core_init_commands (void);
+
+G_END_DECLS
+
+#endif /* BOSH_CORE_H */
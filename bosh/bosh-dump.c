@@ -0,0 +1,1386 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Copying target memory to and from files.
+ *
+ * Memory is streamed a block at a time so that dumping or restoring a
+ * large range never needs more than a couple of blocks of memory,
+ * whatever the size of the range.
+ *
+ * Besides raw binary files, memory can be dumped through gzip, which
+ * has to be decompressed from the start, or as a series of
+ * independently compressed blocks (see below) that are compressed on
+ * several threads and can be restored in part. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+#include <gswat/gswat.h>
+
+#include "cli-decode.h"
+
+#include "bosh-commands.h"
+#include "bosh-core.h"
+#include "bosh-dump.h"
+#include "bosh-main.h"
+#include "bosh-memory.h"
+#include "bosh-procmem.h"
+
+/* Memory is dumped in blocks of this size.  Two blocks are in flight
+ * at any time: one being filled from the target while the other is
+ * written out. */
+#define DUMP_BLOCK_SIZE (1024 * 1024)
+
+/* Only report progress for dumps at least this big */
+#define DUMP_PROGRESS_THRESHOLD (8 * DUMP_BLOCK_SIZE)
+
+typedef struct _DumpBlock
+{
+  guint8 *buf;
+  guint64 offset;
+  /* Zero marks the end of the stream */
+  gsize len;
+} DumpBlock;
+
+typedef struct _DumpStream
+{
+  /* Either FILE is set for a raw binary dump or OSTREAM for a gzip
+   * compressed one */
+  FILE *file;
+  GOutputStream *ostream;
+
+  GAsyncQueue *empty;
+  GAsyncQueue *full;
+
+  /* Set by the writer thread */
+  int write_errno;
+  GError *error;
+} DumpStream;
+
+#define DUMP_STREAM_FAILED(stream) \
+  ((stream)->write_errno || (stream)->error)
+
+/* The block compressed format.
+ *
+ * The data is cut into DUMP_BLOCK_SIZE blocks that are each compressed
+ * independently, so they can be compressed on several threads at once
+ * and any one of them can be decompressed without the others.  The
+ * file is a ZBlockHeader, the compressed blocks back to back and then
+ * an index with a ZBlockIndexEntry per block.  All fields are in host
+ * byte order. */
+
+#define ZBLOCK_MAGIC "BOSHZBLK"
+#define ZBLOCK_VERSION 1
+#define ZBLOCK_MAX_THREADS 8
+/* The biggest block size "restore" accepts */
+#define ZBLOCK_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+/* No block of LEN bytes compresses to more than this */
+#define ZBLOCK_COMPRESS_BOUND(len) ((len) + (len) / 1000 + 64)
+
+typedef struct _ZBlockHeader
+{
+  char magic[8];
+  guint32 version;
+  guint32 block_size;
+  guint64 size;
+  guint64 n_blocks;
+  guint64 index_offset;
+} ZBlockHeader;
+
+typedef struct _ZBlockIndexEntry
+{
+  guint64 offset;
+  guint32 compressed_len;
+  guint32 len;
+} ZBlockIndexEntry;
+
+typedef struct _ZBlockJob
+{
+  guint8 *in;
+  gsize len;
+  guint8 *out;
+  gsize out_size;
+  gsize out_len;
+  GError *error;
+  gboolean done;
+} ZBlockJob;
+
+typedef struct _ZBlockPool
+{
+  GMutex *lock;
+  GCond *done_cond;
+} ZBlockPool;
+
+/* Where "restore" puts the contents of a file */
+typedef struct _RestoreRange
+{
+  /* Added to every address in the file.  Binary and compressed files
+   * hold no addresses, so byte N of those goes to LOAD_OFFSET + N */
+  gint64 load_offset;
+  /* Only restore [LOAD_START .. LOAD_END), if LOAD_END isn't zero.
+   * These are addresses in a process image, before LOAD_OFFSET is
+   * added, and offsets into binary and compressed files */
+  guint64 load_start;
+  guint64 load_end;
+} RestoreRange;
+
+static struct cmd_list_element *dumplist;
+static struct cmd_list_element *appendlist;
+static struct cmd_list_element *compressedlist;
+static struct cmd_list_element *zblockslist;
+
+/* Cleared the first time we're refused direct access to the target's
+ * memory so we don't keep asking */
+static gboolean procmem_permitted = TRUE;
+
+static gboolean
+parse_address (const char *str, guint64 *address)
+{
+  char *end;
+
+  *address = g_ascii_strtoull (str, &end, 0);
+  return end != str && *end == '\0';
+}
+
+static void
+dump_print_progress (const char *verb,
+                     guint64 done,
+                     guint64 count,
+                     GTimer *timer)
+{
+  double elapsed = g_timer_elapsed (timer, NULL);
+
+  g_print ("\r%s %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+           " MiB (%.1f MiB/s)", verb, done >> 20, count >> 20,
+           elapsed > 0 ? (done >> 20) / elapsed : 0.0);
+}
+
+static gpointer
+dump_writer_thread (gpointer data)
+{
+  DumpStream *stream = data;
+  DumpBlock *block;
+
+  while ((block = g_async_queue_pop (stream->full))->len != 0)
+    {
+      /* After a failure keep recycling blocks so the reader never
+       * blocks waiting for an empty one. */
+      if (!DUMP_STREAM_FAILED (stream))
+        {
+          if (stream->file)
+            {
+              if (fwrite (block->buf, block->len, 1, stream->file) != 1)
+                stream->write_errno = errno;
+            }
+          else
+            g_output_stream_write_all (stream->ostream, block->buf,
+                                       block->len, NULL, NULL,
+                                       &stream->error);
+        }
+      g_async_queue_push (stream->empty, block);
+    }
+
+  return NULL;
+}
+
+/* Stream COUNT bytes of target memory starting at LO into STREAM,
+ * reading the next block while the previous one is being written. */
+static gboolean
+dump_memory_stream (DumpStream *stream,
+                    const char *filename,
+                    guint64 lo,
+                    guint64 count)
+{
+  DumpBlock blocks[2];
+  DumpBlock end_of_stream = { NULL, 0, 0 };
+  DumpBlock *block;
+  GError *error = NULL;
+  GThread *writer;
+  GTimer *timer;
+  guint64 offset;
+  gsize len = 0;
+  double last_report = 0;
+  int i;
+
+  stream->empty = g_async_queue_new ();
+  stream->full = g_async_queue_new ();
+  stream->write_errno = 0;
+  stream->error = NULL;
+  for (i = 0; i < 2; i++)
+    {
+      blocks[i].buf = g_malloc (MIN (count, DUMP_BLOCK_SIZE));
+      g_async_queue_push (stream->empty, &blocks[i]);
+    }
+
+  timer = g_timer_new ();
+  writer = g_thread_create (dump_writer_thread, stream, TRUE, NULL);
+
+  for (offset = 0; offset < count; offset += len)
+    {
+      block = g_async_queue_pop (stream->empty);
+      if (DUMP_STREAM_FAILED (stream))
+        break;
+
+      len = MIN (DUMP_BLOCK_SIZE, count - offset);
+      if (!bosh_memory_read (lo + offset, block->buf, len, &error))
+        break;
+
+      block->offset = offset;
+      block->len = len;
+      g_async_queue_push (stream->full, block);
+
+      if (count >= DUMP_PROGRESS_THRESHOLD
+          && g_timer_elapsed (timer, NULL) - last_report >= 1.0)
+        {
+          last_report = g_timer_elapsed (timer, NULL);
+          dump_print_progress (_("Dumped"), offset + len, count, timer);
+        }
+    }
+
+  g_async_queue_push (stream->full, &end_of_stream);
+  g_thread_join (writer);
+
+  if (count >= DUMP_PROGRESS_THRESHOLD && offset >= count)
+    {
+      dump_print_progress (_("Dumped"), count, count, timer);
+      g_print ("\n");
+    }
+
+  g_timer_destroy (timer);
+  for (i = 0; i < 2; i++)
+    g_free (blocks[i].buf);
+  g_async_queue_unref (stream->empty);
+  g_async_queue_unref (stream->full);
+
+  if (error)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+  if (stream->write_errno)
+    {
+      g_print ("%s: %s.\n", filename, g_strerror (stream->write_errno));
+      return FALSE;
+    }
+  if (stream->error)
+    {
+      g_print ("%s: %s.\n", filename, stream->error->message);
+      g_error_free (stream->error);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+/* Open FILENAME for writing through a gzip compressor.  The data is
+ * compressed in whatever size pieces it is written in, so only a
+ * bounded amount is ever buffered. */
+static GOutputStream *
+dump_gzip_open (const char *filename)
+{
+  GFile *file = g_file_new_for_path (filename);
+  GFileOutputStream *fstream;
+  GZlibCompressor *compressor;
+  GOutputStream *ostream;
+  GError *error = NULL;
+
+  fstream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE,
+                            NULL, &error);
+  g_object_unref (file);
+  if (!fstream)
+    {
+      g_print ("%s: %s.\n", filename, error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+  ostream = g_converter_output_stream_new (G_OUTPUT_STREAM (fstream),
+                                           G_CONVERTER (compressor));
+  g_object_unref (compressor);
+  g_object_unref (fstream);
+
+  return ostream;
+}
+
+/* Run all of IN_LEN bytes at IN through CONVERTER into *OUT, growing
+ * it as needed. */
+static gboolean
+zblock_convert (GConverter *converter,
+                const guint8 *in,
+                gsize in_len,
+                guint8 **out,
+                gsize *out_size,
+                gsize *out_len,
+                GError **error)
+{
+  gsize in_done = 0;
+  gsize out_done = 0;
+
+  while (TRUE)
+    {
+      GConverterResult result;
+      gsize bytes_read;
+      gsize bytes_written;
+      GError *local_error = NULL;
+
+      result = g_converter_convert (converter,
+                                    in + in_done, in_len - in_done,
+                                    *out + out_done, *out_size - out_done,
+                                    G_CONVERTER_INPUT_AT_END,
+                                    &bytes_read, &bytes_written,
+                                    &local_error);
+      if (result == G_CONVERTER_ERROR)
+        {
+          if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NO_SPACE))
+            {
+              g_propagate_error (error, local_error);
+              return FALSE;
+            }
+          g_error_free (local_error);
+          *out_size *= 2;
+          *out = g_realloc (*out, *out_size);
+          continue;
+        }
+
+      in_done += bytes_read;
+      out_done += bytes_written;
+      if (result == G_CONVERTER_FINISHED)
+        break;
+    }
+
+  *out_len = out_done;
+  return TRUE;
+}
+
+static void
+zblock_compress_job (gpointer data, gpointer user_data)
+{
+  ZBlockJob *job = data;
+  ZBlockPool *pool = user_data;
+  GZlibCompressor *compressor;
+
+  compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB, -1);
+  zblock_convert (G_CONVERTER (compressor), job->in, job->len,
+                  &job->out, &job->out_size, &job->out_len, &job->error);
+  g_object_unref (compressor);
+
+  g_mutex_lock (pool->lock);
+  job->done = TRUE;
+  g_cond_broadcast (pool->done_cond);
+  g_mutex_unlock (pool->lock);
+}
+
+/* Write COUNT bytes of target memory at LO to FILENAME in the block
+ * compressed format.  Up to two blocks per thread are in flight, so
+ * memory use is bounded whatever COUNT is. */
+static void
+dump_zblocks (const char *filename, guint64 lo, guint64 count)
+{
+  FILE *file;
+  ZBlockHeader header;
+  ZBlockIndexEntry *index;
+  ZBlockJob *jobs;
+  ZBlockPool pool;
+  GThreadPool *thread_pool;
+  GError *error = NULL;
+  GTimer *timer;
+  guint64 n_blocks = (count + DUMP_BLOCK_SIZE - 1) / DUMP_BLOCK_SIZE;
+  guint64 queued = 0;
+  guint64 written = 0;
+  guint64 offset = sizeof (header);
+  double last_report = 0;
+  int write_errno = 0;
+  int n_threads;
+  int max_jobs;
+  int i;
+
+  file = fopen (filename, "wb");
+  if (!file)
+    {
+      g_print ("%s: %s.\n", filename, g_strerror (errno));
+      return;
+    }
+
+  n_threads = CLAMP (sysconf (_SC_NPROCESSORS_ONLN), 1, ZBLOCK_MAX_THREADS);
+  max_jobs = MIN (2 * n_threads, MAX (n_blocks, 1));
+
+  jobs = g_new0 (ZBlockJob, max_jobs);
+  for (i = 0; i < max_jobs; i++)
+    {
+      jobs[i].in = g_malloc (DUMP_BLOCK_SIZE);
+      jobs[i].out_size = ZBLOCK_COMPRESS_BOUND (DUMP_BLOCK_SIZE);
+      jobs[i].out = g_malloc (jobs[i].out_size);
+    }
+  index = g_new (ZBlockIndexEntry, MAX (n_blocks, 1));
+
+  pool.lock = g_mutex_new ();
+  pool.done_cond = g_cond_new ();
+  thread_pool = g_thread_pool_new (zblock_compress_job, &pool,
+                                   n_threads, TRUE, NULL);
+  timer = g_timer_new ();
+
+  if (fseek (file, sizeof (header), SEEK_SET) != 0)
+    write_errno = errno;
+
+  while (written < n_blocks && !write_errno && !error)
+    {
+      ZBlockJob *job;
+
+      /* Keep every thread busy... */
+      while (queued < n_blocks && queued - written < max_jobs)
+        {
+          guint64 block_offset = queued * DUMP_BLOCK_SIZE;
+
+          job = &jobs[queued % max_jobs];
+          job->len = MIN (DUMP_BLOCK_SIZE, count - block_offset);
+          if (!bosh_memory_read (lo + block_offset, job->in, job->len,
+                                 &error))
+            break;
+          job->done = FALSE;
+          g_thread_pool_push (thread_pool, job, NULL);
+          queued++;
+        }
+      if (error)
+        break;
+
+      /* ...while the blocks are written out in order */
+      job = &jobs[written % max_jobs];
+      g_mutex_lock (pool.lock);
+      while (!job->done)
+        g_cond_wait (pool.done_cond, pool.lock);
+      g_mutex_unlock (pool.lock);
+
+      if (job->error)
+        {
+          error = job->error;
+          job->error = NULL;
+          break;
+        }
+      if (fwrite (job->out, job->out_len, 1, file) != 1)
+        {
+          write_errno = errno;
+          break;
+        }
+      index[written].offset = offset;
+      index[written].compressed_len = job->out_len;
+      index[written].len = job->len;
+      offset += job->out_len;
+      written++;
+
+      if (count >= DUMP_PROGRESS_THRESHOLD
+          && g_timer_elapsed (timer, NULL) - last_report >= 1.0)
+        {
+          last_report = g_timer_elapsed (timer, NULL);
+          dump_print_progress (_("Dumped"),
+                               MIN (written * DUMP_BLOCK_SIZE, count),
+                               count, timer);
+        }
+    }
+
+  /* Wait for anything still being compressed */
+  g_thread_pool_free (thread_pool, FALSE, TRUE);
+  g_mutex_free (pool.lock);
+  g_cond_free (pool.done_cond);
+  for (i = 0; i < max_jobs; i++)
+    {
+      if (jobs[i].error)
+        g_error_free (jobs[i].error);
+      g_free (jobs[i].in);
+      g_free (jobs[i].out);
+    }
+  g_free (jobs);
+
+  if (written == n_blocks && !write_errno)
+    {
+      memset (&header, 0, sizeof (header));
+      memcpy (header.magic, ZBLOCK_MAGIC, sizeof (header.magic));
+      header.version = ZBLOCK_VERSION;
+      header.block_size = DUMP_BLOCK_SIZE;
+      header.size = count;
+      header.n_blocks = n_blocks;
+      header.index_offset = offset;
+
+      if ((n_blocks
+           && fwrite (index, sizeof (ZBlockIndexEntry) * n_blocks,
+                      1, file) != 1)
+          || fseek (file, 0, SEEK_SET) != 0
+          || fwrite (&header, sizeof (header), 1, file) != 1)
+        write_errno = errno;
+      else if (count >= DUMP_PROGRESS_THRESHOLD)
+        {
+          dump_print_progress (_("Dumped"), count, count, timer);
+          g_print ("\n");
+        }
+    }
+  g_free (index);
+  g_timer_destroy (timer);
+
+  if (fclose (file) != 0 && !write_errno)
+    write_errno = errno;
+
+  if (!error && !write_errno)
+    return;
+
+  if (error)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+    }
+  else
+    g_print ("%s: %s.\n", filename, g_strerror (write_errno));
+
+  /* Without its header and index the file is no use to anyone */
+  if (unlink (filename) != 0)
+    g_print (_("Failed to remove %s: %s.\n"), filename, g_strerror (errno));
+}
+
+/* Copy COUNT bytes of memory starting at LO straight from a local
+ * target process into FILE, which must have been opened for writing
+ * (not appending) and still be empty.  The range is split between
+ * several threads that each read and write their own pieces.  Returns
+ * FALSE if direct access isn't possible, leaving FILE empty for the
+ * caller to fall back to streaming. */
+static gboolean
+dump_memory_direct (FILE *file, guint64 lo, guint64 count)
+{
+  int pid = bosh_get_target_pid ();
+  GError *error = NULL;
+  GTimer *timer;
+  int fd;
+
+  /* Reads come from the core file when there is one */
+  if (pid == -1 || !procmem_permitted || bosh_core_get_current ())
+    return FALSE;
+
+  fd = fileno (file);
+  timer = g_timer_new ();
+  if (bosh_procmem_copy_to_fd (pid, lo, count, fd, 0, &error))
+    {
+      if (count >= DUMP_PROGRESS_THRESHOLD)
+        {
+          dump_print_progress (_("Dumped"), count, count, timer);
+          g_print ("\n");
+        }
+      g_timer_destroy (timer);
+      return TRUE;
+    }
+  g_timer_destroy (timer);
+
+  if (error->domain == G_FILE_ERROR
+      && (error->code == G_FILE_ERROR_PERM
+          || error->code == G_FILE_ERROR_ACCES))
+    procmem_permitted = FALSE;
+  g_error_free (error);
+
+  /* Discard whatever was written before the failure */
+  if (ftruncate (fd, 0) != 0)
+    g_print (_("Failed to truncate dump file: %s.\n"), g_strerror (errno));
+  rewind (file);
+  return FALSE;
+}
+
+/* dump memory FILE LO HI, or append memory with MODE "ab".  FORMAT
+ * is "binary", "gzip" or "zblocks". */
+static void
+dump_memory_to_file (char *args, const char *mode, const char *format)
+{
+  char **argv = args ? g_strsplit_set (g_strstrip (args), " \t", -1) : NULL;
+  DumpStream stream;
+  guint64 lo;
+  guint64 hi;
+
+  if (!argv || g_strv_length (argv) != 3
+      || !parse_address (argv[1], &lo) || !parse_address (argv[2], &hi))
+    {
+      bosh_command_error_no_argument (_("FILE LO HI"));
+      g_strfreev (argv);
+      return;
+    }
+  if (hi <= lo)
+    {
+      g_print (_("Invalid memory address range (start >= end).\n"));
+      g_strfreev (argv);
+      return;
+    }
+
+  if (strcmp (format, "zblocks") == 0)
+    {
+      dump_zblocks (argv[0], lo, hi - lo);
+      g_strfreev (argv);
+      return;
+    }
+
+  memset (&stream, 0, sizeof (stream));
+  if (strcmp (format, "gzip") == 0)
+    {
+      GError *error = NULL;
+
+      stream.ostream = dump_gzip_open (argv[0]);
+      if (!stream.ostream)
+        {
+          g_strfreev (argv);
+          return;
+        }
+
+      /* Closing flushes the end of the compressed stream */
+      if (dump_memory_stream (&stream, argv[0], lo, hi - lo)
+          && !g_output_stream_close (stream.ostream, NULL, &error))
+        {
+          g_print ("%s: %s.\n", argv[0], error->message);
+          g_error_free (error);
+        }
+      g_object_unref (stream.ostream);
+      g_strfreev (argv);
+      return;
+    }
+
+  stream.file = fopen (argv[0], mode);
+  if (!stream.file)
+    {
+      g_print ("%s: %s.\n", argv[0], g_strerror (errno));
+      g_strfreev (argv);
+      return;
+    }
+
+  /* Pieces of a direct dump are written out of order, which an
+   * append-mode file would ignore. */
+  if (*mode != 'w' || !dump_memory_direct (stream.file, lo, hi - lo))
+    dump_memory_stream (&stream, argv[0], lo, hi - lo);
+  if (fclose (stream.file) != 0)
+    g_print ("%s: %s.\n", argv[0], g_strerror (errno));
+  g_strfreev (argv);
+}
+
+/* Write every readable mapping of a local process to a sparse image
+ * that "restore" understands. */
+static void
+bosh_dump_process_command (char *args, int from_tty)
+{
+  BoshProcessImageStats stats;
+  GError *error = NULL;
+  GTimer *timer;
+  int pid = bosh_get_target_pid ();
+
+  if (pid == -1)
+    {
+      g_print (_("\"dump process\" needs a local process (see --pid).\n"));
+      return;
+    }
+  if (!args || !*g_strstrip (args))
+    {
+      bosh_command_error_no_argument (_("FILE"));
+      return;
+    }
+
+  timer = g_timer_new ();
+  if (!bosh_procmem_dump_process (pid, args, &stats, &error))
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      g_timer_destroy (timer);
+      return;
+    }
+
+  g_print (_("Dumped %u mappings (%u skipped): "
+             "%" G_GUINT64_FORMAT " MiB mapped, "
+             "%" G_GUINT64_FORMAT " MiB resident, "
+             "%" G_GUINT64_FORMAT " MiB written in %.1fs.\n"),
+           stats.n_regions, stats.n_skipped,
+           stats.mapped_bytes >> 20,
+           stats.resident_bytes >> 20,
+           stats.written_bytes >> 20,
+           g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+}
+
+static gboolean
+restore_write_memory (guint64 address, const void *buf, gsize len)
+{
+  GError *error = NULL;
+
+  if (bosh_procmem_write (bosh_get_target_pid (), address, buf, len, &error))
+    return TRUE;
+
+  g_print (_("restore: memory write failed (%s).\n"), error->message);
+  g_error_free (error);
+  return FALSE;
+}
+
+/* A raw binary file being restored, mapped a block at a time */
+typedef struct _RestoreFileMap
+{
+  guint8 *addr;
+  gsize len;
+  /* Offset of the first byte to restore within the mapping */
+  gsize start;
+  /* Everything before this has been written and dropped */
+  gsize dropped;
+} RestoreFileMap;
+
+/* Write COUNT bytes to target memory at ADDRESS, DUMP_BLOCK_SIZE at a
+ * time.  READ_CHUNK returns a pointer to the LEN bytes at OFFSET in
+ * the source, which only needs to stay valid until the next call, so
+ * sources never have to be held in memory all at once. */
+static gboolean
+restore_memory_chunked (guint64 address,
+                        guint64 count,
+                        const guint8 *(*read_chunk) (void *data,
+                                                     guint64 offset,
+                                                     gsize len),
+                        void *data)
+{
+  GTimer *timer = g_timer_new ();
+  double last_report = 0;
+  guint64 offset;
+  gboolean ret = TRUE;
+
+  for (offset = 0; offset < count; )
+    {
+      gsize len = MIN (DUMP_BLOCK_SIZE, count - offset);
+
+      if (!restore_write_memory (address + offset,
+                                 read_chunk (data, offset, len), len))
+        {
+          ret = FALSE;
+          break;
+        }
+      offset += len;
+
+      if (count >= DUMP_PROGRESS_THRESHOLD
+          && g_timer_elapsed (timer, NULL) - last_report >= 1.0)
+        {
+          last_report = g_timer_elapsed (timer, NULL);
+          dump_print_progress (_("Restored"), offset, count, timer);
+        }
+    }
+
+  if (count >= DUMP_PROGRESS_THRESHOLD && last_report > 0)
+    {
+      dump_print_progress (_("Restored"), offset, count, timer);
+      g_print ("\n");
+    }
+  g_timer_destroy (timer);
+
+  return ret;
+}
+
+static const guint8 *
+read_file_map_chunk (void *data, guint64 offset, gsize len)
+{
+  RestoreFileMap *map = data;
+  gsize page_size = getpagesize ();
+  gsize done = (map->start + offset) & ~(page_size - 1);
+
+  /* Drop the pages already written so the mapping never holds on to
+   * more than a block or so of the file */
+  if (done > map->dropped)
+    {
+      madvise (map->addr + map->dropped, done - map->dropped, MADV_DONTNEED);
+      map->dropped = done;
+    }
+
+  return map->addr + map->start + offset;
+}
+
+/* Restore a raw binary file such as one written by "dump memory".
+ * LOAD_START and LOAD_END are offsets within the file. */
+static void
+restore_binary_file (const char *filename, RestoreRange *range)
+{
+  RestoreFileMap map;
+  struct stat st;
+  off_t map_offset;
+  guint64 len;
+  int fd;
+
+  fd = open (filename, O_RDONLY);
+  if (fd == -1 || fstat (fd, &st) != 0)
+    {
+      g_print ("%s: %s.\n", filename, g_strerror (errno));
+      if (fd != -1)
+        close (fd);
+      return;
+    }
+
+  len = st.st_size;
+  if (len <= range->load_start)
+    {
+      g_print (_("Start address is greater than length of binary "
+                 "file %s.\n"), filename);
+      close (fd);
+      return;
+    }
+
+  /* Chop off anything beyond LOAD_END, and the bytes skipped by
+   * LOAD_START */
+  if (range->load_end != 0 && range->load_end < len)
+    len = range->load_end;
+  len -= range->load_start;
+
+  g_print (_("Restoring binary file %s into memory "
+             "(0x%" G_GINT64_MODIFIER "x to 0x%" G_GINT64_MODIFIER "x)\n"),
+           filename,
+           range->load_start + range->load_offset,
+           range->load_start + range->load_offset + len);
+
+  /* Map just the part of the file being restored */
+  map_offset = range->load_start & ~((guint64)getpagesize () - 1);
+  map.start = range->load_start - map_offset;
+  map.len = map.start + len;
+  map.dropped = 0;
+  map.addr = mmap (NULL, map.len, PROT_READ, MAP_PRIVATE, fd, map_offset);
+  close (fd);
+  if (map.addr == MAP_FAILED)
+    {
+      g_print ("%s: %s.\n", filename, g_strerror (errno));
+      return;
+    }
+  madvise (map.addr, map.len, MADV_SEQUENTIAL);
+
+  restore_memory_chunked (range->load_start + range->load_offset, len,
+                          read_file_map_chunk, &map);
+  munmap (map.addr, map.len);
+}
+
+/* Write the resident pages recorded in a process image written by
+ * "dump process" back into the target.  Only extents within
+ * [LOAD_START, LOAD_END) (target addresses, if given) are restored. */
+static void
+restore_process_image (const char *filename, RestoreRange *range)
+{
+  BoshProcessImage *image;
+  GError *error = NULL;
+  guint8 *buf;
+  guint64 total = 0;
+  guint i;
+
+  image = bosh_process_image_open (filename, &error);
+  if (!image)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  buf = g_malloc (DUMP_BLOCK_SIZE);
+
+  for (i = 0; i < image->extents->len; i++)
+    {
+      BoshProcessImageExtent *extent =
+        &g_array_index (image->extents, BoshProcessImageExtent, i);
+      guint64 start = MAX (extent->start, range->load_start);
+      guint64 end = extent->start + extent->len;
+      guint64 address;
+
+      if (range->load_end != 0)
+        end = MIN (end, range->load_end);
+
+      for (address = start; address < end; )
+        {
+          gsize len = MIN (DUMP_BLOCK_SIZE, end - address);
+          guint64 file_offset =
+            extent->data_offset + (address - extent->start);
+
+          /* Holes in the image read back as zeros */
+          if (pread (image->fd, buf, len, file_offset) != (ssize_t)len)
+            {
+              g_print ("%s: %s.\n", filename, g_strerror (errno));
+              goto out;
+            }
+          if (!restore_write_memory (address + range->load_offset, buf, len))
+            goto out;
+
+          total += len;
+          address += len;
+        }
+    }
+
+  g_print (_("Restored %" G_GUINT64_FORMAT " MiB from %u mappings of %s.\n"),
+           total >> 20, image->regions->len, filename);
+
+out:
+  g_free (buf);
+  bosh_process_image_free (image);
+}
+
+/* Restore a gzip file written by "dump compressed memory".  It has to
+ * be decompressed from the start, but only a block at a time. */
+static void
+restore_gzip_file (const char *filename, RestoreRange *range)
+{
+  GFile *file = g_file_new_for_path (filename);
+  GFileInputStream *fstream;
+  GZlibDecompressor *decompressor;
+  GInputStream *istream;
+  GError *error = NULL;
+  guint8 *buf;
+  guint64 offset = 0;
+  guint64 restored = 0;
+
+  fstream = g_file_read (file, NULL, &error);
+  g_object_unref (file);
+  if (!fstream)
+    {
+      g_print ("%s: %s.\n", filename, error->message);
+      g_error_free (error);
+      return;
+    }
+
+  decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+  istream = g_converter_input_stream_new (G_INPUT_STREAM (fstream),
+                                          G_CONVERTER (decompressor));
+  g_object_unref (decompressor);
+  g_object_unref (fstream);
+
+  buf = g_malloc (DUMP_BLOCK_SIZE);
+
+  while (range->load_end == 0 || offset < range->load_end)
+    {
+      gsize len;
+      guint64 start;
+      guint64 end;
+
+      if (!g_input_stream_read_all (istream, buf, DUMP_BLOCK_SIZE, &len,
+                                    NULL, &error))
+        {
+          g_print ("%s: %s.\n", filename, error->message);
+          g_error_free (error);
+          goto out;
+        }
+      if (len == 0)
+        break;
+
+      /* Skip up to LOAD_START and stop at LOAD_END (file relative) */
+      start = MAX (offset, range->load_start);
+      end = offset + len;
+      if (range->load_end != 0)
+        end = MIN (end, range->load_end);
+      if (start < end)
+        {
+          if (!restore_write_memory (start + range->load_offset,
+                                     buf + (start - offset), end - start))
+            goto out;
+          restored += end - start;
+        }
+      offset += len;
+    }
+
+  if (offset <= range->load_start)
+    g_print (_("Start address is greater than length of compressed "
+               "file %s.\n"), filename);
+  else
+    g_print (_("Restored %" G_GUINT64_FORMAT " bytes from compressed "
+               "file %s.\n"), restored, filename);
+
+out:
+  g_free (buf);
+  g_object_unref (istream);
+}
+
+/* Restore a file written by "dump compressed blocks memory".  Only the
+ * blocks overlapping the requested range are read and decompressed. */
+static void
+restore_zblocks_file (const char *filename, RestoreRange *range)
+{
+  FILE *file;
+  ZBlockHeader header;
+  ZBlockIndexEntry *index = NULL;
+  GZlibDecompressor *decompressor = NULL;
+  guint8 *in = NULL;
+  guint8 *out = NULL;
+  gsize in_size;
+  gsize out_size;
+  guint64 restored = 0;
+  guint64 end_offset;
+  guint64 i;
+  struct stat st;
+
+  file = fopen (filename, "rb");
+  if (!file)
+    {
+      g_print ("%s: %s.\n", filename, g_strerror (errno));
+      return;
+    }
+
+  if (fread (&header, sizeof (header), 1, file) != 1)
+    goto read_error;
+  if (header.version != ZBLOCK_VERSION || header.block_size == 0
+      || header.block_size > ZBLOCK_MAX_BLOCK_SIZE)
+    {
+      g_print (_("%s: unsupported compressed file version.\n"), filename);
+      goto out;
+    }
+
+  /* Don't trust the header with allocations until it's been checked
+   * against the file */
+  if (fstat (fileno (file), &st) != 0)
+    goto read_error;
+  if (header.n_blocks != (header.size + header.block_size - 1)
+                         / header.block_size
+      || header.index_offset < sizeof (header)
+      || header.index_offset > (guint64)st.st_size
+      || header.n_blocks > ((guint64)st.st_size - header.index_offset)
+                           / sizeof (ZBlockIndexEntry))
+    {
+      g_print (_("%s: file is corrupt.\n"), filename);
+      goto out;
+    }
+  if (header.size <= range->load_start)
+    {
+      g_print (_("Start address is greater than length of compressed "
+                 "file %s.\n"), filename);
+      goto out;
+    }
+  end_offset = header.size;
+  if (range->load_end != 0)
+    end_offset = MIN (end_offset, range->load_end);
+
+  index = g_new (ZBlockIndexEntry, MAX (header.n_blocks, 1));
+  if (fseek (file, header.index_offset, SEEK_SET) != 0
+      || fread (index, sizeof (ZBlockIndexEntry),
+                header.n_blocks, file) != header.n_blocks)
+    goto read_error;
+
+  in_size = header.block_size;
+  for (i = 0; i < header.n_blocks; i++)
+    {
+      if (index[i].offset < sizeof (header)
+          || index[i].offset > header.index_offset
+          || index[i].compressed_len > header.index_offset - index[i].offset
+          || index[i].compressed_len
+             > ZBLOCK_COMPRESS_BOUND (header.block_size)
+          || index[i].len > header.block_size)
+        {
+          g_print (_("%s: file is corrupt.\n"), filename);
+          goto out;
+        }
+      in_size = MAX (in_size, index[i].compressed_len);
+    }
+  in = g_malloc (in_size);
+  out_size = header.block_size;
+  out = g_malloc (out_size);
+
+  decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+
+  for (i = range->load_start / header.block_size;
+       i < header.n_blocks && i * header.block_size < end_offset; i++)
+    {
+      guint64 block_offset = i * header.block_size;
+      guint64 start = MAX (block_offset, range->load_start);
+      guint64 end = MIN (block_offset + index[i].len, end_offset);
+      GError *error = NULL;
+      gsize len;
+
+      if (fseek (file, index[i].offset, SEEK_SET) != 0
+          || fread (in, index[i].compressed_len, 1, file) != 1)
+        goto read_error;
+
+      /* zblock_convert may move OUT if a block turns out to be bigger
+       * than it should */
+      g_converter_reset (G_CONVERTER (decompressor));
+      if (!zblock_convert (G_CONVERTER (decompressor),
+                           in, index[i].compressed_len,
+                           &out, &out_size, &len, &error))
+        {
+          g_print ("%s: %s.\n", filename, error->message);
+          g_error_free (error);
+          goto out;
+        }
+      if (len != index[i].len)
+        {
+          g_print (_("%s: block %" G_GUINT64_FORMAT " is corrupt.\n"),
+                   filename, i);
+          goto out;
+        }
+
+      if (!restore_write_memory (start + range->load_offset,
+                                 out + (start - block_offset),
+                                 end - start))
+        goto out;
+      restored += end - start;
+    }
+
+  g_print (_("Restored %" G_GUINT64_FORMAT " bytes from compressed "
+             "file %s.\n"), restored, filename);
+  goto out;
+
+read_error:
+  if (feof (file))
+    g_print (_("%s: file is truncated.\n"), filename);
+  else
+    g_print ("%s: %s.\n", filename, g_strerror (errno));
+out:
+  if (decompressor)
+    g_object_unref (decompressor);
+  g_free (in);
+  g_free (out);
+  g_free (index);
+  fclose (file);
+}
+
+/* Whether FILENAME was written by "dump compressed blocks memory"
+ * rather than being a plain gzip file */
+static gboolean
+restore_is_zblocks_file (const char *filename)
+{
+  char magic[sizeof (ZBLOCK_MAGIC) - 1];
+  FILE *file = fopen (filename, "rb");
+  gboolean zblocks;
+
+  if (!file)
+    return FALSE;
+  zblocks = (fread (magic, sizeof (magic), 1, file) == 1
+             && memcmp (magic, ZBLOCK_MAGIC, sizeof (magic)) == 0);
+  fclose (file);
+  return zblocks;
+}
+
+static gboolean
+parse_offset (const char *str, gint64 *offset)
+{
+  char *end;
+
+  *offset = g_ascii_strtoll (str, &end, 0);
+  return end != str && *end == '\0';
+}
+
+/* restore FILE [binary|compressed] [OFFSET [START [END]]] */
+static void
+bosh_restore_command (char *args, int from_tty)
+{
+  char **argv = args ? g_strsplit_set (g_strstrip (args), " \t", -1) : NULL;
+  RestoreRange range = { 0, 0, 0 };
+  guint argc = argv ? g_strv_length (argv) : 0;
+  gboolean binary = FALSE;
+  gboolean compressed = FALSE;
+  guint i = 1;
+
+  if (argc == 0 || !*argv[0])
+    {
+      bosh_command_error_no_argument (_("FILE"));
+      g_strfreev (argv);
+      return;
+    }
+
+  if (i < argc && strcmp (argv[i], "binary") == 0)
+    {
+      binary = TRUE;
+      i++;
+    }
+  else if (i < argc && strcmp (argv[i], "compressed") == 0)
+    {
+      compressed = TRUE;
+      i++;
+    }
+  if ((i < argc && !parse_offset (argv[i++], &range.load_offset))
+      || (i < argc && !parse_address (argv[i++], &range.load_start))
+      || (i < argc && !parse_address (argv[i++], &range.load_end))
+      || i < argc)
+    {
+      g_print (_("Usage: restore FILE [binary|compressed] "
+                 "[OFFSET [START [END]]]\n"));
+      g_strfreev (argv);
+      return;
+    }
+  if (range.load_end != 0 && range.load_end <= range.load_start)
+    {
+      g_print (_("Start must be less than end.\n"));
+      g_strfreev (argv);
+      return;
+    }
+
+  if (bosh_get_target_pid () == -1)
+    g_print (_("\"restore\" needs a local process (see --pid).\n"));
+  else if (bosh_process_image_is_image (argv[0]))
+    restore_process_image (argv[0], &range);
+  else if (compressed && restore_is_zblocks_file (argv[0]))
+    restore_zblocks_file (argv[0], &range);
+  else if (compressed)
+    restore_gzip_file (argv[0], &range);
+  else if (binary)
+    restore_binary_file (argv[0], &range);
+  else
+    g_print (_("%s: not a process image written by \"dump process\"; "
+               "use \"restore FILE binary\"\n"
+               "for a raw file.\n"), argv[0]);
+
+  g_strfreev (argv);
+}
+
+static void
+bosh_dump_command (char *args, int from_tty)
+{
+  g_print (_("\"dump\" must be followed by a subcommand.\n"));
+  help_list (dumplist, "dump ", -1, NULL);
+}
+
+static void
+bosh_append_command (char *args, int from_tty)
+{
+  g_print (_("\"append\" must be followed by a subcommand.\n"));
+  help_list (appendlist, "append ", -1, NULL);
+}
+
+static void
+bosh_dump_memory_command (char *args, int from_tty)
+{
+  dump_memory_to_file (args, "wb", "binary");
+}
+
+static void
+bosh_append_memory_command (char *args, int from_tty)
+{
+  dump_memory_to_file (args, "ab", "binary");
+}
+
+static void
+bosh_dump_compressed_command (char *args, int from_tty)
+{
+  g_print (_("\"dump compressed\" must be followed by a subcommand.\n"));
+  help_list (compressedlist, "dump compressed ", -1, NULL);
+}
+
+static void
+bosh_dump_zblocks_command (char *args, int from_tty)
+{
+  g_print (_("\"dump compressed blocks\" must be followed by a "
+             "subcommand.\n"));
+  help_list (zblockslist, "dump compressed blocks ", -1, NULL);
+}
+
+static void
+bosh_dump_compressed_memory_command (char *args, int from_tty)
+{
+  dump_memory_to_file (args, "wb", "gzip");
+}
+
+static void
+bosh_dump_zblocks_memory_command (char *args, int from_tty)
+{
+  dump_memory_to_file (args, "wb", "zblocks");
+}
+
+void
+bosh_dump_init_commands (void)
+{
+  bosh_command_list_add_prefix (&cmdlist, "dump", class_vars,
+                                bosh_dump_command,
+                                _("Dump target memory to a local file."),
+                                &dumplist, "dump ", 0);
+
+  bosh_command_list_add_prefix (&cmdlist, "append", class_vars,
+                                bosh_append_command,
+                                _("Append target memory to a local file."),
+                                &appendlist, "append ", 0);
+
+  bosh_command_list_add (&dumplist, "memory", class_vars,
+                         bosh_dump_memory_command,
+                         _("Write the contents of memory to a raw binary "
+                           "file: dump memory FILE LO HI.\n"
+                           "The memory in the range [LO .. HI) is copied "
+                           "to FILE a block at a time,\n"
+                           "reading the next block while the last one is "
+                           "written out.  The memory of a\n"
+                           "local process is copied straight from "
+                           "/proc/PID/mem by several threads."));
+
+  bosh_command_list_add_prefix (&dumplist, "compressed", class_vars,
+                                bosh_dump_compressed_command,
+                                _("Dump target memory to a compressed "
+                                  "file."),
+                                &compressedlist, "dump compressed ", 0);
+
+  bosh_command_list_add (&compressedlist, "memory", class_vars,
+                         bosh_dump_compressed_memory_command,
+                         _("Write the contents of memory to a gzip file: "
+                           "dump compressed memory FILE LO HI.\n"
+                           "The memory in the range [LO .. HI) is "
+                           "compressed as it is read, so it is\n"
+                           "never held in memory all at once.  Read it "
+                           "back with\n"
+                           "\"restore FILE compressed\"."));
+
+  bosh_command_list_add_prefix (&compressedlist, "blocks", class_vars,
+                                bosh_dump_zblocks_command,
+                                _("Dump target memory to a file of "
+                                  "independently compressed blocks."),
+                                &zblockslist, "dump compressed blocks ", 0);
+
+  bosh_command_list_add (&zblockslist, "memory", class_vars,
+                         bosh_dump_zblocks_memory_command,
+                         _("Write the contents of memory to a block "
+                           "compressed file:\n"
+                           "dump compressed blocks memory FILE LO HI.\n"
+                           "The range [LO .. HI) is cut into 1 MiB blocks "
+                           "that are compressed on\n"
+                           "several threads and indexed, so \"restore FILE "
+                           "compressed\" only\n"
+                           "decompresses the blocks it needs."));
+
+  bosh_command_list_add (&dumplist, "process", class_vars,
+                         bosh_dump_process_command,
+                         _("Write a whole local process to a sparse image: "
+                           "dump process FILE.\n"
+                           "Every readable mapping is saved along with a "
+                           "map of the pages that were\n"
+                           "resident, so untouched pages take no space.  "
+                           "The image can be written\n"
+                           "back with \"restore FILE\"."));
+
+  bosh_command_list_add (&appendlist, "memory", class_vars,
+                         bosh_append_memory_command,
+                         _("Append the contents of memory to a raw binary "
+                           "file: append memory FILE LO HI.\n"
+                           "The memory in the range [LO .. HI) is added to "
+                           "the end of FILE."));
+
+  bosh_add_command ("restore", class_vars, bosh_restore_command,
+                    _("Restore the contents of FILE to target memory.\n"
+                      "Usage: restore FILE [binary|compressed] "
+                      "[OFFSET [START [END]]]\n"
+                      "FILE is a process image written by \"dump "
+                      "process\".  With \"binary\" it is a\n"
+                      "raw file such as one written by \"dump memory\", "
+                      "and with \"compressed\"\n"
+                      "one written by \"dump compressed memory\" or "
+                      "\"dump compressed blocks memory\".\n"
+                      "OFFSET is added to every address in the file, "
+                      "and if START and END\n"
+                      "are given only the part of the file in "
+                      "[START .. END) is restored.\n"
+                      "For a process image START and END are addresses "
+                      "in the image, before\n"
+                      "OFFSET is added.  Binary and compressed files "
+                      "hold no addresses, so\n"
+                      "there they are offsets into the file, and the "
+                      "byte at offset N is\n"
+                      "written to OFFSET + N.\n"
+                      "Files are read and written a block at a time."));
+}
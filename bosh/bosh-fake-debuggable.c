@@ -0,0 +1,930 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* A stand-in for a real gdb backed debuggable, so bosh can be run end
+ * to end without a debugger, e.g. for regression tests and latency
+ * benchmarks on machines with no gdb.
+ *
+ * "bosh --fake-target SCENARIO" reads a scenario file that describes
+ * what the target does.  Blank lines and lines starting with '#' are
+ * ignored, and the rest are one of:
+ *
+ *   target NAME              a name for the target
+ *   start FILE:LINE          where the target is once connected
+ *   frame FUNCTION [FILE:LINE] [NAME=VALUE...]
+ *                            the stack, innermost frame first; the
+ *                            innermost frame is at the stop location
+ *   depth N                  pad the stack out to N frames
+ *   threads N                stops rotate through N threads, shown as
+ *                            a "start_thread (thread=K)" outermost frame
+ *   latency MS               how long each run command takes to stop
+ *   stop FILE:LINE [FUNCTION]
+ *                            where the next run command stops
+ *   storm N FILE:LINE [FUNCTION]
+ *                            the next run command stops N times at
+ *                            FILE:LINE, resuming by itself after each
+ *                            stop but the last
+ *   exit                     the program exits
+ *
+ * Every run command (continue, next, step, finish) moves on to the next
+ * stop in the scenario, and once they're used up the program exits.
+ * FILE names are relative to the scenario file. */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib-object.h>
+#include <glib/gi18n.h>
+
+#include <gswat/gswat.h>
+
+#include "bosh-fake-debuggable.h"
+
+typedef enum {
+  FAKE_EVENT_STOP,
+  FAKE_EVENT_STORM,
+  FAKE_EVENT_EXIT
+} FakeEventType;
+
+typedef struct _FakeEvent
+{
+  FakeEventType type;
+  char *uri;
+  int line;
+  char *function;
+  guint count;
+} FakeEvent;
+
+struct _BoshFakeDebuggablePrivate
+{
+  char *target;
+  char *dir;
+
+  char *start_uri;
+  int start_line;
+  /* GSwatDebuggableFrames, innermost first */
+  GQueue frames;
+  guint depth;
+  guint threads;
+  guint latency;
+
+  GQueue events;
+  GList *next_event;
+
+  GSwatDebuggableState state;
+  guint state_stamp;
+  guint stack_stamp;
+  char *uri;
+  int line;
+  char *function;
+  gulong frame;
+  guint n_stops;
+  /* Stops left in the current storm */
+  guint storm_left;
+  guint stop_id;
+  guint resume_id;
+};
+
+enum {
+  PROP_0,
+  PROP_TARGET,
+  PROP_STATE,
+  PROP_STACK,
+  PROP_BREAKPOINTS,
+  PROP_SOURCE_URI,
+  PROP_SOURCE_LINE,
+  PROP_FRAME,
+  PROP_LOCALS
+};
+
+static void bosh_fake_debuggable_interface_init (GSwatDebuggableIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (BoshFakeDebuggable,
+                         bosh_fake_debuggable,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GSWAT_TYPE_DEBUGGABLE,
+                                                bosh_fake_debuggable_interface_init));
+
+#define BOSH_FAKE_DEBUGGABLE_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), BOSH_TYPE_FAKE_DEBUGGABLE, \
+                                BoshFakeDebuggablePrivate))
+
+GQuark
+bosh_fake_debuggable_error_quark (void)
+{
+  return g_quark_from_static_string ("bosh-fake-debuggable-error-quark");
+}
+
+static void
+fake_event_free (FakeEvent *event)
+{
+  g_free (event->uri);
+  g_free (event->function);
+  g_free (event);
+}
+
+static GSwatDebuggableFrame *
+frame_copy (const GSwatDebuggableFrame *frame)
+{
+  GSwatDebuggableFrame *copy = g_new0 (GSwatDebuggableFrame, 1);
+  GList *l;
+
+  copy->level = frame->level;
+  copy->address = frame->address;
+  copy->function = g_strdup (frame->function);
+  copy->source_uri = g_strdup (frame->source_uri);
+  copy->line = frame->line;
+
+  for (l = frame->arguments; l; l = l->next)
+    {
+      GSwatDebuggableFrameArgument *arg = l->data;
+      GSwatDebuggableFrameArgument *arg_copy =
+        g_new0 (GSwatDebuggableFrameArgument, 1);
+
+      arg_copy->name = g_strdup (arg->name);
+      arg_copy->value = g_strdup (arg->value);
+      copy->arguments = g_list_prepend (copy->arguments, arg_copy);
+    }
+  copy->arguments = g_list_reverse (copy->arguments);
+
+  return copy;
+}
+
+static void
+frame_free (GSwatDebuggableFrame *frame)
+{
+  GList *l;
+
+  for (l = frame->arguments; l; l = l->next)
+    {
+      GSwatDebuggableFrameArgument *arg = l->data;
+      g_free (arg->name);
+      g_free (arg->value);
+      g_free (arg);
+    }
+  g_list_free (frame->arguments);
+  g_free (frame->function);
+  g_free (frame->source_uri);
+  g_free (frame);
+}
+
+static char *
+fake_uri_for_file (BoshFakeDebuggable *self, const char *file)
+{
+  BoshFakeDebuggablePrivate *priv = self->priv;
+  char *path;
+  char *uri;
+
+  if (g_path_is_absolute (file))
+    path = g_strdup (file);
+  else
+    path = g_build_filename (priv->dir, file, NULL);
+
+  uri = g_filename_to_uri (path, NULL, NULL);
+  g_free (path);
+  return uri;
+}
+
+/* Parses FILE:LINE */
+static gboolean
+parse_location (BoshFakeDebuggable *self, const char *location,
+                char **uri, int *line)
+{
+  const char *colon = strrchr (location, ':');
+  char *file;
+  char *end;
+
+  if (!colon || colon == location)
+    return FALSE;
+
+  *line = strtol (colon + 1, &end, 10);
+  if (end == colon + 1 || *end != '\0' || *line <= 0)
+    return FALSE;
+
+  file = g_strndup (location, colon - location);
+  *uri = fake_uri_for_file (self, file);
+  g_free (file);
+
+  return *uri != NULL;
+}
+
+static gboolean
+parse_count (const char *text, guint *count)
+{
+  char *end;
+  long value = strtol (text, &end, 10);
+
+  if (end == text || *end != '\0' || value < 0)
+    return FALSE;
+  *count = value;
+  return TRUE;
+}
+
+static gboolean
+parse_scenario_line (BoshFakeDebuggable *self, char **argv, int argc)
+{
+  BoshFakeDebuggablePrivate *priv = self->priv;
+  const char *directive = argv[0];
+
+  if (strcmp (directive, "target") == 0 && argc == 2)
+    {
+      g_free (priv->target);
+      priv->target = g_strdup (argv[1]);
+    }
+  else if (strcmp (directive, "start") == 0 && argc == 2)
+    {
+      g_free (priv->start_uri);
+      priv->start_uri = NULL;
+      return parse_location (self, argv[1], &priv->start_uri,
+                             &priv->start_line);
+    }
+  else if (strcmp (directive, "frame") == 0 && argc >= 2)
+    {
+      GSwatDebuggableFrame *frame = g_new0 (GSwatDebuggableFrame, 1);
+      int i;
+
+      frame->function = g_strdup (argv[1]);
+      for (i = 2; i < argc; i++)
+        {
+          char *equals = strchr (argv[i], '=');
+
+          if (equals)
+            {
+              GSwatDebuggableFrameArgument *arg =
+                g_new0 (GSwatDebuggableFrameArgument, 1);
+
+              arg->name = g_strndup (argv[i], equals - argv[i]);
+              arg->value = g_strdup (equals + 1);
+              frame->arguments = g_list_append (frame->arguments, arg);
+            }
+          else if (!frame->source_uri)
+            {
+              if (!parse_location (self, argv[i], &frame->source_uri,
+                                   &frame->line))
+                {
+                  frame_free (frame);
+                  return FALSE;
+                }
+            }
+          else
+            {
+              frame_free (frame);
+              return FALSE;
+            }
+        }
+      g_queue_push_tail (&priv->frames, frame);
+    }
+  else if (strcmp (directive, "depth") == 0 && argc == 2)
+    return parse_count (argv[1], &priv->depth);
+  else if (strcmp (directive, "threads") == 0 && argc == 2)
+    return parse_count (argv[1], &priv->threads);
+  else if (strcmp (directive, "latency") == 0 && argc == 2)
+    return parse_count (argv[1], &priv->latency);
+  else if ((strcmp (directive, "stop") == 0 && (argc == 2 || argc == 3))
+           || (strcmp (directive, "storm") == 0
+               && (argc == 3 || argc == 4)))
+    {
+      FakeEvent *event = g_new0 (FakeEvent, 1);
+      int first = 1;
+
+      event->type = FAKE_EVENT_STOP;
+      event->count = 1;
+      if (strcmp (directive, "storm") == 0)
+        {
+          event->type = FAKE_EVENT_STORM;
+          if (!parse_count (argv[1], &event->count) || event->count == 0)
+            {
+              fake_event_free (event);
+              return FALSE;
+            }
+          first = 2;
+        }
+
+      if (!parse_location (self, argv[first], &event->uri, &event->line))
+        {
+          fake_event_free (event);
+          return FALSE;
+        }
+      if (first + 1 < argc)
+        event->function = g_strdup (argv[first + 1]);
+      g_queue_push_tail (&priv->events, event);
+    }
+  else if (strcmp (directive, "exit") == 0 && argc == 1)
+    {
+      FakeEvent *event = g_new0 (FakeEvent, 1);
+      event->type = FAKE_EVENT_EXIT;
+      g_queue_push_tail (&priv->events, event);
+    }
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+load_scenario (BoshFakeDebuggable *self, const char *filename,
+               GError **error)
+{
+  BoshFakeDebuggablePrivate *priv = self->priv;
+  char *contents;
+  char **lines;
+  int i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, error))
+    return FALSE;
+
+  priv->dir = g_path_get_dirname (filename);
+  priv->target = g_path_get_basename (filename);
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  for (i = 0; lines[i]; i++)
+    {
+      char *line = g_strstrip (lines[i]);
+      char **argv;
+      int argc;
+      gboolean ok;
+
+      if (*line == '\0' || *line == '#')
+        continue;
+
+      if (!g_shell_parse_argv (line, &argc, &argv, NULL))
+        ok = FALSE;
+      else
+        {
+          ok = parse_scenario_line (self, argv, argc);
+          g_strfreev (argv);
+        }
+
+      if (!ok)
+        {
+          g_set_error (error, BOSH_FAKE_DEBUGGABLE_ERROR,
+                       BOSH_FAKE_DEBUGGABLE_ERROR_SCENARIO,
+                       _("%s:%d: Can't understand \"%s\""),
+                       filename, i + 1, line);
+          g_strfreev (lines);
+          return FALSE;
+        }
+    }
+  g_strfreev (lines);
+
+  if (!priv->start_uri)
+    {
+      FakeEvent *first = g_queue_peek_head (&priv->events);
+
+      if (!first || first->type == FAKE_EVENT_EXIT)
+        {
+          g_set_error (error, BOSH_FAKE_DEBUGGABLE_ERROR,
+                       BOSH_FAKE_DEBUGGABLE_ERROR_SCENARIO,
+                       _("%s: No start location"), filename);
+          return FALSE;
+        }
+      priv->start_uri = g_strdup (first->uri);
+      priv->start_line = first->line;
+    }
+
+  return TRUE;
+}
+
+/* Reads the scenario file SCENARIO.  The debuggable starts out
+ * disconnected, just like a real one. */
+BoshFakeDebuggable *
+bosh_fake_debuggable_new (const char *scenario, GError **error)
+{
+  BoshFakeDebuggable *self = g_object_new (BOSH_TYPE_FAKE_DEBUGGABLE, NULL);
+
+  if (!load_scenario (self, scenario, error))
+    {
+      g_object_unref (self);
+      return NULL;
+    }
+  return self;
+}
+
+static void
+set_state (BoshFakeDebuggable *self, GSwatDebuggableState state)
+{
+  self->priv->state = state;
+  self->priv->state_stamp++;
+  g_object_notify (G_OBJECT (self), "state");
+}
+
+static void
+set_location (BoshFakeDebuggable *self, const char *uri, int line,
+              const char *function)
+{
+  BoshFakeDebuggablePrivate *priv = self->priv;
+
+  g_free (priv->uri);
+  priv->uri = g_strdup (uri);
+  priv->line = line;
+  g_free (priv->function);
+  priv->function = g_strdup (function);
+  priv->frame = 0;
+  priv->stack_stamp++;
+}
+
+static void
+fake_run (BoshFakeDebuggable *self);
+
+static gboolean
+fake_resume_cb (gpointer data)
+{
+  BoshFakeDebuggable *self = data;
+
+  self->priv->resume_id = 0;
+  fake_run (self);
+  return FALSE;
+}
+
+static gboolean
+fake_stop_cb (gpointer data)
+{
+  BoshFakeDebuggable *self = data;
+  BoshFakeDebuggablePrivate *priv = self->priv;
+
+  priv->stop_id = 0;
+
+  if (priv->storm_left == 0)
+    {
+      FakeEvent *event = priv->next_event ? priv->next_event->data : NULL;
+
+      if (priv->next_event)
+        priv->next_event = priv->next_event->next;
+
+      if (!event || event->type == FAKE_EVENT_EXIT)
+        {
+          set_location (self, NULL, 0, NULL);
+          set_state (self, GSWAT_DEBUGGABLE_DISCONNECTED);
+          return FALSE;
+        }
+
+      priv->storm_left = event->count;
+      set_location (self, event->uri, event->line, event->function);
+    }
+
+  priv->storm_left--;
+  priv->n_stops++;
+  priv->frame = 0;
+  priv->stack_stamp++;
+
+  g_object_notify (G_OBJECT (self), "stack");
+  g_object_notify (G_OBJECT (self), "source-uri");
+  g_object_notify (G_OBJECT (self), "source-line");
+  set_state (self, GSWAT_DEBUGGABLE_INTERRUPTED);
+
+  /* A storm carries on by itself, unless something else has already
+   * set us running again */
+  if (priv->storm_left && priv->state == GSWAT_DEBUGGABLE_INTERRUPTED
+      && !priv->resume_id)
+    priv->resume_id = g_idle_add (fake_resume_cb, self);
+
+  return FALSE;
+}
+
+static void
+fake_run (BoshFakeDebuggable *self)
+{
+  BoshFakeDebuggablePrivate *priv = self->priv;
+
+  if (priv->state != GSWAT_DEBUGGABLE_INTERRUPTED)
+    return;
+
+  if (priv->resume_id)
+    {
+      g_source_remove (priv->resume_id);
+      priv->resume_id = 0;
+    }
+
+  set_state (self, GSWAT_DEBUGGABLE_RUNNING);
+
+  if (priv->latency)
+    priv->stop_id = g_timeout_add (priv->latency, fake_stop_cb, self);
+  else
+    priv->stop_id = g_idle_add (fake_stop_cb, self);
+}
+
+static void
+fake_cancel_pending (BoshFakeDebuggablePrivate *priv)
+{
+  if (priv->stop_id)
+    {
+      g_source_remove (priv->stop_id);
+      priv->stop_id = 0;
+    }
+  if (priv->resume_id)
+    {
+      g_source_remove (priv->resume_id);
+      priv->resume_id = 0;
+    }
+}
+
+static gchar *
+bosh_fake_debuggable_get_target (GSwatDebuggable *object)
+{
+  return g_strdup (BOSH_FAKE_DEBUGGABLE (object)->priv->target);
+}
+
+static gboolean
+bosh_fake_debuggable_connect (GSwatDebuggable *object, GError **error)
+{
+  BoshFakeDebuggable *self = BOSH_FAKE_DEBUGGABLE (object);
+  BoshFakeDebuggablePrivate *priv = self->priv;
+
+  if (priv->state != GSWAT_DEBUGGABLE_DISCONNECTED)
+    return TRUE;
+
+  priv->next_event = priv->events.head;
+  priv->storm_left = 0;
+  priv->n_stops = 0;
+  set_location (self, priv->start_uri, priv->start_line, NULL);
+
+  g_object_notify (G_OBJECT (self), "stack");
+  g_object_notify (G_OBJECT (self), "source-uri");
+  g_object_notify (G_OBJECT (self), "source-line");
+  set_state (self, GSWAT_DEBUGGABLE_INTERRUPTED);
+
+  return TRUE;
+}
+
+static void
+bosh_fake_debuggable_disconnect (GSwatDebuggable *object)
+{
+  BoshFakeDebuggable *self = BOSH_FAKE_DEBUGGABLE (object);
+
+  fake_cancel_pending (self->priv);
+  if (self->priv->state != GSWAT_DEBUGGABLE_DISCONNECTED)
+    set_state (self, GSWAT_DEBUGGABLE_DISCONNECTED);
+}
+
+static void
+bosh_fake_debuggable_request_line_breakpoint (GSwatDebuggable *object,
+                                              const gchar *uri,
+                                              guint line)
+{
+  /* The scenario decides where we stop */
+}
+
+static void
+bosh_fake_debuggable_request_function_breakpoint (GSwatDebuggable *object,
+                                                  const gchar *symbol)
+{
+}
+
+static void
+bosh_fake_debuggable_run (GSwatDebuggable *object)
+{
+  fake_run (BOSH_FAKE_DEBUGGABLE (object));
+}
+
+static void
+bosh_fake_debuggable_interrupt (GSwatDebuggable *object)
+{
+  BoshFakeDebuggable *self = BOSH_FAKE_DEBUGGABLE (object);
+  BoshFakeDebuggablePrivate *priv = self->priv;
+
+  if (priv->state != GSWAT_DEBUGGABLE_RUNNING || !priv->stop_id)
+    return;
+
+  /* Stop where we were going to stop anyway, just sooner */
+  g_source_remove (priv->stop_id);
+  fake_stop_cb (self);
+}
+
+static void
+bosh_fake_debuggable_restart (GSwatDebuggable *object)
+{
+  bosh_fake_debuggable_disconnect (object);
+  bosh_fake_debuggable_connect (object, NULL);
+}
+
+static GSwatDebuggableState
+bosh_fake_debuggable_get_state (GSwatDebuggable *object)
+{
+  return BOSH_FAKE_DEBUGGABLE (object)->priv->state;
+}
+
+static guint
+bosh_fake_debuggable_get_state_stamp (GSwatDebuggable *object)
+{
+  return BOSH_FAKE_DEBUGGABLE (object)->priv->state_stamp;
+}
+
+static GQueue *
+bosh_fake_debuggable_get_stack (GSwatDebuggable *object)
+{
+  BoshFakeDebuggable *self = BOSH_FAKE_DEBUGGABLE (object);
+  BoshFakeDebuggablePrivate *priv = self->priv;
+  GQueue *stack = g_queue_new ();
+  GSwatDebuggableFrame *frame;
+  GList *l;
+  guint depth;
+  int level = 0;
+
+  if (priv->state != GSWAT_DEBUGGABLE_INTERRUPTED)
+    return stack;
+
+  /* The innermost frame is wherever we stopped */
+  l = priv->frames.head;
+  if (l)
+    {
+      frame = frame_copy (l->data);
+      l = l->next;
+    }
+  else
+    {
+      frame = g_new0 (GSwatDebuggableFrame, 1);
+      frame->function = g_strdup ("main");
+    }
+  if (priv->function)
+    {
+      g_free (frame->function);
+      frame->function = g_strdup (priv->function);
+    }
+  g_free (frame->source_uri);
+  frame->source_uri = g_strdup (priv->uri);
+  frame->line = priv->line;
+  frame->level = level++;
+  g_queue_push_tail (stack, frame);
+
+  for (; l; l = l->next)
+    {
+      frame = frame_copy (l->data);
+      if (!frame->source_uri)
+        {
+          frame->source_uri = g_strdup (priv->start_uri);
+          frame->line = priv->start_line;
+        }
+      frame->level = level++;
+      g_queue_push_tail (stack, frame);
+    }
+
+  depth = priv->depth;
+  if (priv->threads > 1 && depth > 0)
+    depth--;
+  while (level < depth)
+    {
+      frame = g_new0 (GSwatDebuggableFrame, 1);
+      frame->function = g_strdup ("recurse");
+      frame->source_uri = g_strdup (priv->start_uri);
+      frame->line = priv->start_line;
+      frame->level = level++;
+      g_queue_push_tail (stack, frame);
+    }
+
+  if (priv->threads > 1)
+    {
+      GSwatDebuggableFrameArgument *arg =
+        g_new0 (GSwatDebuggableFrameArgument, 1);
+
+      arg->name = g_strdup ("thread");
+      arg->value = g_strdup_printf ("%u", priv->n_stops % priv->threads + 1);
+
+      frame = g_new0 (GSwatDebuggableFrame, 1);
+      frame->function = g_strdup ("start_thread");
+      frame->source_uri = g_strdup (priv->start_uri);
+      frame->line = priv->start_line;
+      frame->level = level++;
+      frame->arguments = g_list_append (NULL, arg);
+      g_queue_push_tail (stack, frame);
+    }
+
+  return stack;
+}
+
+static guint
+bosh_fake_debuggable_get_stack_stamp (GSwatDebuggable *object)
+{
+  return BOSH_FAKE_DEBUGGABLE (object)->priv->stack_stamp;
+}
+
+static GList *
+bosh_fake_debuggable_get_breakpoints (GSwatDebuggable *object)
+{
+  return NULL;
+}
+
+static GSwatDebuggableFrame *
+get_selected_frame (BoshFakeDebuggable *self, GQueue **stack)
+{
+  *stack = bosh_fake_debuggable_get_stack (GSWAT_DEBUGGABLE (self));
+  return g_queue_peek_nth (*stack, self->priv->frame);
+}
+
+static gchar *
+bosh_fake_debuggable_get_source_uri (GSwatDebuggable *object)
+{
+  BoshFakeDebuggable *self = BOSH_FAKE_DEBUGGABLE (object);
+  GSwatDebuggableFrame *frame;
+  GQueue *stack;
+  char *uri;
+
+  if (self->priv->frame == 0)
+    return g_strdup (self->priv->uri);
+
+  frame = get_selected_frame (self, &stack);
+  uri = frame ? g_strdup (frame->source_uri) : NULL;
+  g_queue_foreach (stack, (GFunc)frame_free, NULL);
+  g_queue_free (stack);
+  return uri;
+}
+
+static gint
+bosh_fake_debuggable_get_source_line (GSwatDebuggable *object)
+{
+  BoshFakeDebuggable *self = BOSH_FAKE_DEBUGGABLE (object);
+  GSwatDebuggableFrame *frame;
+  GQueue *stack;
+  int line;
+
+  if (self->priv->frame == 0)
+    return self->priv->line;
+
+  frame = get_selected_frame (self, &stack);
+  line = frame ? frame->line : 0;
+  g_queue_foreach (stack, (GFunc)frame_free, NULL);
+  g_queue_free (stack);
+  return line;
+}
+
+static gulong
+bosh_fake_debuggable_get_frame (GSwatDebuggable *object)
+{
+  return BOSH_FAKE_DEBUGGABLE (object)->priv->frame;
+}
+
+static void
+bosh_fake_debuggable_set_frame (GSwatDebuggable *object, gulong frame)
+{
+  BoshFakeDebuggable *self = BOSH_FAKE_DEBUGGABLE (object);
+
+  self->priv->frame = frame;
+  g_object_notify (G_OBJECT (self), "frame");
+  g_object_notify (G_OBJECT (self), "source-uri");
+  g_object_notify (G_OBJECT (self), "source-line");
+}
+
+static GList *
+bosh_fake_debuggable_get_locals_list (GSwatDebuggable *object)
+{
+  return NULL;
+}
+
+static guint
+bosh_fake_debuggable_get_locals_stamp (GSwatDebuggable *object)
+{
+  return 0;
+}
+
+static gchar *
+bosh_fake_debuggable_get_uri_for_file (GSwatDebuggable *object,
+                                       const gchar *file)
+{
+  return fake_uri_for_file (BOSH_FAKE_DEBUGGABLE (object), file);
+}
+
+static void
+bosh_fake_debuggable_get_property (GObject *object,
+                                   guint id,
+                                   GValue *value,
+                                   GParamSpec *pspec)
+{
+  GSwatDebuggable *debuggable = GSWAT_DEBUGGABLE (object);
+
+  switch (id)
+    {
+    case PROP_TARGET:
+      g_value_take_string (value,
+                           bosh_fake_debuggable_get_target (debuggable));
+      break;
+    case PROP_STATE:
+      g_value_set_ulong (value,
+                         bosh_fake_debuggable_get_state_stamp (debuggable));
+      break;
+    case PROP_STACK:
+      g_value_set_uint (value,
+                        bosh_fake_debuggable_get_stack_stamp (debuggable));
+      break;
+    case PROP_BREAKPOINTS:
+    case PROP_LOCALS:
+      g_value_set_uint (value, 0);
+      break;
+    case PROP_SOURCE_URI:
+      g_value_take_string (value,
+                           bosh_fake_debuggable_get_source_uri (debuggable));
+      break;
+    case PROP_SOURCE_LINE:
+      g_value_set_ulong (value,
+                         bosh_fake_debuggable_get_source_line (debuggable));
+      break;
+    case PROP_FRAME:
+      g_value_set_ulong (value, bosh_fake_debuggable_get_frame (debuggable));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, pspec);
+      break;
+    }
+}
+
+static void
+bosh_fake_debuggable_finalize (GObject *object)
+{
+  BoshFakeDebuggable *self = BOSH_FAKE_DEBUGGABLE (object);
+  BoshFakeDebuggablePrivate *priv = self->priv;
+
+  fake_cancel_pending (priv);
+
+  g_queue_foreach (&priv->frames, (GFunc)frame_free, NULL);
+  g_queue_clear (&priv->frames);
+  g_queue_foreach (&priv->events, (GFunc)fake_event_free, NULL);
+  g_queue_clear (&priv->events);
+
+  g_free (priv->target);
+  g_free (priv->dir);
+  g_free (priv->start_uri);
+  g_free (priv->uri);
+  g_free (priv->function);
+
+  G_OBJECT_CLASS (bosh_fake_debuggable_parent_class)->finalize (object);
+}
+
+static void
+bosh_fake_debuggable_class_init (BoshFakeDebuggableClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->get_property = bosh_fake_debuggable_get_property;
+  gobject_class->finalize = bosh_fake_debuggable_finalize;
+
+  g_object_class_override_property (gobject_class, PROP_TARGET, "target");
+  g_object_class_override_property (gobject_class, PROP_STATE, "state");
+  g_object_class_override_property (gobject_class, PROP_STACK, "stack");
+  g_object_class_override_property (gobject_class, PROP_BREAKPOINTS,
+                                    "breakpoints");
+  g_object_class_override_property (gobject_class, PROP_SOURCE_URI,
+                                    "source-uri");
+  g_object_class_override_property (gobject_class, PROP_SOURCE_LINE,
+                                    "source-line");
+  g_object_class_override_property (gobject_class, PROP_FRAME, "frame");
+  g_object_class_override_property (gobject_class, PROP_LOCALS, "locals");
+
+  g_type_class_add_private (klass, sizeof (BoshFakeDebuggablePrivate));
+}
+
+static void
+bosh_fake_debuggable_interface_init (GSwatDebuggableIface *iface)
+{
+  iface->get_target = bosh_fake_debuggable_get_target;
+  iface->connect = bosh_fake_debuggable_connect;
+  iface->disconnect = bosh_fake_debuggable_disconnect;
+  iface->request_line_breakpoint =
+    bosh_fake_debuggable_request_line_breakpoint;
+  iface->request_function_breakpoint =
+    bosh_fake_debuggable_request_function_breakpoint;
+  iface->cont = bosh_fake_debuggable_run;
+  iface->finish = bosh_fake_debuggable_run;
+  iface->next = bosh_fake_debuggable_run;
+  iface->step = bosh_fake_debuggable_run;
+  iface->interrupt = bosh_fake_debuggable_interrupt;
+  iface->restart = bosh_fake_debuggable_restart;
+  iface->get_state = bosh_fake_debuggable_get_state;
+  iface->get_state_stamp = bosh_fake_debuggable_get_state_stamp;
+  iface->get_stack = bosh_fake_debuggable_get_stack;
+  iface->get_stack_stamp = bosh_fake_debuggable_get_stack_stamp;
+  iface->get_breakpoints = bosh_fake_debuggable_get_breakpoints;
+  iface->get_source_uri = bosh_fake_debuggable_get_source_uri;
+  iface->get_source_line = bosh_fake_debuggable_get_source_line;
+  iface->get_frame = bosh_fake_debuggable_get_frame;
+  iface->set_frame = bosh_fake_debuggable_set_frame;
+  iface->get_locals_list = bosh_fake_debuggable_get_locals_list;
+  iface->get_locals_stamp = bosh_fake_debuggable_get_locals_stamp;
+  iface->get_uri_for_file = bosh_fake_debuggable_get_uri_for_file;
+}
+
+static void
+bosh_fake_debuggable_init (BoshFakeDebuggable *self)
+{
+  self->priv = BOSH_FAKE_DEBUGGABLE_GET_PRIVATE (self);
+  g_queue_init (&self->priv->frames);
+  g_queue_init (&self->priv->events);
+  self->priv->state = GSWAT_DEBUGGABLE_DISCONNECTED;
+}
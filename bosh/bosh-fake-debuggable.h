@@ -0,0 +1,64 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_FAKE_DEBUGGABLE_H
+#define BOSH_FAKE_DEBUGGABLE_H
+
+#include <glib-object.h>
+#include <gswat/gswat.h>
+
+G_BEGIN_DECLS
+
+#define BOSH_TYPE_FAKE_DEBUGGABLE (bosh_fake_debuggable_get_type ())
+#define BOSH_FAKE_DEBUGGABLE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), BOSH_TYPE_FAKE_DEBUGGABLE, \
+                               BoshFakeDebuggable))
+#define BOSH_IS_FAKE_DEBUGGABLE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), BOSH_TYPE_FAKE_DEBUGGABLE))
+
+#define BOSH_FAKE_DEBUGGABLE_ERROR (bosh_fake_debuggable_error_quark ())
+
+typedef enum {
+  BOSH_FAKE_DEBUGGABLE_ERROR_SCENARIO,
+} BoshFakeDebuggableError;
+
+typedef struct _BoshFakeDebuggable BoshFakeDebuggable;
+typedef struct _BoshFakeDebuggableClass BoshFakeDebuggableClass;
+typedef struct _BoshFakeDebuggablePrivate BoshFakeDebuggablePrivate;
+
+struct _BoshFakeDebuggable
+{
+  GObject parent;
+
+  BoshFakeDebuggablePrivate *priv;
+};
+
+struct _BoshFakeDebuggableClass
+{
+  GObjectClass parent_class;
+};
+
+GType bosh_fake_debuggable_get_type (void);
+GQuark bosh_fake_debuggable_error_quark (void);
+
+BoshFakeDebuggable *bosh_fake_debuggable_new (const char *scenario,
+                                              GError **error);
+
+G_END_DECLS
+
+#endif /* BOSH_FAKE_DEBUGGABLE_H */
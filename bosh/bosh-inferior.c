@@ -0,0 +1,446 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Inferiors let one bosh debug several programs at once, e.g. a load
+ * balancer and its backends.
+ *
+ * Each inferior has its own GSwatDebuggable, and so its own gdb, stack
+ * and source position, all driven from the one main loop.  Commands
+ * act on the current inferior (_bosh_current_debuggable); the others
+ * keep running and just report when they stop. */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib-object.h>
+#include <glib/gi18n.h>
+
+#include <gswat/gswat.h>
+
+#include "cli-decode.h"
+
+#include "bosh-batch.h"
+#include "bosh-commands.h"
+#include "bosh-inferior.h"
+#include "bosh-main.h"
+#include "bosh-output.h"
+#include "bosh-step.h"
+#include "bosh-utils.h"
+
+static GList *inferiors;
+static BoshInferior *current_inferior;
+static int next_inferior_num = 1;
+
+/* Creates a debuggable for SESSION and starts watching it.  The first
+ * inferior added becomes the current one. */
+BoshInferior *
+bosh_inferior_add (GSwatSession *session, const char *target, int pid)
+{
+  return bosh_inferior_add_debuggable
+    (GSWAT_DEBUGGABLE (gswat_gdb_debugger_new (session)), target, pid);
+}
+
+/* Takes ownership of DEBUGGABLE */
+BoshInferior *
+bosh_inferior_add_debuggable (GSwatDebuggable *debuggable,
+                              const char *target,
+                              int pid)
+{
+  BoshInferior *inferior = g_new0 (BoshInferior, 1);
+
+  inferior->num = next_inferior_num++;
+  inferior->debuggable = debuggable;
+  inferior->target = g_strdup (target);
+  inferior->pid = pid;
+  inferior->list_position = -1;
+
+  inferiors = g_list_append (inferiors, inferior);
+  bosh_main_watch_debuggable (inferior->debuggable);
+
+  if (!current_inferior)
+    bosh_inferior_set_current (inferior);
+
+  return inferior;
+}
+
+BoshInferior *
+bosh_inferior_get_current (void)
+{
+  return current_inferior;
+}
+
+BoshInferior *
+bosh_inferior_lookup (GSwatDebuggable *debuggable)
+{
+  GList *l;
+
+  for (l = inferiors; l; l = l->next)
+    {
+      BoshInferior *inferior = l->data;
+      if (inferior->debuggable == debuggable)
+        return inferior;
+    }
+  return NULL;
+}
+
+static BoshInferior *
+lookup_inferior_num (int num)
+{
+  GList *l;
+
+  for (l = inferiors; l; l = l->next)
+    {
+      BoshInferior *inferior = l->data;
+      if (inferior->num == num)
+        return inferior;
+    }
+  return NULL;
+}
+
+void
+bosh_inferior_set_current (BoshInferior *inferior)
+{
+  current_inferior = inferior;
+  _bosh_current_debuggable = inferior ? inferior->debuggable : NULL;
+}
+
+static const char *
+state_name (GSwatDebuggableState state)
+{
+  switch (state)
+    {
+    case GSWAT_DEBUGGABLE_DISCONNECTED:
+      return _("disconnected");
+    case GSWAT_DEBUGGABLE_RUNNING:
+      return _("running");
+    case GSWAT_DEBUGGABLE_INTERRUPTED:
+      return _("interrupted");
+    }
+  return _("unknown");
+}
+
+/* Called from the notify::state handler of every inferior.  The current
+ * inferior gets the usual prompt handling so we return FALSE for it;
+ * for the others we just say when they stop and return TRUE. */
+gboolean
+bosh_inferior_state_changed (GSwatDebuggable *debuggable)
+{
+  BoshInferior *inferior = bosh_inferior_lookup (debuggable);
+  GSwatDebuggableState state;
+  char *uri;
+
+  if (!inferior || inferior == current_inferior)
+    return FALSE;
+
+  state = gswat_debuggable_get_state (debuggable);
+  if (state == GSWAT_DEBUGGABLE_RUNNING)
+    return TRUE;
+
+  if (state == GSWAT_DEBUGGABLE_DISCONNECTED)
+    {
+      g_print (_("[Inferior %d (%s) exited]\n"), inferior->num,
+               inferior->target);
+      return TRUE;
+    }
+
+  uri = gswat_debuggable_get_source_uri (debuggable);
+  if (uri)
+    {
+      char *file = g_path_get_basename (uri);
+      g_print (_("[Inferior %d (%s) stopped at %s:%d]\n"), inferior->num,
+               inferior->target, file,
+               gswat_debuggable_get_source_line (debuggable));
+      g_free (file);
+      g_free (uri);
+    }
+  else
+    g_print (_("[Inferior %d (%s) stopped]\n"), inferior->num,
+             inferior->target);
+
+  return TRUE;
+}
+
+/* add-inferior [-pid PID] EXECUTABLE [ARGS...] */
+static void
+bosh_add_inferior_command (char *args, int from_tty)
+{
+  GSwatSession *session;
+  BoshInferior *inferior;
+  char **argv;
+  int argc;
+  int pid = -1;
+  int first = 0;
+  GError *error = NULL;
+
+  if (!args || !*args)
+    {
+      bosh_command_error_no_argument (_("executable to debug"));
+      return;
+    }
+
+  if (!g_shell_parse_argv (args, &argc, &argv, &error))
+    {
+      g_print (_("Can't parse \"%s\": %s\n"), args, error->message);
+      g_error_free (error);
+      return;
+    }
+
+  if (strcmp (argv[0], "-pid") == 0)
+    {
+      char *end;
+
+      if (argc != 3
+          || (pid = strtol (argv[1], &end, 10)) <= 0 || *end != '\0')
+        {
+          g_print (_("Usage: add-inferior -pid PID EXECUTABLE\n"));
+          g_strfreev (argv);
+          return;
+        }
+      first = 2;
+    }
+
+  session = gswat_session_new ();
+  if (pid != -1)
+    {
+      char *target = g_strdup_printf ("pid=%d file=%s", pid, argv[first]);
+      gswat_session_set_target_type (session, "PID Local");
+      gswat_session_set_target (session, target);
+      g_free (target);
+    }
+  else
+    {
+      GString *target = g_string_new (argv[0]);
+      int i;
+
+      for (i = 1; i < argc; i++)
+        {
+          char *quoted = g_shell_quote (argv[i]);
+          g_string_append_printf (target, " %s", quoted);
+          g_free (quoted);
+        }
+      gswat_session_set_target_type (session, "Run Local");
+      gswat_session_set_target (session, target->str);
+      g_string_free (target, TRUE);
+    }
+
+  inferior = bosh_inferior_add (session, argv[first], pid);
+  g_print (_("Added inferior %d (%s)\n"), inferior->num, inferior->target);
+
+  g_strfreev (argv);
+}
+
+static void
+bosh_info_inferiors_command (char *args, int from_tty)
+{
+  GList *l;
+
+  if (!inferiors)
+    {
+      g_print (_("No inferiors.\n"));
+      return;
+    }
+
+  bosh_output_text ("  %-4s %-13s %s\n", _("Num"), _("State"), _("Target"));
+  bosh_output_begin_list ("inferiors");
+  for (l = inferiors; l; l = l->next)
+    {
+      BoshInferior *inferior = l->data;
+      GSwatDebuggableState state =
+        gswat_debuggable_get_state (inferior->debuggable);
+
+      bosh_output_begin_record ("inferior");
+      bosh_output_field_string ("current",
+                                inferior == current_inferior ? "*" : " ");
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("num", "%-4d", inferior->num);
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("state", "%-13s", state_name (state));
+      bosh_output_text (" ");
+      bosh_output_field_string ("target", inferior->target);
+      if (inferior->pid != -1)
+        bosh_output_text (" (pid %d)", inferior->pid);
+      bosh_output_text ("\n");
+      bosh_output_end_record ();
+    }
+  bosh_output_end_list ();
+}
+
+/* inferior apply all|N... COMMAND
+ *
+ * Commands that set the inferiors running (continue, next...) return
+ * as soon as they're issued so the inferiors all run at once and
+ * report as they stop.  Other commands get their answer from each
+ * inferior's gdb in turn: gswat's queries block until gdb answers and
+ * gswat isn't thread safe, so they can't be made from a thread per
+ * inferior. */
+static void
+inferior_apply (char *args, int from_tty)
+{
+  BoshInferior *saved = current_inferior;
+  GList *targets = NULL;
+  GList *l;
+  char *command;
+
+  args = g_strchug (args);
+  if (strncmp (args, "all", 3) == 0
+      && (args[3] == '\0' || g_ascii_isspace (args[3])))
+    {
+      targets = g_list_copy (inferiors);
+      command = args + 3;
+    }
+  else
+    {
+      char *end;
+
+      for (;;)
+        {
+          int num = strtol (args, &end, 10);
+          BoshInferior *inferior;
+
+          if (end == args || (*end && !g_ascii_isspace (*end)))
+            break;
+          inferior = lookup_inferior_num (num);
+          if (!inferior)
+            {
+              g_print (_("No inferior number %d.\n"), num);
+              g_list_free (targets);
+              return;
+            }
+          targets = g_list_append (targets, inferior);
+          args = g_strchug (end);
+        }
+      command = args;
+    }
+
+  command = g_strstrip (command);
+  if (!targets || !*command)
+    {
+      g_print (_("Usage: inferior apply all|N... COMMAND\n"));
+      g_list_free (targets);
+      return;
+    }
+
+  for (l = targets; l; l = l->next)
+    {
+      BoshInferior *inferior = l->data;
+      char *line = g_strdup (command);
+
+      g_print (_("\nInferior %d (%s):\n"), inferior->num, inferior->target);
+      bosh_inferior_set_current (inferior);
+      bosh_execute_command (line, from_tty);
+      g_free (line);
+    }
+
+  bosh_inferior_set_current (saved);
+  g_list_free (targets);
+}
+
+static void
+bosh_inferior_command (char *args, int from_tty)
+{
+  BoshInferior *inferior;
+  char *end;
+  int num;
+
+  if (!args || !*args)
+    {
+      if (current_inferior)
+        g_print (_("[Current inferior is %d (%s)]\n"),
+                 current_inferior->num, current_inferior->target);
+      else
+        g_print (_("No inferiors.\n"));
+      return;
+    }
+
+  if (strncmp (args, "apply", 5) == 0
+      && (args[5] == '\0' || g_ascii_isspace (args[5])))
+    {
+      inferior_apply (args + 5, from_tty);
+      return;
+    }
+
+  num = strtol (args, &end, 10);
+  if (end == args || *g_strchug (end) != '\0')
+    {
+      g_print (_("Usage: inferior [N]\n"
+                 "       inferior apply all|N... COMMAND\n"));
+      return;
+    }
+
+  inferior = lookup_inferior_num (num);
+  if (!inferior)
+    {
+      g_print (_("No inferior number %d.\n"), num);
+      return;
+    }
+
+  if (bosh_step_is_active () || bosh_batch_is_active ())
+    {
+      g_print (_("Can't switch inferiors until the current commands are "
+                 "done.\n"));
+      return;
+    }
+
+  bosh_inferior_set_current (inferior);
+  g_print (_("[Switching to inferior %d (%s)]\n"), inferior->num,
+           inferior->target);
+
+  if (gswat_debuggable_get_state (inferior->debuggable)
+      == GSWAT_DEBUGGABLE_INTERRUPTED)
+    bosh_utils_print_current_frame (inferior->debuggable);
+}
+
+void
+bosh_inferior_init_commands (void)
+{
+  struct cmd_list_element *c;
+
+  c = bosh_add_command ("add-inferior", class_support,
+                        bosh_add_inferior_command,
+                        _("Add a program to debug alongside the others.\n"
+                          "Usage: add-inferior EXECUTABLE [ARGS...]\n"
+                          "       add-inferior -pid PID EXECUTABLE\n"
+                          "\n"
+                          "The new inferior doesn't become the current one; "
+                          "use \"inferior N\" to\n"
+                          "switch to it."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+
+  bosh_add_command ("inferior", class_run, bosh_inferior_command,
+                    _("Use inferior N as the current inferior.\n"
+                      "Usage: inferior [N]\n"
+                      "       inferior apply all|N... COMMAND\n"
+                      "\n"
+                      "With no argument, shows the current inferior.  "
+                      "\"inferior apply\" runs\n"
+                      "COMMAND for each of the given inferiors, or all of "
+                      "them.  Commands that\n"
+                      "set the program running are issued to every "
+                      "inferior before any of them\n"
+                      "stops, so they run side by side.  Other commands, "
+                      "such as backtrace, are\n"
+                      "run for one inferior at a time."));
+
+  c = bosh_add_info_command ("inferiors", bosh_info_inferiors_command,
+                             _("The inferiors being debugged, with the "
+                               "current one marked by \"*\"."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+}
@@ -0,0 +1,55 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_INFERIOR_H
+#define BOSH_INFERIOR_H
+
+#include <glib.h>
+#include <gswat/gswat.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BoshInferior
+{
+  int num;
+  GSwatDebuggable *debuggable;
+  char *target;
+  /* The process id of a local target, or -1 if it isn't known */
+  int pid;
+  /* Where the next "list" carries on from, or -1 to list around the
+   * current line */
+  int list_position;
+} BoshInferior;
+
+BoshInferior *bosh_inferior_add (GSwatSession *session,
+                                 const char *target,
+                                 int pid);
+BoshInferior *bosh_inferior_add_debuggable (GSwatDebuggable *debuggable,
+                                            const char *target,
+                                            int pid);
+BoshInferior *bosh_inferior_get_current (void);
+BoshInferior *bosh_inferior_lookup (GSwatDebuggable *debuggable);
+void bosh_inferior_set_current (BoshInferior *inferior);
+
+gboolean bosh_inferior_state_changed (GSwatDebuggable *debuggable);
+
+void bosh_inferior_init_commands (void);
+
+G_END_DECLS
+
+#endif /* BOSH_INFERIOR_H */
@@ -0,0 +1,497 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* A machine readable record of a session ("set journal FILE").
+ *
+ * Each command run and each state change of the debuggable is written
+ * to the journal as one line of JSON.  Commands record the line that
+ * was entered, the full name of the command it resolved to (e.g.
+ * "info inferiors" for "i inf"), when it started and finished (in
+ * microseconds on the monotonic clock), how many bytes of output it
+ * printed and, for commands that set the target running, how long we
+ * then waited for the backend to stop again.
+ *
+ * The journal is written through the same background writer as
+ * "set logging" so recording never waits on the disk. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gswat/gswat.h>
+#include <json-glib/json-glib.h>
+
+#include "cli-decode.h"
+
+#include "bosh-batch.h"
+#include "bosh-commands.h"
+#include "bosh-journal.h"
+#include "bosh-log.h"
+#include "bosh-main.h"
+#include "bosh-output.h"
+
+typedef struct _JournalCommand
+{
+  /* A command is being run */
+  gboolean active;
+  /* It set the target running and we're waiting for it to stop */
+  gboolean waiting;
+  char *input;
+  /* The full name of the command, e.g. "set journal" */
+  char *command;
+  gint64 start_us;
+  gint64 end_us;
+  guint64 output_bytes;
+} JournalCommand;
+
+static struct cmd_list_element *journallist;
+
+static BoshLogWriter *journal_writer;
+static char *journal_filename;
+static JournalCommand journal_command;
+/* Commands can run other commands; only the outermost is recorded */
+static int journal_depth;
+
+static GPrintFunc saved_print_handler;
+static gboolean print_handler_installed;
+
+static gint64
+journal_now_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static void
+journal_write (GString *line)
+{
+  g_string_append_c (line, '\n');
+  bosh_log_writer_append (journal_writer, line->str, line->len, TRUE);
+}
+
+static void
+journal_command_clear (void)
+{
+  g_free (journal_command.input);
+  g_free (journal_command.command);
+  memset (&journal_command, 0, sizeof (JournalCommand));
+}
+
+/* Writes out the current command.  NOW is when the wait for the
+ * backend ended, if there was one. */
+static void
+journal_flush_command (gint64 now)
+{
+  JournalCommand *cmd = &journal_command;
+  GString *line = g_string_new ("{\"type\":\"command\",\"input\":");
+
+  bosh_output_append_json_string (line, cmd->input);
+  g_string_append (line, ",\"command\":");
+  bosh_output_append_json_string (line, cmd->command);
+  g_string_append_printf (line,
+                          ",\"start_us\":%" G_GINT64_FORMAT
+                          ",\"end_us\":%" G_GINT64_FORMAT
+                          ",\"wait_us\":%" G_GINT64_FORMAT
+                          ",\"output_bytes\":%" G_GUINT64_FORMAT "}",
+                          cmd->start_us, cmd->end_us,
+                          cmd->waiting ? now - cmd->end_us : 0,
+                          cmd->output_bytes);
+  journal_write (line);
+  g_string_free (line, TRUE);
+
+  journal_command_clear ();
+}
+
+static void
+journal_print (const gchar *string)
+{
+  if (journal_command.active || journal_command.waiting)
+    journal_command.output_bytes += strlen (string);
+
+  if (saved_print_handler)
+    saved_print_handler (string);
+  else
+    {
+      fputs (string, stdout);
+      fflush (stdout);
+    }
+}
+
+void
+bosh_journal_command_start (const char *input)
+{
+  if (journal_depth++ > 0 || !journal_writer)
+    return;
+
+  /* The previous command didn't stop the target before this one so
+   * its wait ends here. */
+  if (journal_command.waiting)
+    journal_flush_command (journal_now_us ());
+
+  journal_command.active = TRUE;
+  journal_command.input = g_strdup (input);
+  journal_command.start_us = journal_now_us ();
+}
+
+void
+bosh_journal_command_end (struct cmd_list_element *c)
+{
+  GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
+
+  if (--journal_depth > 0 || !journal_command.active)
+    return;
+
+  journal_command.active = FALSE;
+  journal_command.command =
+    c ? bosh_command_full_name (c, journal_command.input) : NULL;
+  journal_command.end_us = journal_now_us ();
+
+  /* Run commands return as soon as the backend has been asked to do
+   * something; the time until it stops again is recorded as the
+   * wait. */
+  if (journal_writer && debuggable && c && c->class == class_run)
+    journal_command.waiting = TRUE;
+  else if (journal_writer)
+    journal_flush_command (journal_command.end_us);
+  else
+    journal_command_clear ();
+}
+
+static const char *
+journal_state_name (GSwatDebuggableState state)
+{
+  switch (state)
+    {
+    case GSWAT_DEBUGGABLE_DISCONNECTED:
+      return "disconnected";
+    case GSWAT_DEBUGGABLE_RUNNING:
+      return "running";
+    case GSWAT_DEBUGGABLE_INTERRUPTED:
+      return "interrupted";
+    default:
+      return "unknown";
+    }
+}
+
+void
+bosh_journal_state_changed (GSwatDebuggable *debuggable)
+{
+  GSwatDebuggableState state = gswat_debuggable_get_state (debuggable);
+  gint64 now;
+  GString *line;
+
+  if (!journal_writer)
+    return;
+
+  now = journal_now_us ();
+  line = g_string_new (NULL);
+  g_string_append_printf (line,
+                          "{\"type\":\"state\",\"time_us\":%" G_GINT64_FORMAT
+                          ",\"state\":\"%s\"}",
+                          now, journal_state_name (state));
+  journal_write (line);
+  g_string_free (line, TRUE);
+
+  if (journal_command.waiting && state != GSWAT_DEBUGGABLE_RUNNING)
+    journal_flush_command (now);
+}
+
+/* Finish writing the journal.  Also called at exit. */
+void
+bosh_journal_stop (void)
+{
+  int write_errno;
+
+  if (!journal_writer)
+    return;
+
+  if (journal_command.waiting)
+    journal_flush_command (journal_now_us ());
+  else if (journal_command.active)
+    {
+      /* "set journal off" itself isn't recorded */
+      journal_command_clear ();
+    }
+
+  write_errno = bosh_log_writer_free (journal_writer);
+  journal_writer = NULL;
+
+  if (write_errno)
+    g_print (_("Writing to %s failed: %s\n"), journal_filename,
+             g_strerror (write_errno));
+}
+
+static gboolean
+journal_start (const char *filename)
+{
+  static gboolean registered_atexit = FALSE;
+  GError *error = NULL;
+  GTimeVal now;
+  char *iso_time;
+  GString *line;
+
+  journal_writer = bosh_log_writer_new (filename, TRUE, &error);
+  if (!journal_writer)
+    {
+      g_print (_("set journal: %s\n"), error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  g_free (journal_filename);
+  journal_filename = g_strdup (filename);
+
+  if (!registered_atexit)
+    {
+      atexit (bosh_journal_stop);
+      registered_atexit = TRUE;
+    }
+
+  /* See bosh_set_logging_on_command */
+  if (!print_handler_installed)
+    {
+      saved_print_handler = g_set_print_handler (journal_print);
+      print_handler_installed = TRUE;
+    }
+
+  /* Record the wall clock time once so the monotonic timestamps can
+   * be related to other logs. */
+  g_get_current_time (&now);
+  iso_time = g_time_val_to_iso8601 (&now);
+  line = g_string_new (NULL);
+  g_string_append_printf (line,
+                          "{\"type\":\"start\",\"time\":\"%s\",\"time_us\":%"
+                          G_GINT64_FORMAT ",\"pid\":%d}",
+                          iso_time, journal_now_us (),
+                          bosh_get_target_pid ());
+  journal_write (line);
+  g_string_free (line, TRUE);
+  g_free (iso_time);
+
+  return TRUE;
+}
+
+static void
+bosh_set_journal_command (char *args, int from_tty)
+{
+  if (!args || !*args)
+    {
+      bosh_command_error_no_argument (_("journal file name, or \"off\""));
+      return;
+    }
+
+  if (strcmp (args, "off") == 0)
+    {
+      if (journal_writer && from_tty)
+        g_print (_("Done writing the journal to %s.\n"), journal_filename);
+      bosh_journal_stop ();
+      return;
+    }
+
+  bosh_journal_stop ();
+  if (journal_start (args) && from_tty)
+    g_print (_("Writing a journal of the session to %s.\n"), args);
+}
+
+static void
+bosh_show_journal_command (char *args, int from_tty)
+{
+  if (journal_writer)
+    g_print (_("The session journal is being written to \"%s\".\n"),
+             journal_filename);
+  else
+    g_print (_("No session journal is being written.\n"));
+}
+
+/* The string member KEY of one of our own journal records, or NULL */
+static const char *
+journal_get_string (JsonObject *object, const char *key)
+{
+  JsonNode *node;
+
+  if (!json_object_has_member (object, key))
+    return NULL;
+  node = json_object_get_member (object, key);
+  if (!JSON_NODE_HOLDS_VALUE (node)
+      || json_node_get_value_type (node) != G_TYPE_STRING)
+    return NULL;
+  return json_node_get_string (node);
+}
+
+static gint64
+journal_get_int (JsonObject *object, const char *key)
+{
+  JsonNode *node;
+
+  if (!json_object_has_member (object, key))
+    return 0;
+  node = json_object_get_member (object, key);
+  if (!JSON_NODE_HOLDS_VALUE (node)
+      || json_node_get_value_type (node) != G_TYPE_INT64)
+    return 0;
+  return json_node_get_int (node);
+}
+
+/* Whether COMMAND, a full command name from a journal, is one of the
+ * journal's own */
+static gboolean
+journal_is_journal_command (const char *command)
+{
+  return command && (strcmp (command, "set journal") == 0
+                     || strcmp (command, "journal") == 0
+                     || g_str_has_prefix (command, "journal "));
+}
+
+static void
+bosh_journal_command (char *args, int from_tty)
+{
+  g_print (_("\"journal\" must be followed by the name of a journal "
+             "command.\n"));
+  help_list (journallist, "journal ", -1, NULL);
+}
+
+static void
+bosh_journal_replay_command (char *args, int from_tty)
+{
+  GError *error = NULL;
+  JsonParser *parser;
+  GPtrArray *commands;
+  char *contents;
+  char **lines;
+  int n_commands = 0;
+  gint64 recorded_us = 0;
+  int i;
+
+  if (!args || !*args)
+    {
+      bosh_command_error_no_argument (_("journal file name"));
+      return;
+    }
+
+  if (!g_file_get_contents (args, &contents, NULL, &error))
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  parser = json_parser_new ();
+  commands = g_ptr_array_new ();
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      JsonObject *object;
+      const char *type;
+      const char *command;
+      const char *input;
+
+      if (!*lines[i]
+          || !json_parser_load_from_data (parser, lines[i], -1, NULL)
+          || !JSON_NODE_HOLDS_OBJECT (json_parser_get_root (parser)))
+        continue;
+      object = json_node_get_object (json_parser_get_root (parser));
+
+      type = journal_get_string (object, "type");
+      if (!type || strcmp (type, "command") != 0)
+        continue;
+
+      /* Skip the journal commands themselves so a replay doesn't
+       * restart the journal or replay recursively. */
+      command = journal_get_string (object, "command");
+      input = journal_get_string (object, "input");
+      if (input && *input && !journal_is_journal_command (command))
+        {
+          g_ptr_array_add (commands, g_strdup (input));
+          recorded_us += journal_get_int (object, "end_us")
+            - journal_get_int (object, "start_us")
+            + journal_get_int (object, "wait_us");
+        }
+    }
+  g_ptr_array_add (commands, NULL);
+  n_commands = commands->len - 1;
+  g_strfreev (lines);
+  g_free (contents);
+  g_object_unref (parser);
+
+  /* Run in place of the replay command, ahead of anything else still
+   * queued, so a replay in the middle of an --ex or -x script doesn't
+   * run after the rest of the script. */
+  bosh_batch_insert_commands ((char **)commands->pdata);
+  g_strfreev ((char **)g_ptr_array_free (commands, FALSE));
+
+  if (n_commands == 0)
+    {
+      g_print (_("No commands to replay in %s.\n"), args);
+      return;
+    }
+
+  g_print (_("Replaying %d commands (recorded taking %.3f seconds).\n"),
+           n_commands, recorded_us / (double)G_USEC_PER_SEC);
+  if (!journal_writer)
+    g_print (_("Use \"set journal FILE\" first to record the timings of "
+               "the replay.\n"));
+
+  /* The commands are queued, so run commands wait for the target to
+   * stop just as they did when they were recorded. */
+  if (!bosh_batch_is_active ())
+    bosh_batch_run (NULL, FALSE);
+}
+
+void
+bosh_journal_init_commands (void)
+{
+  struct cmd_list_element *c;
+
+  c = bosh_command_list_add (&setlist, "journal", class_support,
+                             bosh_set_journal_command,
+                             _("Write a journal of the session to FILE: set "
+                               "journal FILE.\n"
+                               "Every command run and every change of the "
+                               "program's state is written\n"
+                               "to FILE as a line of JSON, along with timing "
+                               "information.  \"set journal\n"
+                               "off\" stops writing the journal."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+  c = bosh_command_list_add (&showlist, "journal", class_support,
+                             bosh_show_journal_command,
+                             _("Show where the session journal is being "
+                               "written."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+
+  bosh_command_list_add_prefix (&cmdlist, "journal", class_support,
+                                bosh_journal_command,
+                                _("Work with session journals."),
+                                &journallist, "journal ", 0);
+  bosh_command_list_add (&journallist, "replay", class_support,
+                         bosh_journal_replay_command,
+                         _("Run the commands recorded in a session journal "
+                           "again: journal replay FILE.\n"
+                           "Commands are run in the order they were "
+                           "recorded, waiting for the program\n"
+                           "to stop after each one that sets it running.  "
+                           "With a journal of the\n"
+                           "replay the timings can be compared with the "
+                           "recorded ones."));
+}
@@ -0,0 +1,39 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_JOURNAL_H
+#define BOSH_JOURNAL_H
+
+#include <glib.h>
+#include <gswat/gswat.h>
+
+G_BEGIN_DECLS
+
+struct cmd_list_element;
+
+void bosh_journal_command_start (const char *input);
+void bosh_journal_command_end (struct cmd_list_element *c);
+void bosh_journal_state_changed (GSwatDebuggable *debuggable);
+
+void bosh_journal_stop (void);
+
+void bosh_journal_init_commands (void);
+
+G_END_DECLS
+
+#endif /* BOSH_JOURNAL_H */
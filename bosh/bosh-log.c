@@ -0,0 +1,1074 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Session logging ("set logging").
+ *
+ * Everything printed with g_print is copied into a ring buffer and a
+ * writer thread drains the ring into the log file, so a slow disk
+ * never holds up the prompt.  The writer sleeps between batches so
+ * that output ends up in a few large writes instead of one write per
+ * line, and optionally syncs the file every "fsync-interval" seconds.
+ *
+ * Output is only ever printed from the main thread which makes the
+ * ring single producer, single consumer: the printing side only moves
+ * head and the writer only moves tail, so neither needs a lock.  The
+ * lock and conditions below are only used to put the writer to sleep
+ * and, with "set logging overflow block", to make the printing side
+ * wait for space when the writer falls behind.
+ *
+ * The writer itself is also used for the session journal.
+ *
+ * With "set logging max-size" the writer also rotates the log: once
+ * the file would grow past the limit it is renamed to FILE.1 (older
+ * ones shifting up to FILE.N for "set logging keep N") and a new file
+ * is started.  This all happens on the writer thread so output carries
+ * on into the ring meanwhile.  With "set logging compress on" the
+ * rotated file is then gzipped by yet another thread so the writer
+ * isn't held up either. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+
+#include "cli-decode.h"
+
+#include "bosh-commands.h"
+#include "bosh-log.h"
+
+/* Must be a power of two */
+#define LOG_RING_SIZE (1 << 20)
+/* The writer is woken early once this much output is waiting */
+#define LOG_WAKE_THRESHOLD (LOG_RING_SIZE / 4)
+/* Otherwise it writes out whatever has accumulated this often */
+#define LOG_FLUSH_INTERVAL_MS 100
+
+struct _BoshLogWriter
+{
+  char *filename;
+  int fd;
+
+  guint8 *ring;
+  /* Total bytes ever appended; only moved by the printing thread */
+  volatile gint head;
+  /* Total bytes ever taken by the writer; only moved by the writer */
+  volatile gint tail;
+
+  volatile gint stop;
+  volatile gint printer_waiting;
+  /* errno of the first failed write or sync, once the writer gives up */
+  volatile gint write_errno;
+  /* Seconds between syncs, 0 to only sync when closing */
+  volatile gint fsync_interval;
+
+  GMutex *lock;
+  GCond *wake;
+  GCond *space;
+  GThread *thread;
+
+  /* Rotation settings, protected by lock */
+  guint64 max_size;
+  int keep;
+  gboolean compress;
+
+  /* Only touched by the writer thread */
+  gboolean rotatable;
+  guint64 file_size;
+  GThread *compress_thread;
+
+  /* Only touched by the printing thread */
+  guint64 logged_bytes;
+  guint64 dropped_bytes;
+  guint dropped_messages;
+  guint unreported_drops;
+};
+
+static struct cmd_list_element *set_logging_list;
+static struct cmd_list_element *show_logging_list;
+
+static char *logging_filename;
+static int logging_overwrite;
+static int logging_redirect;
+static int logging_fsync_interval;
+static char *logging_max_size_string;
+static guint64 logging_max_size;
+static int logging_keep = 5;
+static int logging_compress;
+
+static const char overflow_block[] = "block";
+static const char overflow_drop[] = "drop";
+static const char *overflow_enums[] = {
+  overflow_block,
+  overflow_drop,
+  NULL
+};
+static const char *logging_overflow = overflow_drop;
+
+static BoshLogWriter *log_writer;
+static GPrintFunc saved_print_handler;
+static gboolean print_handler_installed;
+
+static gboolean
+write_all (int fd, const guint8 *buf, gsize len)
+{
+  while (len)
+    {
+      ssize_t n = write (fd, buf, len);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return FALSE;
+        }
+      buf += n;
+      len -= n;
+    }
+  return TRUE;
+}
+
+/* Writes out the ring contents between TAIL and HEAD, in at most two
+ * pieces if the range wraps. */
+static gboolean
+log_writer_write (BoshLogWriter *writer, guint tail, guint head)
+{
+  guint start = tail & (LOG_RING_SIZE - 1);
+  guint len = head - tail;
+  guint first = MIN (len, LOG_RING_SIZE - start);
+
+  if (!write_all (writer->fd, writer->ring + start, first))
+    return FALSE;
+  return write_all (writer->fd, writer->ring, len - first);
+}
+
+static void
+log_writer_fail (BoshLogWriter *writer, int err)
+{
+  if (g_atomic_int_get (&writer->write_errno) == 0)
+    g_atomic_int_set (&writer->write_errno, err ? err : EIO);
+}
+
+static char *
+log_rotated_name (const char *filename, int n, gboolean compressed)
+{
+  return g_strdup_printf ("%s.%d%s", filename, n, compressed ? ".gz" : "");
+}
+
+static void
+log_rotated_rename (const char *filename, int from, int to,
+                    gboolean compressed)
+{
+  char *from_name = log_rotated_name (filename, from, compressed);
+  char *to_name = log_rotated_name (filename, to, compressed);
+
+  rename (from_name, to_name);
+  g_free (from_name);
+  g_free (to_name);
+}
+
+/* Gzips the rotated log FILENAME to FILENAME.gz, replacing it */
+static gpointer
+log_compress_thread (gpointer data)
+{
+  char *filename = data;
+  char *gz_name = g_strdup_printf ("%s.gz", filename);
+  char *tmp_name = g_strdup_printf ("%s.gz.tmp", filename);
+  GFile *in_file = g_file_new_for_path (filename);
+  GFile *out_file = g_file_new_for_path (tmp_name);
+  GFileInputStream *in = NULL;
+  GFileOutputStream *out = NULL;
+  GZlibCompressor *compressor;
+  GOutputStream *zout;
+  gboolean ok = FALSE;
+
+  in = g_file_read (in_file, NULL, NULL);
+  if (in)
+    out = g_file_replace (out_file, NULL, FALSE, G_FILE_CREATE_NONE,
+                          NULL, NULL);
+  if (out)
+    {
+      compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+      zout = g_converter_output_stream_new (G_OUTPUT_STREAM (out),
+                                            G_CONVERTER (compressor));
+      ok = g_output_stream_splice (zout, G_INPUT_STREAM (in),
+                                   G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE
+                                   | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                   NULL, NULL) >= 0;
+      g_object_unref (zout);
+      g_object_unref (compressor);
+    }
+
+  /* If anything went wrong the rotated file is just left uncompressed */
+  if (ok && rename (tmp_name, gz_name) == 0)
+    unlink (filename);
+  else
+    unlink (tmp_name);
+
+  if (out)
+    g_object_unref (out);
+  if (in)
+    g_object_unref (in);
+  g_object_unref (out_file);
+  g_object_unref (in_file);
+  g_free (tmp_name);
+  g_free (gz_name);
+  g_free (filename);
+  return NULL;
+}
+
+static void
+log_writer_rotate (BoshLogWriter *writer, int keep, gboolean compress)
+{
+  int fd;
+  int i;
+
+  /* Shifting the rotated files along while one of them is still being
+   * compressed would pull it out from under the compressor. */
+  if (writer->compress_thread)
+    {
+      g_thread_join (writer->compress_thread);
+      writer->compress_thread = NULL;
+    }
+
+  if (keep > 0)
+    {
+      char *name;
+
+      for (i = 0; i < 2; i++)
+        {
+          name = log_rotated_name (writer->filename, keep, i);
+          unlink (name);
+          g_free (name);
+        }
+      for (i = keep - 1; i >= 1; i--)
+        {
+          log_rotated_rename (writer->filename, i, i + 1, FALSE);
+          log_rotated_rename (writer->filename, i, i + 1, TRUE);
+        }
+
+      name = log_rotated_name (writer->filename, 1, FALSE);
+      rename (writer->filename, name);
+      g_free (name);
+    }
+
+  /* With keep 0 this just truncates the log */
+  fd = open (writer->filename, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND,
+             0666);
+  if (fd < 0)
+    {
+      log_writer_fail (writer, errno);
+      return;
+    }
+  close (writer->fd);
+  writer->fd = fd;
+  writer->file_size = 0;
+
+  if (compress && keep > 0)
+    {
+      writer->compress_thread =
+        g_thread_create (log_compress_thread,
+                         log_rotated_name (writer->filename, 1, FALSE),
+                         TRUE, NULL);
+    }
+}
+
+/* Returns how much of the LEN bytes at TAIL should go into the
+ * current file.  The current file is filled up to the last line that
+ * still fits, and only once no more whole lines fit is a new file
+ * started. */
+static guint
+log_writer_next_chunk (BoshLogWriter *writer, guint tail, guint len)
+{
+  guint64 max_size;
+  int keep;
+  gboolean compress;
+  guint room;
+  guint i;
+
+  if (!writer->rotatable)
+    return len;
+
+  g_mutex_lock (writer->lock);
+  max_size = writer->max_size;
+  keep = writer->keep;
+  compress = writer->compress;
+  g_mutex_unlock (writer->lock);
+
+  if (!max_size || writer->file_size + len <= max_size)
+    return len;
+
+  if (writer->file_size < max_size)
+    {
+      room = max_size - writer->file_size;
+      for (i = room; i > 0; i--)
+        if (writer->ring[(tail + i - 1) & (LOG_RING_SIZE - 1)] == '\n')
+          return i;
+    }
+
+  if (writer->file_size)
+    log_writer_rotate (writer, keep, compress);
+
+  room = MIN (max_size, len);
+  if (room == len)
+    return len;
+
+  /* Prefer to end the file on a line boundary */
+  for (i = room; i > 0; i--)
+    if (writer->ring[(tail + i - 1) & (LOG_RING_SIZE - 1)] == '\n')
+      return i;
+  return room;
+}
+
+static gpointer
+log_writer_thread (gpointer data)
+{
+  BoshLogWriter *writer = data;
+  GTimer *since_sync = g_timer_new ();
+  gboolean dirty = FALSE;
+  guint tail = g_atomic_int_get (&writer->tail);
+
+  for (;;)
+    {
+      /* Read stop before head so nothing appended before stopping
+       * can be missed. */
+      gboolean stopping = g_atomic_int_get (&writer->stop);
+      guint head = g_atomic_int_get (&writer->head);
+      int interval;
+
+      if (head != tail)
+        {
+          /* Once writing has failed the output is discarded so the
+           * printing side never waits on a writer that can't make
+           * progress. */
+          while (tail != head
+                 && g_atomic_int_get (&writer->write_errno) == 0)
+            {
+              guint len = log_writer_next_chunk (writer, tail, head - tail);
+
+              if (g_atomic_int_get (&writer->write_errno) != 0)
+                break;
+              if (!log_writer_write (writer, tail, tail + len))
+                {
+                  log_writer_fail (writer, errno);
+                  break;
+                }
+              dirty = TRUE;
+              writer->file_size += len;
+              tail += len;
+            }
+          tail = head;
+          g_atomic_int_set (&writer->tail, tail);
+
+          if (g_atomic_int_get (&writer->printer_waiting))
+            {
+              g_mutex_lock (writer->lock);
+              g_cond_signal (writer->space);
+              g_mutex_unlock (writer->lock);
+            }
+        }
+
+      interval = g_atomic_int_get (&writer->fsync_interval);
+      if (dirty && interval > 0
+          && g_timer_elapsed (since_sync, NULL) >= interval)
+        {
+          /* EINVAL just means the log is something like a pipe
+           * that can't be synced. */
+          if (fdatasync (writer->fd) != 0 && errno != EINVAL)
+            log_writer_fail (writer, errno);
+          dirty = FALSE;
+          g_timer_start (since_sync);
+        }
+
+      if (stopping)
+        break;
+
+      g_mutex_lock (writer->lock);
+      if (!g_atomic_int_get (&writer->stop)
+          && ((guint)g_atomic_int_get (&writer->head) - tail
+              < LOG_WAKE_THRESHOLD))
+        {
+          GTimeVal until;
+
+          g_get_current_time (&until);
+          g_time_val_add (&until, LOG_FLUSH_INTERVAL_MS * 1000);
+          g_cond_timed_wait (writer->wake, writer->lock, &until);
+        }
+      g_mutex_unlock (writer->lock);
+    }
+
+  if (dirty && fsync (writer->fd) != 0 && errno != EINVAL)
+    log_writer_fail (writer, errno);
+
+  g_timer_destroy (since_sync);
+  return NULL;
+}
+
+/* Blocks the printing thread until the writer has made some space,
+ * or given up. */
+static void
+log_wait_for_space (BoshLogWriter *writer, guint head)
+{
+  g_mutex_lock (writer->lock);
+  g_atomic_int_set (&writer->printer_waiting, 1);
+  g_cond_signal (writer->wake);
+  while (head - (guint)g_atomic_int_get (&writer->tail) == LOG_RING_SIZE
+         && g_atomic_int_get (&writer->write_errno) == 0)
+    {
+      GTimeVal until;
+
+      /* The timeout only guards against a writer that stopped moving
+       * tail because it failed between our check and the wait. */
+      g_get_current_time (&until);
+      g_time_val_add (&until, LOG_FLUSH_INTERVAL_MS * 1000);
+      g_cond_timed_wait (writer->space, writer->lock, &until);
+    }
+  g_atomic_int_set (&writer->printer_waiting, 0);
+  g_mutex_unlock (writer->lock);
+}
+
+/* Copies LEN bytes of DATA into the ring.  If BLOCK is FALSE the
+ * data is only added if it fits as a whole; returns FALSE if it was
+ * dropped. */
+gboolean
+bosh_log_writer_append (BoshLogWriter *writer, const char *data, gsize len,
+                        gboolean block)
+{
+  guint head = g_atomic_int_get (&writer->head);
+
+  if (!block
+      && LOG_RING_SIZE - (head - (guint)g_atomic_int_get (&writer->tail))
+         < len)
+    return FALSE;
+
+  while (len)
+    {
+      guint space =
+        LOG_RING_SIZE - (head - (guint)g_atomic_int_get (&writer->tail));
+      guint start = head & (LOG_RING_SIZE - 1);
+      guint n;
+      guint first;
+
+      if (space == 0)
+        {
+          if (g_atomic_int_get (&writer->write_errno) != 0)
+            return FALSE;
+          log_wait_for_space (writer, head);
+          continue;
+        }
+
+      n = MIN (len, space);
+      first = MIN (n, LOG_RING_SIZE - start);
+      memcpy (writer->ring + start, data, first);
+      memcpy (writer->ring, data + first, n - first);
+
+      head += n;
+      g_atomic_int_set (&writer->head, head);
+      data += n;
+      len -= n;
+      writer->logged_bytes += n;
+    }
+
+  if (head - (guint)g_atomic_int_get (&writer->tail) >= LOG_WAKE_THRESHOLD)
+    g_cond_signal (writer->wake);
+
+  return TRUE;
+}
+
+static void
+log_print (const gchar *string)
+{
+  BoshLogWriter *writer = log_writer;
+  gboolean block = logging_overflow == overflow_block;
+
+  if (!writer || !logging_redirect)
+    {
+      if (saved_print_handler)
+        saved_print_handler (string);
+      else
+        {
+          fputs (string, stdout);
+          fflush (stdout);
+        }
+    }
+
+  if (!writer)
+    return;
+
+  /* Leave a note in the log where output went missing. */
+  if (writer->unreported_drops)
+    {
+      char *note = g_strdup_printf (_("[%u messages not logged]\n"),
+                                    writer->unreported_drops);
+      if (bosh_log_writer_append (writer, note, strlen (note), block))
+        writer->unreported_drops = 0;
+      g_free (note);
+    }
+
+  if (!bosh_log_writer_append (writer, string, strlen (string), block))
+    {
+      writer->dropped_messages++;
+      writer->unreported_drops++;
+      writer->dropped_bytes += strlen (string);
+    }
+}
+
+/* Opens FILENAME for logging, truncating it first if OVERWRITE is
+ * TRUE, and starts a thread to write to it. */
+BoshLogWriter *
+bosh_log_writer_new (const char *filename, gboolean overwrite,
+                     GError **error)
+{
+  BoshLogWriter *writer;
+  int flags = O_WRONLY | O_CREAT | (overwrite ? O_TRUNC : O_APPEND);
+  int fd = open (filename, flags, 0666);
+  struct stat st;
+
+  if (fd < 0)
+    {
+      int save_errno = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
+                   "%s: %s", filename, g_strerror (save_errno));
+      return NULL;
+    }
+
+  writer = g_new0 (BoshLogWriter, 1);
+  writer->filename = g_strdup (filename);
+  writer->fd = fd;
+  /* Only regular files get rotated, not pipes or terminals */
+  if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode))
+    {
+      writer->rotatable = TRUE;
+      writer->file_size = st.st_size;
+    }
+  writer->ring = g_malloc (LOG_RING_SIZE);
+  writer->lock = g_mutex_new ();
+  writer->wake = g_cond_new ();
+  writer->space = g_cond_new ();
+
+  writer->thread = g_thread_create (log_writer_thread, writer, TRUE, error);
+  if (!writer->thread)
+    {
+      close (fd);
+      g_cond_free (writer->space);
+      g_cond_free (writer->wake);
+      g_mutex_free (writer->lock);
+      g_free (writer->ring);
+      g_free (writer->filename);
+      g_free (writer);
+      return NULL;
+    }
+
+  return writer;
+}
+
+/* Waits for everything logged so far to be written out and closes
+ * the log.  Returns the writer's errno, if it failed at some point. */
+int
+bosh_log_writer_free (BoshLogWriter *writer)
+{
+  int write_errno;
+
+  g_mutex_lock (writer->lock);
+  g_atomic_int_set (&writer->stop, 1);
+  g_cond_signal (writer->wake);
+  g_mutex_unlock (writer->lock);
+  g_thread_join (writer->thread);
+  if (writer->compress_thread)
+    g_thread_join (writer->compress_thread);
+
+  write_errno = g_atomic_int_get (&writer->write_errno);
+  if (close (writer->fd) != 0 && write_errno == 0)
+    write_errno = errno;
+
+  g_cond_free (writer->space);
+  g_cond_free (writer->wake);
+  g_mutex_free (writer->lock);
+  g_free (writer->ring);
+  g_free (writer->filename);
+  g_free (writer);
+
+  return write_errno;
+}
+
+void
+bosh_log_writer_set_fsync_interval (BoshLogWriter *writer, int seconds)
+{
+  g_atomic_int_set (&writer->fsync_interval, MAX (seconds, 0));
+}
+
+/* Starts a new file, keeping KEEP old ones, whenever the log would
+ * grow past MAX_SIZE bytes.  A MAX_SIZE of 0 means no limit. */
+void
+bosh_log_writer_set_rotation (BoshLogWriter *writer, guint64 max_size,
+                              int keep, gboolean compress)
+{
+  g_mutex_lock (writer->lock);
+  writer->max_size = max_size;
+  writer->keep = MAX (keep, 0);
+  writer->compress = compress;
+  g_mutex_unlock (writer->lock);
+}
+
+gboolean
+bosh_log_is_active (void)
+{
+  return log_writer != NULL;
+}
+
+/* Stop logging, making sure all the output has reached the file.
+ * Also called at exit. */
+void
+bosh_log_stop (void)
+{
+  BoshLogWriter *writer = log_writer;
+  guint dropped;
+  char *filename;
+  int write_errno;
+
+  if (!writer)
+    return;
+
+  log_writer = NULL;
+
+  dropped = writer->dropped_messages;
+  filename = g_strdup (writer->filename);
+  write_errno = bosh_log_writer_free (writer);
+
+  if (write_errno)
+    g_print (_("Writing to %s failed: %s\n"), filename,
+             g_strerror (write_errno));
+  if (dropped)
+    g_print (_("%u messages were not logged because the log fell "
+               "behind.\n"), dropped);
+  g_free (filename);
+}
+
+static void
+bosh_set_logging_command (char *args, int from_tty)
+{
+  g_print (_("\"set logging\" lets you log output to a file.\n"
+             "Usage: set logging on [FILENAME]\n"
+             "       set logging off\n"
+             "       set logging file FILENAME\n"
+             "       set logging overwrite [on|off]\n"
+             "       set logging redirect [on|off]\n"
+             "       set logging overflow [block|drop]\n"
+             "       set logging fsync-interval SECONDS\n"
+             "       set logging max-size SIZE\n"
+             "       set logging keep N\n"
+             "       set logging compress [on|off]\n"));
+}
+
+static void
+bosh_set_logging_on_command (char *args, int from_tty)
+{
+  static gboolean registered_atexit = FALSE;
+  GError *error = NULL;
+
+  if (args && *args)
+    {
+      g_free (logging_filename);
+      logging_filename = g_strdup (args);
+    }
+
+  if (log_writer)
+    {
+      g_print (_("Already logging to %s.\n"), log_writer->filename);
+      return;
+    }
+
+  log_writer = bosh_log_writer_new (logging_filename, logging_overwrite,
+                                    &error);
+  if (!log_writer)
+    {
+      g_print (_("set logging: %s\n"), error->message);
+      g_error_free (error);
+      return;
+    }
+
+  if (!registered_atexit)
+    {
+      atexit (bosh_log_stop);
+      registered_atexit = TRUE;
+    }
+
+  if (from_tty)
+    {
+      if (logging_redirect)
+        g_print (_("Redirecting output to %s.\n"), logging_filename);
+      else
+        g_print (_("Copying output to %s.\n"), logging_filename);
+    }
+
+  bosh_log_writer_set_fsync_interval (log_writer, logging_fsync_interval);
+  bosh_log_writer_set_rotation (log_writer, logging_max_size, logging_keep,
+                                logging_compress);
+
+  /* The handler stays installed once logging has been used and just
+   * passes output on while logging is off.  That way handlers other
+   * modules install on top of it are never unhooked. */
+  if (!print_handler_installed)
+    {
+      saved_print_handler = g_set_print_handler (log_print);
+      print_handler_installed = TRUE;
+    }
+}
+
+static void
+bosh_set_logging_off_command (char *args, int from_tty)
+{
+  char *filename;
+
+  if (!log_writer)
+    return;
+
+  filename = g_strdup (log_writer->filename);
+  bosh_log_stop ();
+  if (from_tty)
+    g_print (_("Done logging to %s.\n"), filename);
+  g_free (filename);
+}
+
+static void
+bosh_show_logging_command (char *args, int from_tty)
+{
+  BoshLogWriter *writer = log_writer;
+
+  if (writer)
+    {
+      int write_errno = g_atomic_int_get (&writer->write_errno);
+      guint pending = (guint)g_atomic_int_get (&writer->head)
+        - (guint)g_atomic_int_get (&writer->tail);
+
+      g_print (_("Currently logging to \"%s\".\n"), writer->filename);
+      g_print (_("%" G_GUINT64_FORMAT " bytes logged, %u waiting to be "
+                 "written.\n"), writer->logged_bytes, pending);
+      if (writer->dropped_messages)
+        g_print (_("%u messages (%" G_GUINT64_FORMAT " bytes) were not "
+                   "logged because the log fell behind.\n"),
+                 writer->dropped_messages, writer->dropped_bytes);
+      if (write_errno)
+        g_print (_("Writing to the log failed: %s\n"),
+                 g_strerror (write_errno));
+    }
+  if (!writer || strcmp (logging_filename, writer->filename) != 0)
+    g_print (_("Future logs will be written to %s.\n"), logging_filename);
+
+  if (logging_overwrite)
+    g_print (_("Logs will overwrite the log file.\n"));
+  else
+    g_print (_("Logs will be appended to the log file.\n"));
+
+  if (logging_redirect)
+    g_print (_("Output will be sent only to the log file.\n"));
+  else
+    g_print (_("Output will be logged and displayed.\n"));
+
+  if (logging_overflow == overflow_block)
+    g_print (_("Output waits for the log when it falls behind.\n"));
+  else
+    g_print (_("Output is not logged when the log falls behind.\n"));
+
+  if (logging_fsync_interval > 0)
+    g_print (_("The log is synced to disk every %d seconds.\n"),
+             logging_fsync_interval);
+  else
+    g_print (_("The log is only synced to disk when it is closed.\n"));
+
+  if (logging_max_size)
+    g_print (_("A new log file is started every %s, keeping %d old ones%s."
+               "\n"),
+             logging_max_size_string, logging_keep,
+             logging_compress ? _(" compressed") : "");
+  else
+    g_print (_("The log file is never rotated.\n"));
+}
+
+static void
+show_logging_filename (GIOChannel *file, int from_tty,
+                       struct cmd_list_element *c, const char *value)
+{
+  g_print (_("The current logfile is \"%s\".\n"), value);
+}
+
+static void
+show_logging_overwrite (GIOChannel *file, int from_tty,
+                        struct cmd_list_element *c, const char *value)
+{
+  g_print (_("Whether logging overwrites or appends to the log file is "
+             "%s.\n"), value);
+}
+
+static void
+show_logging_redirect (GIOChannel *file, int from_tty,
+                       struct cmd_list_element *c, const char *value)
+{
+  g_print (_("The logging output mode is %s.\n"), value);
+}
+
+static void
+show_logging_overflow (GIOChannel *file, int from_tty,
+                       struct cmd_list_element *c, const char *value)
+{
+  g_print (_("When the log falls behind, output will %s.\n"),
+           logging_overflow == overflow_block
+           ? _("wait for it") : _("not be logged"));
+}
+
+static void
+set_logging_fsync_interval (char *args, int from_tty,
+                            struct cmd_list_element *c)
+{
+  if (log_writer)
+    bosh_log_writer_set_fsync_interval (log_writer, logging_fsync_interval);
+}
+
+/* Parses a size such as "4096", "512K", "100M" or "2G" */
+static gboolean
+parse_size (const char *str, guint64 *size)
+{
+  char *end;
+  guint64 value;
+
+  if (strcmp (str, "unlimited") == 0)
+    {
+      *size = 0;
+      return TRUE;
+    }
+
+  value = g_ascii_strtoull (str, &end, 10);
+  if (end == str)
+    return FALSE;
+  switch (g_ascii_tolower (*end))
+    {
+    case 'g':
+      value <<= 10;
+      /* fall through */
+    case 'm':
+      value <<= 10;
+      /* fall through */
+    case 'k':
+      value <<= 10;
+      end++;
+    default:
+      break;
+    }
+  if (*end != '\0')
+    return FALSE;
+
+  *size = value;
+  return TRUE;
+}
+
+static void
+set_logging_rotation (char *args, int from_tty, struct cmd_list_element *c)
+{
+  if (log_writer)
+    bosh_log_writer_set_rotation (log_writer, logging_max_size,
+                                  logging_keep, logging_compress);
+}
+
+static void
+set_logging_max_size (char *args, int from_tty, struct cmd_list_element *c)
+{
+  guint64 size;
+
+  g_strstrip (logging_max_size_string);
+  if (!parse_size (logging_max_size_string, &size))
+    {
+      g_print (_("Invalid size \"%s\"; expected a number of bytes "
+                 "optionally followed by K, M or G.\n"),
+               logging_max_size_string);
+      size = logging_max_size;
+    }
+
+  logging_max_size = size;
+  g_free (logging_max_size_string);
+  if (size == 0)
+    logging_max_size_string = g_strdup ("unlimited");
+  else if (size % (1 << 30) == 0)
+    logging_max_size_string =
+      g_strdup_printf ("%" G_GUINT64_FORMAT "G", size >> 30);
+  else if (size % (1 << 20) == 0)
+    logging_max_size_string =
+      g_strdup_printf ("%" G_GUINT64_FORMAT "M", size >> 20);
+  else if (size % (1 << 10) == 0)
+    logging_max_size_string =
+      g_strdup_printf ("%" G_GUINT64_FORMAT "K", size >> 10);
+  else
+    logging_max_size_string = g_strdup_printf ("%" G_GUINT64_FORMAT, size);
+
+  set_logging_rotation (args, from_tty, c);
+}
+
+static void
+show_logging_max_size (GIOChannel *file, int from_tty,
+                       struct cmd_list_element *c, const char *value)
+{
+  g_print (_("The maximum size of a log file is %s.\n"), value);
+}
+
+static void
+show_logging_keep (GIOChannel *file, int from_tty,
+                   struct cmd_list_element *c, const char *value)
+{
+  g_print (_("The number of rotated log files kept is %s.\n"), value);
+}
+
+static void
+show_logging_compress (GIOChannel *file, int from_tty,
+                       struct cmd_list_element *c, const char *value)
+{
+  g_print (_("Whether rotated log files are compressed is %s.\n"), value);
+}
+
+static void
+show_logging_fsync_interval (GIOChannel *file, int from_tty,
+                             struct cmd_list_element *c, const char *value)
+{
+  g_print (_("The log is synced to disk every %s seconds "
+             "(0 means only when it is closed).\n"), value);
+}
+
+void
+bosh_log_init_commands (void)
+{
+  struct cmd_list_element *c;
+
+  logging_filename = g_strdup ("bosh.txt");
+  logging_max_size_string = g_strdup ("unlimited");
+
+  c = bosh_command_list_add_prefix (&setlist, "logging", class_support,
+                                    bosh_set_logging_command,
+                                    _("Set logging options"),
+                                    &set_logging_list, "set logging ", 0);
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+  c = bosh_command_list_add_prefix (&showlist, "logging", class_support,
+                                    bosh_show_logging_command,
+                                    _("Show logging options"),
+                                    &show_logging_list, "show logging ", 0);
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+
+  add_setshow_boolean_cmd ("overwrite", class_support, &logging_overwrite,
+                           _("Set whether logging overwrites or appends to "
+                             "the log file."),
+                           _("Show whether logging overwrites or appends to "
+                             "the log file."),
+                           _("If set, logging overrides the log file."),
+                           NULL,
+                           show_logging_overwrite,
+                           &set_logging_list, &show_logging_list);
+  add_setshow_boolean_cmd ("redirect", class_support, &logging_redirect,
+                           _("Set the logging output mode."),
+                           _("Show the logging output mode."),
+                           _("If redirect is off, output will go to both the "
+                             "screen and the log file.\n"
+                             "If redirect is on, output will go only to the "
+                             "log file."),
+                           NULL,
+                           show_logging_redirect,
+                           &set_logging_list, &show_logging_list);
+  add_setshow_filename_cmd ("file", class_support, &logging_filename,
+                            _("Set the current logfile."),
+                            _("Show the current logfile."),
+                            _("The logfile is used when directing bosh's "
+                              "output."),
+                            NULL,
+                            show_logging_filename,
+                            &set_logging_list, &show_logging_list);
+  add_setshow_enum_cmd ("overflow", class_support, overflow_enums,
+                        &logging_overflow,
+                        _("Set what happens when the log falls behind."),
+                        _("Show what happens when the log falls behind."),
+                        _("Output is written to the log file in the "
+                          "background.  If it is produced faster\n"
+                          "than it can be written, \"block\" makes bosh wait "
+                          "for the log to catch up\n"
+                          "and \"drop\" leaves the output out of the log "
+                          "(the number of messages\n"
+                          "left out is shown by \"show logging\")."),
+                        NULL,
+                        show_logging_overflow,
+                        &set_logging_list, &show_logging_list);
+  add_setshow_zinteger_cmd ("fsync-interval", class_support,
+                            &logging_fsync_interval,
+                            _("Set how often the log is synced to disk."),
+                            _("Show how often the log is synced to disk."),
+                            _("The log file is synced at most every this many "
+                              "seconds while output is\n"
+                              "being logged.  With 0 it is only synced when "
+                              "logging is turned off."),
+                            set_logging_fsync_interval,
+                            show_logging_fsync_interval,
+                            &set_logging_list, &show_logging_list);
+
+  add_setshow_string_noescape_cmd ("max-size", class_support,
+                                   &logging_max_size_string,
+                                   _("Set the size at which a new log file "
+                                     "is started."),
+                                   _("Show the size at which a new log file "
+                                     "is started."),
+                                   _("When writing more output would take "
+                                     "the log file past this size it is\n"
+                                     "renamed to FILE.1 and a new log file "
+                                     "is started.  Older files are renamed\n"
+                                     "to FILE.2 and so on, up to \"set "
+                                     "logging keep\".  The size can be "
+                                     "given\n"
+                                     "with a K, M or G suffix; \"unlimited\" "
+                                     "turns rotation off."),
+                                   set_logging_max_size,
+                                   show_logging_max_size,
+                                   &set_logging_list, &show_logging_list);
+  add_setshow_zinteger_cmd ("keep", class_support, &logging_keep,
+                            _("Set how many rotated log files are kept."),
+                            _("Show how many rotated log files are kept."),
+                            _("With 0 the log file is simply emptied when "
+                              "it reaches \"set logging max-size\"."),
+                            set_logging_rotation,
+                            show_logging_keep,
+                            &set_logging_list, &show_logging_list);
+  add_setshow_boolean_cmd ("compress", class_support, &logging_compress,
+                           _("Set whether rotated log files are "
+                             "compressed."),
+                           _("Show whether rotated log files are "
+                             "compressed."),
+                           _("If set, each log file is gzipped in the "
+                             "background once it has been rotated\n"
+                             "to FILE.1 (becoming FILE.1.gz)."),
+                           set_logging_rotation,
+                           show_logging_compress,
+                           &set_logging_list, &show_logging_list);
+
+  c = bosh_command_list_add (&set_logging_list, "on", class_support,
+                             bosh_set_logging_on_command,
+                             _("Enable logging."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+  c = bosh_command_list_add (&set_logging_list, "off", class_support,
+                             bosh_set_logging_off_command,
+                             _("Disable logging."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+}
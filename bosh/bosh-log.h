@@ -0,0 +1,51 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_LOG_H
+#define BOSH_LOG_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BoshLogWriter BoshLogWriter;
+
+BoshLogWriter *bosh_log_writer_new (const char *filename,
+                                    gboolean overwrite,
+                                    GError **error);
+gboolean bosh_log_writer_append (BoshLogWriter *writer,
+                                 const char *data,
+                                 gsize len,
+                                 gboolean block);
+void bosh_log_writer_set_fsync_interval (BoshLogWriter *writer,
+                                         int seconds);
+void bosh_log_writer_set_rotation (BoshLogWriter *writer,
+                                   guint64 max_size,
+                                   int keep,
+                                   gboolean compress);
+int bosh_log_writer_free (BoshLogWriter *writer);
+
+gboolean bosh_log_is_active (void);
+
+void bosh_log_stop (void);
+
+void bosh_log_init_commands (void);
+
+G_END_DECLS
+
+#endif /* BOSH_LOG_H */
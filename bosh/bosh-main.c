@@ -37,7 +37,17 @@
 #include "cli-decode.h"
 #include "completer.h"
 
+#include "bosh-batch.h"
 #include "bosh-commands.h"
+#include "bosh-core.h"
+#include "bosh-fake-debuggable.h"
+#include "bosh-inferior.h"
+#include "bosh-journal.h"
+#include "bosh-maint.h"
+#include "bosh-pause.h"
+#include "bosh-server.h"
+#include "bosh-step.h"
+#include "bosh-triage.h"
 #include "bosh-utils.h"
 
 #ifdef BOSH_ENABLE_DEBUG
@@ -51,7 +61,12 @@ static const gint n_bosh_debug_keys = G_N_ELEMENTS (bosh_debug_keys);
 guint bosh_debug_flags;
 
 static gint pid = -1;
+static gboolean batch = FALSE;
+static gboolean have_batch_commands = FALSE;
+static BoshTriageOptions triage_options = { NULL, };
 static gchar **remaining_args = NULL;
+static gchar *server_path = NULL;
+static gchar *fake_target = NULL;
 static int signal_pipe[2];
 
 GSwatDebuggable *_bosh_current_debuggable;
@@ -63,6 +78,16 @@ bosh_get_default_debuggable (void)
   return _bosh_current_debuggable;
 }
 
+/* The process id of the current inferior if it's a local target, or -1
+ * if it isn't known */
+int
+bosh_get_target_pid (void)
+{
+  BoshInferior *inferior = bosh_inferior_get_current ();
+
+  return inferior ? inferior->pid : -1;
+}
+
 gboolean
 input_available_cb (GIOChannel *input, GIOCondition condition, gpointer data)
 {
@@ -97,6 +122,29 @@ bosh_arg_no_debug_cb (const char *key,
 }
 #endif /* CLUTTER_DEBUG */
 
+/* --ex and -x share the one queue so commands run in the order they
+ * were given on the command line. */
+static gboolean
+bosh_arg_ex_cb (const char *key,
+                const char *value,
+                gpointer user_data,
+                GError **error)
+{
+  bosh_batch_add_command (value);
+  have_batch_commands = TRUE;
+  return TRUE;
+}
+
+static gboolean
+bosh_arg_command_file_cb (const char *key,
+                          const char *value,
+                          gpointer user_data,
+                          GError **error)
+{
+  have_batch_commands = TRUE;
+  return bosh_batch_add_file (value, error);
+}
+
 static GOptionEntry bosh_args[] = {
 #ifdef BOSH_ENABLE_DEBUG
       { "bosh-debug", 0, 0, G_OPTION_ARG_CALLBACK, bosh_arg_debug_cb,
@@ -106,6 +154,32 @@ static GOptionEntry bosh_args[] = {
 #endif /* BOSH_ENABLE_DEBUG */
       { "pid", 0, G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_INT, &pid,
 	 "Attach to running process PID", NULL },
+      { "batch", 0, 0, G_OPTION_ARG_NONE, &batch,
+        "Exit after processing options", NULL },
+      { "ex", 0, 0, G_OPTION_ARG_CALLBACK, bosh_arg_ex_cb,
+        "Execute a single bosh command", "COMMAND" },
+      { "command", 'x', G_OPTION_FLAG_FILENAME, G_OPTION_ARG_CALLBACK,
+        bosh_arg_command_file_cb,
+        "Execute bosh commands from FILE", "FILE" },
+      { "server", 0, 0, G_OPTION_ARG_FILENAME, &server_path,
+        "Accept JSON-RPC requests on the UNIX domain socket PATH", "PATH" },
+      { "fake-target", 0, 0, G_OPTION_ARG_FILENAME, &fake_target,
+        "Debug a scripted fake target described by SCENARIO instead of "
+        "a real program", "SCENARIO" },
+      { "triage", 0, 0, G_OPTION_ARG_FILENAME, &triage_options.directory,
+        "Group the core files in DIR by crash signature", "DIR" },
+      { "exec", 'e', 0, G_OPTION_ARG_FILENAME, &triage_options.executable,
+        "Use EXE as the executable for --triage", "EXE" },
+      { "jobs", 'j', 0, G_OPTION_ARG_INT, &triage_options.jobs,
+        "Number of core files to load at once (default: one per CPU)",
+        "N" },
+      { "triage-depth", 0, 0, G_OPTION_ARG_INT, &triage_options.depth,
+        "Number of innermost frames in a crash signature (default: 5)",
+        "N" },
+      { "triage-mem-limit", 0, 0, G_OPTION_ARG_INT,
+        &triage_options.mem_limit,
+        "Address space limit for each core being loaded (default: 2048)",
+        "MiB" },
       { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &remaining_args,
         "[executable-file [core-file or process-id]]" },
       { NULL, },
@@ -179,6 +253,22 @@ parse_args (int *argc, char ***argv)
       gswat_session_set_target (session, target);
       g_free (target);
     }
+  else if (remaining_args != NULL
+           && remaining_args[1] != NULL
+           && remaining_args[2] == NULL
+           && bosh_core_file_is_core (remaining_args[1]))
+    {
+      char *command = g_strdup_printf ("core-file %s", remaining_args[1]);
+
+      /* There's no live session for a core: it's read directly and the
+       * executable only supplies the symbols for the main program.
+       * Nothing is read from the core until it's needed so this is
+       * cheap, whatever its size */
+      bosh_core_set_executable (remaining_args[0]);
+      bosh_batch_add_command (command);
+      have_batch_commands = TRUE;
+      g_free (command);
+    }
   else if (remaining_args != NULL)
     {
       int i;
@@ -239,8 +329,18 @@ static void
 on_source_line_change (GObject *object, GParamSpec *pspec, gpointer data)
 {
   GSwatDebuggable *debuggable = GSWAT_DEBUGGABLE (object);
-  char *uri = gswat_debuggable_get_source_uri (debuggable);
-  gint line = gswat_debuggable_get_source_line (debuggable);
+  char *uri;
+  gint line;
+
+  /* The final stop of a counted step is printed once it's done, and
+   * stops followed by more typed-ahead commands aren't printed at all.
+   * Other inferiors just report that they stopped. */
+  if (debuggable != _bosh_current_debuggable
+      || bosh_step_is_active () || bosh_batch_collapse_stop ())
+    return;
+
+  uri = gswat_debuggable_get_source_uri (debuggable);
+  line = gswat_debuggable_get_source_line (debuggable);
 
   if (uri)
     {
@@ -251,15 +351,68 @@ on_source_line_change (GObject *object, GParamSpec *pspec, gpointer data)
   bosh_utils_print_current_frame (debuggable);
 }
 
+static void
+finish_state_change (GSwatDebuggable *debuggable)
+{
+  bosh_journal_state_changed (debuggable);
+
+  if (bosh_batch_is_active ())
+    bosh_batch_state_changed (debuggable);
+  else
+    bosh_utils_update_prompt ();
+}
+
 static void
 on_state_change (GObject *object, GParamSpec *pspec, gpointer data)
 {
   GSwatDebuggable *debuggable = GSWAT_DEBUGGABLE (object);
-  GSwatDebuggableState state = gswat_debuggable_get_state (debuggable);
-  if (state == GSWAT_DEBUGGABLE_RUNNING)
-    bosh_utils_disable_prompt ();
-  else
-    bosh_utils_enable_prompt ();
+
+  bosh_server_state_changed (debuggable);
+
+  if (bosh_inferior_state_changed (debuggable))
+    return;
+
+  bosh_pause_state_changed (debuggable);
+
+  if (bosh_step_state_changed (debuggable))
+    return;
+
+  finish_state_change (debuggable);
+}
+
+/* Called once a counted step is over, for the stop it ended on.  The
+ * stops along the way were swallowed by bosh_step_state_changed so
+ * this is the first the journal, batch and prompt handling hear of
+ * it. */
+void
+bosh_main_step_finished (GSwatDebuggable *debuggable)
+{
+  finish_state_change (debuggable);
+}
+
+/* Hooks up the usual rendering and prompt handling for a new
+ * debuggable.  Only the current inferior's changes are rendered. */
+void
+bosh_main_watch_debuggable (GSwatDebuggable *debuggable)
+{
+  g_signal_connect (G_OBJECT (debuggable),
+                    "notify::stack",
+                    G_CALLBACK (on_stack_change),
+                    NULL);
+
+  g_signal_connect (G_OBJECT (debuggable),
+                   "notify::source-uri",
+                    G_CALLBACK (on_source_uri_change),
+                    NULL);
+  g_signal_connect (G_OBJECT (debuggable),
+                   "notify::source-line",
+                    G_CALLBACK (on_source_line_change),
+                    NULL);
+
+  g_signal_connect (G_OBJECT (debuggable),
+                   "notify::state",
+                    G_CALLBACK (on_state_change),
+                    NULL);
 }
 
 static gboolean
@@ -270,7 +423,12 @@ signal_handler (GIOChannel *source,
   char buf[4096];
 
   read (signal_pipe[0], buf, 4096);
-  if (strcmp (buf, "SIGINT") == 0)
+  if (strcmp (buf, "SIGINT") == 0 && bosh_step_is_active ())
+    {
+      g_print ("Interrupt, stopping after the current step\n");
+      bosh_step_cancel ();
+    }
+  else if (strcmp (buf, "SIGINT") == 0)
     {
       rl_free_line_state ();
       bosh_utils_disable_prompt ();
@@ -296,8 +454,8 @@ report_signal (int signal)
 int
 main (int argc, char **argv)
 {
-  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
-  GIOChannel *input = g_io_channel_unix_new (STDIN_FILENO);
+  GMainLoop *loop;
+  GIOChannel *input;
   const char *intro = "Bosh " PACKAGE_VERSION "\n"
     "Find out how to contribute @ http://fixme.org\n"
     "\n";
@@ -305,44 +463,66 @@ main (int argc, char **argv)
   GIOChannel *signal_reciever;
   struct sigaction signal_action;
 
+  /* Before anything else so glib hasn't allocated yet */
+  bosh_maint_count_allocations ();
+
+  loop = g_main_loop_new (NULL, FALSE);
+  input = g_io_channel_unix_new (STDIN_FILENO);
+
   rl_catch_signals = 0;
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
   g_type_init ();
   gswat_init (&argc, &argv);
 
-  g_print ("%s", intro);
-
+  triage_options.mem_limit = 2048;
   session = parse_args (&argc, &argv);
 
+  if (triage_options.directory)
+    return bosh_triage_run (&triage_options);
+
+  if (!batch)
+    g_print ("%s", intro);
+
   bosh_disable_g_log ();
   bosh_init_commands ();
 
-  rl_completion_entry_function = bosh_readline_line_completion_function;
-  bosh_utils_enable_prompt ();
-
-  g_io_add_watch (input, G_IO_IN, input_available_cb, NULL);
+  if (!batch)
+    {
+      rl_completion_entry_function = bosh_readline_line_completion_function;
+      /* So a pasted block of commands is seen as one batch */
+      rl_variable_bind ("enable-bracketed-paste", "on");
+      g_io_add_watch (input, G_IO_IN, input_available_cb, NULL);
+    }
 
   if (session)
-    _bosh_current_debuggable = GSWAT_DEBUGGABLE (gswat_gdb_debugger_new (session));
+    bosh_inferior_add (session, remaining_args[0], pid);
 
+  if (fake_target)
+    {
+      GError *error = NULL;
+      BoshFakeDebuggable *fake = bosh_fake_debuggable_new (fake_target,
+                                                           &error);
 
-  g_signal_connect (G_OBJECT (_bosh_current_debuggable),
-                    "notify::stack",
-                    G_CALLBACK (on_stack_change),
-                    NULL);
-
-  g_signal_connect (G_OBJECT (_bosh_current_debuggable),
-                   "notify::source-uri",
-                    G_CALLBACK (on_source_uri_change),
-                    NULL);
-  g_signal_connect (G_OBJECT (_bosh_current_debuggable),
-                   "notify::source-line",
-                    G_CALLBACK (on_source_line_change),
-                    NULL);
+      if (!fake)
+        {
+          g_printerr ("%s\n", error->message);
+          g_error_free (error);
+          exit (1);
+        }
+      bosh_inferior_add_debuggable (GSWAT_DEBUGGABLE (fake), fake_target, -1);
+    }
 
-  g_signal_connect (G_OBJECT (_bosh_current_debuggable),
-                   "notify::state",
-                    G_CALLBACK (on_state_change),
-                    NULL);
+  if (server_path)
+    {
+      GError *error = NULL;
+      if (!bosh_server_start (server_path, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          g_error_free (error);
+          exit (1);
+        }
+    }
 
   pipe (signal_pipe);
 
@@ -353,6 +533,14 @@ main (int argc, char **argv)
   signal_action.sa_flags = 0;
   sigaction (SIGINT, &signal_action, NULL);
 
+  if (batch || have_batch_commands)
+    bosh_batch_run (loop, batch);
+
+  /* Typing can start straight away, even while the commands given on
+   * the command line run */
+  if (!batch)
+    bosh_utils_enable_prompt ();
+
   g_main_loop_run (loop);
 
   return 0;
@@ -8,6 +8,15 @@ extern GSwatDebuggable *_bosh_current_debuggable;
 GSwatDebuggable *
 bosh_get_default_debuggable (void);
 
+int
+bosh_get_target_pid (void);
+
+void
+bosh_main_watch_debuggable (GSwatDebuggable *debuggable);
+
+void
+bosh_main_step_finished (GSwatDebuggable *debuggable);
+
 G_END_DECLS
 
 #endif /* BOSH_MAIN_H */
@@ -0,0 +1,506 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Maintenance commands for finding out where bosh spends its time.
+ *
+ * Every command run through bosh_execute_command is measured: the wall
+ * clock time, the CPU time bosh itself used, and how many glib
+ * allocations it made.  gswat talks to gdb synchronously, so the wall
+ * time that wasn't spent on our CPU is (near enough) time spent
+ * waiting for the backend, and that's reported as the backend wait.
+ *
+ * "maintenance time on" and "maintenance space on" print the numbers
+ * after each command, like they did in gdb, and "maintenance stats"
+ * shows histograms of them for each command name. */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "cli-decode.h"
+
+#include "bosh-commands.h"
+#include "bosh-maint.h"
+#include "bosh-output.h"
+
+/* Log scale buckets of microseconds with four buckets per power of
+ * two, which puts the percentiles within about 20% */
+#define MAINT_HIST_BUCKETS 160
+
+typedef struct _MaintHistogram
+{
+  guint32 counts[MAINT_HIST_BUCKETS];
+  guint64 max;
+} MaintHistogram;
+
+typedef struct _MaintCommandStats
+{
+  char *name;
+  guint calls;
+  MaintHistogram wall;
+  MaintHistogram cpu;
+  MaintHistogram wait;
+  guint64 allocs;
+  guint64 alloc_bytes;
+} MaintCommandStats;
+
+/* A command being measured */
+typedef struct _MaintSample
+{
+  char *name;
+  gint64 wall_start;
+  gint64 cpu_start;
+  guint64 allocs_start;
+  guint64 bytes_start;
+} MaintSample;
+
+static struct cmd_list_element *maintenancelist;
+
+static gboolean maint_time;
+static gboolean maint_space;
+/* Command name -> MaintCommandStats */
+static GHashTable *command_stats;
+/* Commands can run other commands, so this is a stack */
+static GSList *samples;
+
+static gboolean alloc_counting;
+static guint64 n_allocs;
+static guint64 n_alloc_bytes;
+
+static gpointer
+counting_malloc (gsize n_bytes)
+{
+  n_allocs++;
+  n_alloc_bytes += n_bytes;
+  return malloc (n_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer mem, gsize n_bytes)
+{
+  n_allocs++;
+  n_alloc_bytes += n_bytes;
+  return realloc (mem, n_bytes);
+}
+
+static gpointer
+counting_calloc (gsize n_blocks, gsize n_block_bytes)
+{
+  n_allocs++;
+  n_alloc_bytes += n_blocks * n_block_bytes;
+  return calloc (n_blocks, n_block_bytes);
+}
+
+static GMemVTable counting_vtable = {
+  counting_malloc,
+  counting_realloc,
+  free,
+  counting_calloc,
+  NULL,
+  NULL
+};
+
+/* Starts counting glib allocations.  This has to be called before glib
+ * allocates anything, and returns FALSE if this glib doesn't support
+ * it.  Allocations from other threads are counted too, without
+ * locking, so the counts are approximate if other threads are busy. */
+gboolean
+bosh_maint_count_allocations (void)
+{
+  guint64 before;
+
+  g_mem_set_vtable (&counting_vtable);
+
+  before = n_allocs;
+  g_free (g_malloc (1));
+  alloc_counting = n_allocs != before;
+
+  return alloc_counting;
+}
+
+void
+bosh_maint_get_allocations (guint64 *count, guint64 *bytes)
+{
+  *count = n_allocs;
+  *bytes = n_alloc_bytes;
+}
+
+static gint64
+maint_wall_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static gint64
+maint_cpu_us (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+  return ((gint64)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+    * G_USEC_PER_SEC + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static int
+hist_bucket (guint64 us)
+{
+  guint bits;
+  int bucket;
+
+  if (us < 8)
+    return us;
+
+  bits = g_bit_storage (us);
+  bucket = (bits - 2) * 4 + ((us >> (bits - 3)) & 3);
+  return MIN (bucket, MAINT_HIST_BUCKETS - 1);
+}
+
+/* The smallest value that goes in BUCKET */
+static guint64
+hist_bucket_start (int bucket)
+{
+  if (bucket < 8)
+    return bucket;
+
+  return (guint64)(4 | (bucket & 3)) << (bucket / 4 - 1);
+}
+
+static void
+hist_add (MaintHistogram *hist, guint64 us)
+{
+  hist->counts[hist_bucket (us)]++;
+  if (us > hist->max)
+    hist->max = us;
+}
+
+/* The value at PERCENT of the way through the HIST, rounded up to the
+ * end of its bucket */
+static guint64
+hist_percentile (MaintHistogram *hist, guint total, int percent)
+{
+  guint64 rank = ((guint64)total * percent + 99) / 100;
+  guint64 seen = 0;
+  int i;
+
+  for (i = 0; i < MAINT_HIST_BUCKETS; i++)
+    {
+      seen += hist->counts[i];
+      if (seen >= rank && seen > 0)
+        return MIN (hist_bucket_start (i + 1) - 1, hist->max);
+    }
+  return hist->max;
+}
+
+/* Called by bosh_execute_command just before running the command C,
+ * where INPUT is the line it was looked up from */
+void
+bosh_maint_command_start (struct cmd_list_element *c, char *input)
+{
+  MaintSample *sample = g_new (MaintSample, 1);
+
+  sample->name = bosh_command_full_name (c, input);
+  samples = g_slist_prepend (samples, sample);
+
+  /* Taken last so our own bookkeeping stays out of the numbers */
+  sample->allocs_start = n_allocs;
+  sample->bytes_start = n_alloc_bytes;
+  sample->cpu_start = maint_cpu_us ();
+  sample->wall_start = maint_wall_us ();
+}
+
+void
+bosh_maint_command_end (void)
+{
+  gint64 wall_end = maint_wall_us ();
+  gint64 cpu_end = maint_cpu_us ();
+  guint64 allocs_end = n_allocs;
+  guint64 bytes_end = n_alloc_bytes;
+  MaintSample *sample;
+  MaintCommandStats *stats;
+  gint64 wall;
+  gint64 cpu;
+  gint64 wait;
+
+  g_return_if_fail (samples != NULL);
+
+  sample = samples->data;
+  samples = g_slist_delete_link (samples, samples);
+
+  wall = MAX (wall_end - sample->wall_start, 0);
+  cpu = MAX (cpu_end - sample->cpu_start, 0);
+  wait = MAX (wall - cpu, 0);
+
+  if (!command_stats)
+    command_stats = g_hash_table_new (g_str_hash, g_str_equal);
+  stats = g_hash_table_lookup (command_stats, sample->name);
+  if (!stats)
+    {
+      stats = g_new0 (MaintCommandStats, 1);
+      stats->name = sample->name;
+      g_hash_table_insert (command_stats, stats->name, stats);
+    }
+  else
+    g_free (sample->name);
+
+  stats->calls++;
+  hist_add (&stats->wall, wall);
+  hist_add (&stats->cpu, cpu);
+  hist_add (&stats->wait, wait);
+  stats->allocs += allocs_end - sample->allocs_start;
+  stats->alloc_bytes += bytes_end - sample->bytes_start;
+
+  /* Only report on commands typed at the top level */
+  if (!samples)
+    {
+      if (maint_time)
+        g_print (_("Command execution time: %" G_GINT64_FORMAT ".%06d "
+                   "(wall), %" G_GINT64_FORMAT ".%06d (cpu), "
+                   "%" G_GINT64_FORMAT ".%06d (backend wait)\n"),
+                 wall / G_USEC_PER_SEC, (int)(wall % G_USEC_PER_SEC),
+                 cpu / G_USEC_PER_SEC, (int)(cpu % G_USEC_PER_SEC),
+                 wait / G_USEC_PER_SEC, (int)(wait % G_USEC_PER_SEC));
+      if (maint_space && alloc_counting)
+        g_print (_("Space used: %" G_GUINT64_FORMAT " allocations, "
+                   "%" G_GUINT64_FORMAT " bytes\n"),
+                 allocs_end - sample->allocs_start,
+                 bytes_end - sample->bytes_start);
+      else if (maint_space)
+        g_print (_("Space used: unknown, this glib can't count "
+                   "allocations\n"));
+    }
+
+  g_free (sample);
+}
+
+static void
+bosh_maintenance_command (char *args, int from_tty)
+{
+  g_print (_("\"maintenance\" must be followed by the name of a "
+             "maintenance command.\n"));
+  help_list (maintenancelist, "maintenance ", -1, NULL);
+}
+
+/* Parses on/off (or 1/0 as gdb took) into *VALUE */
+static gboolean
+parse_on_off (char *args, gboolean *value)
+{
+  if (!args || !*args)
+    return FALSE;
+
+  args = g_strstrip (args);
+  if (strcmp (args, "on") == 0 || strcmp (args, "1") == 0)
+    *value = TRUE;
+  else if (strcmp (args, "off") == 0 || strcmp (args, "0") == 0)
+    *value = FALSE;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+bosh_maintenance_time_command (char *args, int from_tty)
+{
+  if (!args || !*args)
+    {
+      g_print (_("Command timing is %s.\n"), maint_time ? "on" : "off");
+      return;
+    }
+  if (!parse_on_off (args, &maint_time))
+    g_print (_("Usage: maintenance time on|off\n"));
+}
+
+static void
+bosh_maintenance_space_command (char *args, int from_tty)
+{
+  if (!args || !*args)
+    {
+      g_print (_("Command space usage is %s.\n"), maint_space ? "on" : "off");
+      return;
+    }
+  if (!parse_on_off (args, &maint_space))
+    g_print (_("Usage: maintenance space on|off\n"));
+  else if (maint_space && !alloc_counting)
+    g_print (_("This glib can't count allocations, so space usage "
+               "will be unknown.\n"));
+}
+
+static gint
+compare_stats (gconstpointer a, gconstpointer b)
+{
+  const MaintCommandStats *stats_a = a;
+  const MaintCommandStats *stats_b = b;
+
+  return strcmp (stats_a->name, stats_b->name);
+}
+
+static void
+free_stats (gpointer data)
+{
+  MaintCommandStats *stats = data;
+
+  g_free (stats->name);
+  g_free (stats);
+}
+
+static void
+bosh_maintenance_stats_command (char *args, int from_tty)
+{
+  GList *all;
+  GList *l;
+
+  if (args && strcmp (g_strstrip (args), "reset") == 0)
+    {
+      if (command_stats)
+        {
+          all = g_hash_table_get_values (command_stats);
+          g_hash_table_destroy (command_stats);
+          command_stats = NULL;
+          g_list_foreach (all, (GFunc)free_stats, NULL);
+          g_list_free (all);
+        }
+      g_print (_("Command statistics reset.\n"));
+      return;
+    }
+
+  if (!command_stats || g_hash_table_size (command_stats) == 0)
+    {
+      g_print (_("No commands have been run yet.\n"));
+      return;
+    }
+
+  all = g_list_sort (g_hash_table_get_values (command_stats), compare_stats);
+
+  bosh_output_text (_("Times are in microseconds.\n"));
+  bosh_output_text ("%-24s %6s %9s %9s %9s %9s %9s %9s",
+                    _("Command"), _("Calls"),
+                    _("Wall p50"), _("Wall p99"),
+                    _("CPU p50"), _("CPU p99"),
+                    _("Wait p50"), _("Wait p99"));
+  if (alloc_counting)
+    bosh_output_text (" %9s %9s", _("Allocs"), _("Bytes"));
+  bosh_output_text ("\n");
+  bosh_output_begin_list ("commands");
+  for (l = all; l; l = l->next)
+    {
+      MaintCommandStats *stats = l->data;
+
+      bosh_output_begin_record ("command");
+      bosh_output_field_fmt ("name", "%-24s", stats->name);
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("calls", "%6u", stats->calls);
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("wall-p50", "%9" G_GUINT64_FORMAT,
+                             hist_percentile (&stats->wall,
+                                              stats->calls, 50));
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("wall-p99", "%9" G_GUINT64_FORMAT,
+                             hist_percentile (&stats->wall,
+                                              stats->calls, 99));
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("cpu-p50", "%9" G_GUINT64_FORMAT,
+                             hist_percentile (&stats->cpu,
+                                              stats->calls, 50));
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("cpu-p99", "%9" G_GUINT64_FORMAT,
+                             hist_percentile (&stats->cpu,
+                                              stats->calls, 99));
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("wait-p50", "%9" G_GUINT64_FORMAT,
+                             hist_percentile (&stats->wait,
+                                              stats->calls, 50));
+      bosh_output_text (" ");
+      bosh_output_field_fmt ("wait-p99", "%9" G_GUINT64_FORMAT,
+                             hist_percentile (&stats->wait,
+                                              stats->calls, 99));
+      if (alloc_counting)
+        {
+          /* Per call, on average */
+          bosh_output_text (" ");
+          bosh_output_field_fmt ("allocs", "%9" G_GUINT64_FORMAT,
+                                 stats->allocs / stats->calls);
+          bosh_output_text (" ");
+          bosh_output_field_fmt ("bytes", "%9" G_GUINT64_FORMAT,
+                                 stats->alloc_bytes / stats->calls);
+        }
+      bosh_output_text ("\n");
+      bosh_output_end_record ();
+    }
+  bosh_output_end_list ();
+
+  g_list_free (all);
+}
+
+void
+bosh_maint_init_commands (void)
+{
+  struct cmd_list_element *c;
+
+  c = bosh_command_list_add_prefix (&cmdlist, "maintenance", class_maintenance,
+                                    bosh_maintenance_command,
+                                    _("Commands for use by bosh maintainers.\n"
+                                      "Includes commands to measure how long "
+                                      "commands take and how much\n"
+                                      "memory they use."),
+                                    &maintenancelist, "maintenance ", 0);
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+  bosh_add_command_alias ("mt", "maintenance", class_maintenance, 1);
+
+  c = bosh_command_list_add (&maintenancelist, "time", class_maintenance,
+                             bosh_maintenance_time_command,
+                             _("Print how long each command takes.\n"
+                               "Usage: maintenance time on|off\n"
+                               "\n"
+                               "When on, the wall clock time, the CPU time "
+                               "and the time spent waiting\n"
+                               "on the backend (wall minus CPU) are printed "
+                               "after each command."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+  c = bosh_command_list_add (&maintenancelist, "space", class_maintenance,
+                             bosh_maintenance_space_command,
+                             _("Print how much memory each command "
+                               "allocates.\n"
+                               "Usage: maintenance space on|off\n"
+                               "\n"
+                               "When on, the number of glib allocations and "
+                               "the bytes they asked for\n"
+                               "are printed after each command."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+  c = bosh_command_list_add (&maintenancelist, "stats", class_maintenance,
+                             bosh_maintenance_stats_command,
+                             _("Show timing statistics for each command.\n"
+                               "Usage: maintenance stats [reset]\n"
+                               "\n"
+                               "For every command run so far this shows the "
+                               "median (p50) and 99th\n"
+                               "percentile (p99) of its wall clock, CPU and "
+                               "backend wait times, and the\n"
+                               "average glib allocations and bytes per call.\n"
+                               "With \"reset\" the statistics are cleared."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+}
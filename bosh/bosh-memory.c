@@ -0,0 +1,754 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Examining target memory.
+ *
+ * The backend doesn't give us a way to read memory, so it comes
+ * either from the current core file or, for a local process, directly
+ * from /proc/PID/mem. */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gswat/gswat.h>
+
+#include "cli-decode.h"
+
+#include "bosh-commands.h"
+#include "bosh-core.h"
+#include "bosh-main.h"
+#include "bosh-memory.h"
+#include "bosh-output.h"
+#include "bosh-procmem.h"
+
+/* The x command reads this much at a time */
+#define MEMORY_READ_CHUNK (64 * 1024)
+
+/* Where the next x without an address continues from */
+static guint64 next_address = 0;
+static char last_format = 'x';
+static int last_size = 4;
+
+gboolean
+bosh_memory_read (guint64 address,
+                  void *buf,
+                  gsize len,
+                  GError **error)
+{
+  BoshCore *core = bosh_core_get_current ();
+  int pid;
+
+  if (core)
+    {
+      if (bosh_core_read_memory (core, address, buf, len) == len)
+        return TRUE;
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAULT,
+                   _("Cannot access memory at address "
+                     "0x%" G_GINT64_MODIFIER "x"), address);
+      return FALSE;
+    }
+
+  pid = bosh_get_target_pid ();
+  if (pid != -1)
+    return bosh_procmem_read (pid, address, buf, len, error);
+
+  g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOSYS,
+               _("Memory can only be examined in a core file or "
+                 "a local process"));
+  return FALSE;
+}
+
+static void
+print_unit (const guint8 *data, int size, char format)
+{
+  guint64 value = 0;
+  gint64 svalue;
+
+  switch (size)
+    {
+    case 1: value = *data; break;
+    case 2: value = *(const guint16 *)data; break;
+    case 4: value = *(const guint32 *)data; break;
+    case 8: value = *(const guint64 *)data; break;
+    }
+
+  /* Sign extend from the unit size */
+  svalue = (gint64)(value << (64 - size * 8)) >> (64 - size * 8);
+
+  switch (format)
+    {
+    case 'd':
+      bosh_output_field_fmt (NULL, "%" G_GINT64_FORMAT, svalue);
+      break;
+    case 'u':
+      bosh_output_field_fmt (NULL, "%" G_GUINT64_FORMAT, value);
+      break;
+    case 'o':
+      bosh_output_field_fmt (NULL, "0%" G_GINT64_MODIFIER "o", value);
+      break;
+    case 'c':
+      if (g_ascii_isprint (value))
+        bosh_output_field_fmt (NULL, "%d '%c'", (int)svalue, (int)value);
+      else
+        bosh_output_field_fmt (NULL, "%d '\\%03o'",
+                               (int)svalue, (int)(value & 0xff));
+      break;
+    default:
+      bosh_output_field_fmt (NULL, "0x%0*" G_GINT64_MODIFIER "x",
+                             size * 2, value);
+      break;
+    }
+}
+
+/* x/NFU ADDRESS */
+static void
+bosh_x_command (char *args, int from_tty)
+{
+  guint64 count = 1;
+  char format = last_format;
+  int size = last_size;
+  guint64 address = next_address;
+  int per_line;
+  guint64 done = 0;
+  guint8 *buf;
+
+  if (args && *args == '/')
+    {
+      char *end;
+
+      args++;
+      if (g_ascii_isdigit (*args))
+        {
+          count = strtoul (args, &end, 10);
+          args = end;
+        }
+      for (; *args && !g_ascii_isspace (*args); args++)
+        {
+          switch (*args)
+            {
+            case 'b': size = 1; break;
+            case 'h': size = 2; break;
+            case 'w': size = 4; break;
+            case 'g': size = 8; break;
+            case 'x':
+            case 'd':
+            case 'u':
+            case 'o':
+              format = *args;
+              break;
+            case 'c':
+              format = 'c';
+              size = 1;
+              break;
+            default:
+              g_print (_("Undefined output format \"%c\".\n"), *args);
+              return;
+            }
+        }
+    }
+
+  if (args)
+    {
+      char *end;
+
+      while (g_ascii_isspace (*args))
+        args++;
+      if (*args)
+        {
+          address = g_ascii_strtoull (args, &end, 0);
+          if (end == args)
+            {
+              g_print (_("Invalid address \"%s\".\n"), args);
+              return;
+            }
+        }
+    }
+
+  last_format = format;
+  last_size = size;
+
+  per_line = format == 'c' || size == 1 ? 8 : (size == 8 ? 2 : 16 / size);
+  buf = g_malloc (MIN (count * size, MEMORY_READ_CHUNK));
+
+  /* A record for each line, with the address and a list of the
+   * values on it */
+  bosh_output_begin_list ("memory");
+  while (done < count)
+    {
+      GError *error = NULL;
+      guint64 units = MIN (count - done, MEMORY_READ_CHUNK / size);
+      guint64 i;
+
+      if (!bosh_memory_read (address, buf, units * size, &error))
+        {
+          if (done % per_line != 0)
+            {
+              bosh_output_end_list ();
+              bosh_output_end_record ();
+              bosh_output_text ("\n");
+            }
+          g_print ("%s\n", error->message);
+          g_error_free (error);
+          break;
+        }
+
+      for (i = 0; i < units; i++, done++)
+        {
+          if (done % per_line == 0)
+            {
+              bosh_output_begin_record ("memory");
+              bosh_output_field_fmt ("address", "0x%" G_GINT64_MODIFIER "x",
+                                     address + i * size);
+              bosh_output_text (":");
+              bosh_output_begin_list ("values");
+            }
+          bosh_output_text ("\t");
+          print_unit (buf + i * size, size, format);
+          if (done % per_line == per_line - 1 || done == count - 1)
+            {
+              bosh_output_end_list ();
+              bosh_output_end_record ();
+              bosh_output_text ("\n");
+            }
+        }
+      address += units * size;
+    }
+  bosh_output_end_list ();
+
+  next_address = address;
+  g_free (buf);
+}
+
+/* find
+ *
+ * The regions to search are cut into units that are shared out between
+ * a few threads.  Each unit is read a block at a time, with every read
+ * running pattern_len - 1 bytes into the next block so that matches
+ * spanning a block (or unit) boundary are still seen, and blocks are
+ * scanned with memchr, which glibc vectorises, for the most
+ * distinctive byte of the pattern before anything is compared. */
+
+#define FIND_UNIT_SIZE (64 * 1024 * 1024)
+#define FIND_BLOCK_SIZE (4 * 1024 * 1024)
+#define FIND_MAX_THREADS 8
+
+typedef struct _FindUnit
+{
+  guint64 start;
+  guint64 end;
+  /* The end of the region the unit is in; matches can run past END
+   * up to here */
+  guint64 limit;
+  GArray *matches;
+  char *error;
+} FindUnit;
+
+typedef struct _FindSearch
+{
+  const guint8 *pattern;
+  gsize pattern_len;
+  /* The pattern byte memchr looks for */
+  gsize anchor;
+  guint max_matches;
+
+  GArray *units;
+  GMutex *lock;
+  guint next_unit;
+} FindSearch;
+
+/* Pick a byte of the pattern that isn't 0x00 or 0xff, if there is one,
+ * since those are far too common in memory to be a useful filter */
+static gsize
+find_choose_anchor (const guint8 *pattern, gsize len)
+{
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    if (pattern[i] != 0x00 && pattern[i] != 0xff)
+      return i;
+  return 0;
+}
+
+/* Look for matches that start in the first SCAN_LEN bytes of the LEN
+ * bytes at BUF, which were read from ADDRESS */
+static gboolean
+find_in_block (FindSearch *search,
+               FindUnit *unit,
+               const guint8 *buf,
+               gsize len,
+               gsize scan_len,
+               guint64 address)
+{
+  const guint8 *pattern = search->pattern;
+  gsize pattern_len = search->pattern_len;
+  gsize anchor = search->anchor;
+  const guint8 *p;
+  const guint8 *end;
+
+  if (len < pattern_len)
+    return TRUE;
+
+  p = buf + anchor;
+  end = buf + MIN (scan_len, len - pattern_len + 1) + anchor;
+  while (p < end)
+    {
+      const guint8 *hit = memchr (p, pattern[anchor], end - p);
+      const guint8 *start;
+
+      if (!hit)
+        break;
+
+      start = hit - anchor;
+      if (memcmp (start, pattern, pattern_len) == 0)
+        {
+          guint64 match = address + (start - buf);
+          g_array_append_val (unit->matches, match);
+          if (search->max_matches
+              && unit->matches->len >= search->max_matches)
+            return FALSE;
+        }
+      p = hit + 1;
+    }
+
+  return TRUE;
+}
+
+static gpointer
+find_thread (gpointer data)
+{
+  FindSearch *search = data;
+  guint8 *buf = g_malloc (FIND_BLOCK_SIZE + search->pattern_len - 1);
+
+  while (TRUE)
+    {
+      FindUnit *unit;
+      guint64 address;
+
+      g_mutex_lock (search->lock);
+      if (search->next_unit >= search->units->len)
+        {
+          g_mutex_unlock (search->lock);
+          break;
+        }
+      unit = &g_array_index (search->units, FindUnit, search->next_unit++);
+      g_mutex_unlock (search->lock);
+
+      for (address = unit->start; address < unit->end; )
+        {
+          gsize scan_len = MIN (FIND_BLOCK_SIZE, unit->end - address);
+          gsize len = MIN (scan_len + search->pattern_len - 1,
+                           unit->limit - address);
+          GError *error = NULL;
+
+          if (!bosh_memory_read (address, buf, len, &error))
+            {
+              unit->error = g_strdup (error->message);
+              g_error_free (error);
+              break;
+            }
+          if (!find_in_block (search, unit, buf, len, scan_len, address))
+            break;
+          address += scan_len;
+        }
+    }
+
+  g_free (buf);
+  return NULL;
+}
+
+static void
+find_add_region (GArray *units, guint64 start, guint64 end)
+{
+  guint64 unit_start;
+
+  for (unit_start = start; unit_start < end; unit_start += FIND_UNIT_SIZE)
+    {
+      FindUnit unit;
+
+      unit.start = unit_start;
+      unit.end = MIN (end, unit_start + FIND_UNIT_SIZE);
+      unit.limit = end;
+      unit.matches = g_array_new (FALSE, FALSE, sizeof (guint64));
+      unit.error = NULL;
+      g_array_append_val (units, unit);
+    }
+}
+
+/* Split ARGS at commas that aren't inside quotes */
+static char **
+find_split_args (const char *args)
+{
+  GPtrArray *tokens = g_ptr_array_new ();
+  const char *start = args;
+  const char *p;
+  char quote = 0;
+
+  for (p = args; ; p++)
+    {
+      if (quote)
+        {
+          if (*p == '\\' && p[1])
+            p++;
+          else if (*p == quote)
+            quote = 0;
+          else if (*p == '\0')
+            break;
+          continue;
+        }
+      if (*p == '"' || *p == '\'')
+        quote = *p;
+      else if (*p == ',' || *p == '\0')
+        {
+          g_ptr_array_add (tokens, g_strstrip (g_strndup (start, p - start)));
+          if (*p == '\0')
+            break;
+          start = p + 1;
+        }
+    }
+  if (quote)
+    g_ptr_array_add (tokens, g_strstrip (g_strdup (start)));
+
+  g_ptr_array_add (tokens, NULL);
+  return (char **)g_ptr_array_free (tokens, FALSE);
+}
+
+/* Append the bytes of VALUE, as SIZE bytes in host order, to PATTERN */
+static void
+find_append_value (GByteArray *pattern, guint64 value, int size)
+{
+  guint8 bytes[8];
+  int i;
+
+  for (i = 0; i < size; i++)
+    {
+      int shift = G_BYTE_ORDER == G_LITTLE_ENDIAN ? i : size - 1 - i;
+      bytes[i] = (value >> (shift * 8)) & 0xff;
+    }
+  g_byte_array_append (pattern, bytes, size);
+}
+
+static gboolean
+find_parse_value (GByteArray *pattern, const char *token, int size)
+{
+  gsize len = strlen (token);
+  char *end;
+  guint64 value;
+
+  if (len >= 2 && (token[0] == '"' || token[0] == '\'')
+      && token[len - 1] == token[0])
+    {
+      char *inner = g_strndup (token + 1, len - 2);
+      char *bytes = g_strcompress (inner);
+      g_byte_array_append (pattern, (guint8 *)bytes, strlen (bytes));
+      g_free (bytes);
+      g_free (inner);
+      return TRUE;
+    }
+
+  if (token[0] == '-')
+    value = g_ascii_strtoll (token, &end, 0);
+  else
+    value = g_ascii_strtoull (token, &end, 0);
+  if (end == token || *end != '\0')
+    return FALSE;
+
+  /* Without a size, anything that doesn't fit an int is a pointer */
+  if (!size)
+    size = ((gint64)value == (gint32)value || value <= G_MAXUINT32) ? 4 : 8;
+  find_append_value (pattern, value, size);
+  return TRUE;
+}
+
+/* find [/SIZE-CHAR] [/MAX-COUNT] START, END|+LEN, VAL...
+ * find --all-mappings [/SIZE-CHAR] [/MAX-COUNT] VAL... */
+static void
+bosh_find_command (char *args, int from_tty)
+{
+  FindSearch search;
+  GByteArray *pattern;
+  GArray *units;
+  GThread *threads[FIND_MAX_THREADS];
+  GTimer *timer;
+  char **tokens;
+  char **values;
+  gboolean all_mappings = FALSE;
+  guint64 searched = 0;
+  guint max_matches = 0;
+  guint n_found = 0;
+  int size = 0;
+  int n_threads;
+  guint i;
+
+  if (!args)
+    {
+      bosh_command_error_no_argument (_("search parameters"));
+      return;
+    }
+
+  args = g_strchug (args);
+  if (g_str_has_prefix (args, "--all-mappings"))
+    {
+      all_mappings = TRUE;
+      args = g_strchug (args + strlen ("--all-mappings"));
+    }
+  while (*args == '/')
+    {
+      for (args++; *args && !g_ascii_isspace (*args); args++)
+        {
+          switch (*args)
+            {
+            case 'b': size = 1; break;
+            case 'h': size = 2; break;
+            case 'w': size = 4; break;
+            case 'g': size = 8; break;
+            default:
+              if (g_ascii_isdigit (*args))
+                {
+                  max_matches = strtoul (args, &args, 10);
+                  args--;
+                }
+              else
+                {
+                  g_print (_("Invalid size granularity.\n"));
+                  return;
+                }
+            }
+        }
+      args = g_strchug (args);
+    }
+
+  tokens = find_split_args (args);
+  units = g_array_new (FALSE, FALSE, sizeof (FindUnit));
+
+  if (all_mappings)
+    {
+      BoshCore *core = bosh_core_get_current ();
+      int pid = bosh_get_target_pid ();
+
+      values = tokens;
+      if (core)
+        {
+          for (i = 0; i < core->segments->len; i++)
+            {
+              BoshCoreSegment *segment =
+                &g_array_index (core->segments, BoshCoreSegment, i);
+              find_add_region (units, segment->vaddr,
+                               segment->vaddr + segment->memsz);
+            }
+        }
+      else if (pid != -1)
+        {
+          GError *error = NULL;
+          GArray *mappings = bosh_procmem_get_mappings (pid, &error);
+
+          if (!mappings)
+            {
+              g_print ("%s\n", error->message);
+              g_error_free (error);
+              goto out;
+            }
+          for (i = 0; i < mappings->len; i++)
+            {
+              BoshProcessImageRegion *mapping =
+                &g_array_index (mappings, BoshProcessImageRegion, i);
+              find_add_region (units, mapping->start, mapping->end);
+            }
+          bosh_procmem_free_mappings (mappings);
+        }
+      else
+        {
+          g_print (_("Memory can only be searched in a core file or "
+                     "a local process.\n"));
+          goto out;
+        }
+    }
+  else
+    {
+      guint64 start;
+      guint64 end;
+      char *endp;
+
+      if (g_strv_length (tokens) < 3)
+        {
+          bosh_command_error_no_argument (_("START, END|+LEN, VAL..."));
+          goto out;
+        }
+      start = g_ascii_strtoull (tokens[0], &endp, 0);
+      if (endp == tokens[0] || *endp)
+        {
+          g_print (_("Invalid start address \"%s\".\n"), tokens[0]);
+          goto out;
+        }
+      if (tokens[1][0] == '+')
+        end = start + g_ascii_strtoull (tokens[1] + 1, &endp, 0);
+      else
+        end = g_ascii_strtoull (tokens[1], &endp, 0);
+      if (endp == tokens[1] || *endp || end <= start)
+        {
+          g_print (_("Invalid search range \"%s\".\n"), tokens[1]);
+          goto out;
+        }
+      find_add_region (units, start, end);
+      values = tokens + 2;
+    }
+
+  pattern = g_byte_array_new ();
+  for (; *values; values++)
+    if (!find_parse_value (pattern, *values, size))
+      {
+        g_print (_("Invalid search value \"%s\".\n"), *values);
+        g_byte_array_free (pattern, TRUE);
+        goto out;
+      }
+  if (pattern->len == 0)
+    {
+      bosh_command_error_no_argument (_("search pattern"));
+      g_byte_array_free (pattern, TRUE);
+      goto out;
+    }
+
+  search.pattern = pattern->data;
+  search.pattern_len = pattern->len;
+  search.anchor = find_choose_anchor (pattern->data, pattern->len);
+  search.max_matches = max_matches;
+  search.units = units;
+  search.lock = g_mutex_new ();
+  search.next_unit = 0;
+
+  timer = g_timer_new ();
+  n_threads = CLAMP (sysconf (_SC_NPROCESSORS_ONLN), 1, FIND_MAX_THREADS);
+  n_threads = MIN (n_threads, MAX (units->len, 1));
+  for (i = 0; i < n_threads; i++)
+    threads[i] = g_thread_create (find_thread, &search, TRUE, NULL);
+  for (i = 0; i < n_threads; i++)
+    g_thread_join (threads[i]);
+  g_mutex_free (search.lock);
+
+  /* Units are in address order, so the matches already are too */
+  bosh_output_begin_list ("matches");
+  for (i = 0; i < units->len; i++)
+    {
+      FindUnit *unit = &g_array_index (units, FindUnit, i);
+      guint j;
+
+      for (j = 0; j < unit->matches->len; j++)
+        {
+          if (max_matches && n_found >= max_matches)
+            break;
+          bosh_output_begin_record ("match");
+          bosh_output_field_fmt ("address", "0x%" G_GINT64_MODIFIER "x",
+                                 g_array_index (unit->matches, guint64, j));
+          bosh_output_text ("\n");
+          bosh_output_end_record ();
+          n_found++;
+        }
+      searched += unit->end - unit->start;
+    }
+  bosh_output_end_list ();
+
+  /* The ranges that couldn't be read, kept out of the list of matches
+   * so that it keeps the one set of columns */
+  for (i = 0; i < units->len; i++)
+    {
+      FindUnit *unit = &g_array_index (units, FindUnit, i);
+
+      if (!unit->error)
+        continue;
+      bosh_output_begin_record ("skipped");
+      bosh_output_text (_("warning: "));
+      bosh_output_field_string ("error", unit->error);
+      bosh_output_text (_(", skipping the rest of "));
+      bosh_output_field_fmt ("start", "0x%" G_GINT64_MODIFIER "x",
+                             unit->start);
+      bosh_output_text ("-");
+      bosh_output_field_fmt ("end", "0x%" G_GINT64_MODIFIER "x", unit->end);
+      bosh_output_text ("\n");
+      bosh_output_end_record ();
+    }
+
+  if (n_found)
+    bosh_output_text (_("%u pattern%s found.\n"),
+                      n_found, n_found == 1 ? "" : "s");
+  else
+    bosh_output_text (_("Pattern not found.\n"));
+  bosh_output_text (_("Searched %" G_GUINT64_FORMAT " MiB in %.1f ms.\n"),
+                    searched >> 20, g_timer_elapsed (timer, NULL) * 1000);
+
+  g_timer_destroy (timer);
+  g_byte_array_free (pattern, TRUE);
+
+out:
+  for (i = 0; i < units->len; i++)
+    {
+      FindUnit *unit = &g_array_index (units, FindUnit, i);
+      g_array_free (unit->matches, TRUE);
+      g_free (unit->error);
+    }
+  g_array_free (units, TRUE);
+  g_strfreev (tokens);
+}
+
+void
+bosh_memory_init_commands (void)
+{
+  bosh_add_command ("x", class_vars, bosh_x_command,
+                    _("Examine memory: x/FMT ADDRESS.\n"
+                      "ADDRESS is the address of the memory to examine.\n"
+                      "FMT is a repeat count followed by a format letter "
+                      "and a size letter.\n"
+                      "Format letters are o(octal), x(hex), d(decimal), "
+                      "u(unsigned decimal) and c(char).\n"
+                      "Size letters are b(byte), h(halfword), w(word), "
+                      "g(giant, 8 bytes).\n"
+                      "The specified number of objects of the specified "
+                      "size are printed\n"
+                      "according to the format.\n\n"
+                      "Defaults for format and size letters are those "
+                      "previously used.\n"
+                      "Default count is 1.  Default address is following "
+                      "last thing printed.\n\n"
+                      "Memory is read from the current core file or, for a "
+                      "local process,\n"
+                      "directly from /proc/PID/mem."));
+
+  bosh_add_command ("find", class_vars, bosh_find_command,
+                    _("Search memory for a sequence of bytes.\n"
+                      "Usage:\n"
+                      "find [/SIZE-CHAR] [/MAX-COUNT] START-ADDRESS, "
+                      "END-ADDRESS, EXPR1 [, EXPR2 ...]\n"
+                      "find [/SIZE-CHAR] [/MAX-COUNT] START-ADDRESS, "
+                      "+LENGTH, EXPR1 [, EXPR2 ...]\n"
+                      "find --all-mappings [/SIZE-CHAR] [/MAX-COUNT] "
+                      "EXPR1 [, EXPR2 ...]\n"
+                      "SIZE-CHAR is one of b,h,w,g for 8,16,32,64 bit "
+                      "values respectively,\n"
+                      "and if not specified numbers are 32 bits unless "
+                      "they need 64.\n"
+                      "Strings are given in double quotes and are not "
+                      "NUL terminated.\n"
+                      "MAX-COUNT is the maximum number of matches to "
+                      "print; the default is all.\n"
+                      "With --all-mappings every readable mapping of "
+                      "the process, or every\n"
+                      "segment of the core file, is searched."));
+}
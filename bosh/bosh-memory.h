@@ -0,0 +1,35 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_MEMORY_H
+#define BOSH_MEMORY_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gboolean bosh_memory_read (guint64 address,
+                           void *buf,
+                           gsize len,
+                           GError **error);
+
+void bosh_memory_init_commands (void);
+
+G_END_DECLS
+
+#endif /* BOSH_MEMORY_H */
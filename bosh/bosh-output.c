@@ -0,0 +1,438 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* A structured emitter for command output, so that scripts don't have
+ * to parse text meant for people.
+ *
+ * Commands describe what they print as records made of named fields,
+ * and lists of records, with bosh_output_text() for the decoration
+ * around them.  "set output-format" then picks how that's rendered:
+ *
+ *   text  the usual human output; fields are printed in place and the
+ *         decoration is kept
+ *   json  one JSON object per line for each outermost record, with a
+ *         "type" member, and nested lists as arrays
+ *   tsv   one line per outermost record, with a header line naming
+ *         the columns before the first record of each list
+ *
+ * Each outermost record is printed as soon as it's complete, so a
+ * consumer can start on a long backtrace before it's finished. */
+
+#include <config.h>
+
+#include <stdarg.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "cli-decode.h"
+#include "cli-utils.h"
+
+#include "bosh-commands.h"
+#include "bosh-output.h"
+
+typedef enum {
+  OUTPUT_LIST,
+  OUTPUT_RECORD
+} OutputLevelKind;
+
+typedef struct _OutputLevel
+{
+  OutputLevelKind kind;
+  /* Items (fields or records) emitted so far at this level */
+  int n_items;
+  /* For TSV, the column names of an outermost list's records */
+  gboolean header_done;
+} OutputLevel;
+
+static const char output_text[] = "text";
+static const char output_json[] = "json";
+static const char output_tsv[] = "tsv";
+static const char *output_format_enums[] = {
+  output_text,
+  output_json,
+  output_tsv,
+  NULL
+};
+static const char *output_format = output_text;
+
+static GQueue output_levels = G_QUEUE_INIT;
+/* The outermost record being built, and for TSV its column names */
+static GString *output_line;
+static GString *output_header;
+static gboolean output_header_done;
+
+BoshOutputFormat
+bosh_output_get_format (void)
+{
+  if (output_format == output_json)
+    return BOSH_OUTPUT_JSON;
+  else if (output_format == output_tsv)
+    return BOSH_OUTPUT_TSV;
+  return BOSH_OUTPUT_TEXT;
+}
+
+void
+bosh_output_append_json_string (GString *string, const char *str)
+{
+  const char *p;
+
+  if (!str)
+    {
+      g_string_append (string, "null");
+      return;
+    }
+
+  g_string_append_c (string, '"');
+  for (p = str; *p; p++)
+    {
+      switch (*p)
+        {
+        case '"':
+          g_string_append (string, "\\\"");
+          break;
+        case '\\':
+          g_string_append (string, "\\\\");
+          break;
+        case '\n':
+          g_string_append (string, "\\n");
+          break;
+        case '\t':
+          g_string_append (string, "\\t");
+          break;
+        default:
+          if ((guchar)*p < 0x20)
+            g_string_append_printf (string, "\\u%04x", (guchar)*p);
+          else
+            g_string_append_c (string, *p);
+        }
+    }
+  g_string_append_c (string, '"');
+}
+
+static void
+append_tsv_string (GString *string, const char *str)
+{
+  const char *p;
+
+  for (p = str; p && *p; p++)
+    {
+      switch (*p)
+        {
+        case '\t':
+          g_string_append (string, "\\t");
+          break;
+        case '\n':
+          g_string_append (string, "\\n");
+          break;
+        case '\\':
+          g_string_append (string, "\\\\");
+          break;
+        default:
+          g_string_append_c (string, *p);
+        }
+    }
+}
+
+static OutputLevel *
+push_level (OutputLevelKind kind)
+{
+  OutputLevel *level = g_new0 (OutputLevel, 1);
+
+  level->kind = kind;
+  g_queue_push_head (&output_levels, level);
+  return level;
+}
+
+static OutputLevel *
+current_level (void)
+{
+  return g_queue_peek_head (&output_levels);
+}
+
+/* How many records enclose the current position */
+static int
+record_depth (void)
+{
+  GList *l;
+  int depth = 0;
+
+  for (l = output_levels.head; l; l = l->next)
+    if (((OutputLevel *)l->data)->kind == OUTPUT_RECORD)
+      depth++;
+  return depth;
+}
+
+/* Starts a new item (a field or a nested record) in the current
+ * level, adding whatever separator the format needs. */
+static void
+begin_item (const char *name)
+{
+  OutputLevel *level = current_level ();
+  gboolean first = !level || level->n_items == 0;
+
+  if (level)
+    level->n_items++;
+
+  if (!output_line)
+    return;
+
+  if (output_format == output_json)
+    {
+      if (!first || (level && level->kind == OUTPUT_RECORD
+                     && record_depth () == 1))
+        g_string_append_c (output_line, ',');
+      if (name && level && level->kind == OUTPUT_RECORD)
+        {
+          bosh_output_append_json_string (output_line, name);
+          g_string_append_c (output_line, ':');
+        }
+    }
+  else if (output_format == output_tsv)
+    {
+      if (!first)
+        g_string_append_c (output_line,
+                           level->kind == OUTPUT_LIST ? ','
+                           : (record_depth () == 1 ? '\t' : '='));
+      if (record_depth () == 1 && level->kind == OUTPUT_RECORD)
+        {
+          if (output_header->len)
+            g_string_append_c (output_header, '\t');
+          append_tsv_string (output_header, name);
+        }
+    }
+}
+
+void
+bosh_output_begin_list (const char *name)
+{
+  if (output_line)
+    {
+      begin_item (name);
+      if (output_format == output_json)
+        g_string_append_c (output_line, '[');
+    }
+  push_level (OUTPUT_LIST);
+}
+
+void
+bosh_output_end_list (void)
+{
+  OutputLevel *level = g_queue_pop_head (&output_levels);
+
+  g_return_if_fail (level && level->kind == OUTPUT_LIST);
+
+  if (output_line && output_format == output_json)
+    g_string_append_c (output_line, ']');
+
+  /* The next outermost list gets its own TSV header */
+  if (!output_line)
+    output_header_done = FALSE;
+
+  g_free (level);
+}
+
+void
+bosh_output_begin_record (const char *type)
+{
+  if (!output_line)
+    {
+      /* An outermost record */
+      if (current_level ())
+        current_level ()->n_items++;
+      push_level (OUTPUT_RECORD);
+
+      if (output_format == output_text)
+        return;
+
+      output_line = g_string_new (NULL);
+      output_header = g_string_new (NULL);
+      if (output_format == output_json)
+        {
+          g_string_append (output_line, "{\"type\":");
+          bosh_output_append_json_string (output_line, type);
+        }
+      return;
+    }
+
+  begin_item (NULL);
+  if (output_format == output_json)
+    g_string_append_c (output_line, '{');
+  push_level (OUTPUT_RECORD);
+}
+
+void
+bosh_output_end_record (void)
+{
+  OutputLevel *level = g_queue_pop_head (&output_levels);
+
+  g_return_if_fail (level && level->kind == OUTPUT_RECORD);
+  g_free (level);
+
+  if (!output_line)
+    return;
+
+  if (output_format == output_json)
+    g_string_append_c (output_line, '}');
+
+  if (record_depth () > 0)
+    return;
+
+  /* The outermost record is complete so send it on its way */
+  if (output_format == output_tsv && !output_header_done)
+    {
+      g_print ("%s\n", output_header->str);
+      output_header_done = current_level () != NULL;
+    }
+  g_print ("%s\n", output_line->str);
+
+  g_string_free (output_line, TRUE);
+  g_string_free (output_header, TRUE);
+  output_line = NULL;
+  output_header = NULL;
+}
+
+void
+bosh_output_field_string (const char *name, const char *value)
+{
+  if (!output_line)
+    {
+      if (current_level ())
+        current_level ()->n_items++;
+      if (value)
+        fputs_filtered (value, NULL);
+      return;
+    }
+
+  begin_item (name);
+  if (output_format == output_json)
+    bosh_output_append_json_string (output_line, value);
+  else
+    append_tsv_string (output_line, value);
+}
+
+void
+bosh_output_field_int (const char *name, gint64 value)
+{
+  if (!output_line)
+    {
+      if (current_level ())
+        current_level ()->n_items++;
+      printf_filtered ("%" G_GINT64_FORMAT, value);
+      return;
+    }
+
+  begin_item (name);
+  g_string_append_printf (output_line, "%" G_GINT64_FORMAT, value);
+}
+
+/* A field formatted for people, e.g. with padding or in hex.  The
+ * structured formats get it without the padding, and JSON gets plain
+ * decimal numbers as numbers. */
+void
+bosh_output_field_fmt (const char *name, const char *format, ...)
+{
+  va_list args;
+  char *value;
+  char *end;
+  gint64 number;
+
+  va_start (args, format);
+  value = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  if (output_line)
+    {
+      g_strstrip (value);
+      number = g_ascii_strtoll (value, &end, 10);
+      if (output_format == output_json && end != value && *end == '\0')
+        {
+          bosh_output_field_int (name, number);
+          g_free (value);
+          return;
+        }
+    }
+  bosh_output_field_string (name, value);
+  g_free (value);
+}
+
+/* Text that is only printed in the text format */
+void
+bosh_output_text (const char *format, ...)
+{
+  va_list args;
+  char *text;
+
+  if (output_format != output_text)
+    return;
+
+  va_start (args, format);
+  text = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  fputs_filtered (text, NULL);
+  g_free (text);
+}
+
+/* Forget any lists and records still open, dropping a record that was
+ * never finished */
+void
+bosh_output_reset (void)
+{
+  OutputLevel *level;
+
+  while ((level = g_queue_pop_head (&output_levels)))
+    g_free (level);
+
+  if (output_line)
+    {
+      g_string_free (output_line, TRUE);
+      g_string_free (output_header, TRUE);
+      output_line = NULL;
+      output_header = NULL;
+    }
+  output_header_done = FALSE;
+}
+
+static void
+show_output_format (GIOChannel *file, int from_tty,
+                    struct cmd_list_element *c, const char *value)
+{
+  g_print (_("The output format is \"%s\".\n"), value);
+}
+
+void
+bosh_output_init_commands (void)
+{
+  add_setshow_enum_cmd ("output-format", class_support, output_format_enums,
+                        &output_format,
+                        _("Set how command output is formatted."),
+                        _("Show how command output is formatted."),
+                        _("\"text\" is meant for people.  \"json\" prints "
+                          "a JSON object per line for\n"
+                          "each record (a frame, a source line...) and "
+                          "\"tsv\" prints tab separated\n"
+                          "columns under a header line.  Records are "
+                          "printed as they are produced.\n"
+                          "Commands that have nothing structured to say "
+                          "still print text."),
+                        NULL,
+                        show_output_format,
+                        &setlist, &showlist);
+}
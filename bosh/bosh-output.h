@@ -0,0 +1,53 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_OUTPUT_H
+#define BOSH_OUTPUT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  BOSH_OUTPUT_TEXT,
+  BOSH_OUTPUT_JSON,
+  BOSH_OUTPUT_TSV
+} BoshOutputFormat;
+
+BoshOutputFormat bosh_output_get_format (void);
+
+void bosh_output_begin_list (const char *name);
+void bosh_output_end_list (void);
+void bosh_output_begin_record (const char *type);
+void bosh_output_end_record (void);
+
+void bosh_output_field_string (const char *name, const char *value);
+void bosh_output_field_int (const char *name, gint64 value);
+void bosh_output_field_fmt (const char *name, const char *format, ...)
+  G_GNUC_PRINTF (2, 3);
+void bosh_output_text (const char *format, ...) G_GNUC_PRINTF (1, 2);
+
+void bosh_output_append_json_string (GString *string, const char *str);
+
+void bosh_output_reset (void);
+
+void bosh_output_init_commands (void);
+
+G_END_DECLS
+
+#endif /* BOSH_OUTPUT_H */
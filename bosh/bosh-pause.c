@@ -0,0 +1,140 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Keeps track of how long the target spends stopped.
+ *
+ * gswat drives gdb in all-stop mode, so whenever one thread stops for
+ * a breakpoint or signal every other thread in the process is stopped
+ * with it until we resume.  For services that can't afford to be
+ * paused this is the number that matters, so "info pauses" shows how
+ * long each stop kept the process from running. */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include <gswat/gswat.h>
+
+#include "cli-decode.h"
+
+#include "bosh-commands.h"
+#include "bosh-output.h"
+#include "bosh-pause.h"
+
+static GTimer *pause_timer;
+static gboolean paused;
+static guint pause_count;
+static gdouble pause_total;
+static gdouble pause_max;
+static gdouble pause_last;
+
+/* Called for every state change of the debuggable, including the
+ * intermediate stops of counted stepping. */
+void
+bosh_pause_state_changed (GSwatDebuggable *debuggable)
+{
+  GSwatDebuggableState state = gswat_debuggable_get_state (debuggable);
+
+  if (!pause_timer)
+    pause_timer = g_timer_new ();
+
+  if (state == GSWAT_DEBUGGABLE_INTERRUPTED)
+    {
+      if (!paused)
+        {
+          g_timer_start (pause_timer);
+          paused = TRUE;
+        }
+      return;
+    }
+
+  /* Running again, or gone */
+  if (paused)
+    {
+      pause_last = g_timer_elapsed (pause_timer, NULL);
+      pause_total += pause_last;
+      if (pause_last > pause_max)
+        pause_max = pause_last;
+      pause_count++;
+      paused = FALSE;
+    }
+}
+
+static void
+bosh_info_pauses_command (char *args, int from_tty)
+{
+  if (args && strcmp (args, "reset") == 0)
+    {
+      pause_count = 0;
+      pause_total = pause_max = pause_last = 0;
+      g_print (_("Pause statistics reset.\n"));
+      return;
+    }
+
+  bosh_output_begin_record ("pauses");
+  if (pause_count == 0)
+    {
+      bosh_output_text (_("The program hasn't been paused and resumed "
+                          "yet.\n"));
+      if (bosh_output_get_format () != BOSH_OUTPUT_TEXT)
+        bosh_output_field_int ("count", 0);
+    }
+  else
+    {
+      bosh_output_text (_("Paused "));
+      bosh_output_field_int ("count", pause_count);
+      bosh_output_text (_(" times for "));
+      bosh_output_field_fmt ("total", "%.6f", pause_total);
+      bosh_output_text (_(" seconds in total.\nMean pause "));
+      bosh_output_field_fmt ("mean", "%.6f", pause_total / pause_count);
+      bosh_output_text (_(" seconds, longest "));
+      bosh_output_field_fmt ("longest", "%.6f", pause_max);
+      bosh_output_text (_(" seconds, last "));
+      bosh_output_field_fmt ("last", "%.6f", pause_last);
+      bosh_output_text (_(" seconds.\n"));
+    }
+
+  if (paused)
+    {
+      bosh_output_text (_("Paused now for "));
+      bosh_output_field_fmt ("paused", "%.6f",
+                             g_timer_elapsed (pause_timer, NULL));
+      bosh_output_text (_(" seconds.\n"));
+    }
+  bosh_output_end_record ();
+}
+
+void
+bosh_pause_init_commands (void)
+{
+  struct cmd_list_element *c;
+
+  c = bosh_add_info_command ("pauses", bosh_info_pauses_command,
+                             _("How long the program has been kept stopped.\n"
+                               "Usage: info pauses [reset]\n"
+                               "\n"
+                               "Every thread is stopped while bosh has "
+                               "control, so this is how long\n"
+                               "the whole process stayed paused for each "
+                               "stop, from the stop until it\n"
+                               "was resumed."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+}
@@ -0,0 +1,227 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* "pipe COMMAND | SHELL_COMMAND" runs a bosh command with its output
+ * going to the standard input of a shell command.
+ *
+ * While the bosh command runs our stdout is pointed at a pipe to the
+ * shell command, so output streams to it as it's printed and goes
+ * through any logging on the way just like it would to the terminal.
+ * If the shell command exits before reading everything (e.g. "head")
+ * the bosh command's output is cancelled so it can stop early. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "cli-decode.h"
+#include "cli-utils.h"
+
+#include "bosh-commands.h"
+#include "bosh-pipe.h"
+
+static GPrintFunc saved_print_handler;
+static gboolean print_handler_installed;
+/* Nonzero while a command's output is going to a shell command */
+static int pipe_depth;
+
+/* Passes the output on and then notices if the reader has gone away */
+static void
+pipe_print (const gchar *string)
+{
+  if (saved_print_handler)
+    saved_print_handler (string);
+  else
+    {
+      fputs (string, stdout);
+      fflush (stdout);
+    }
+
+  if (pipe_depth && ferror (stdout) && !output_cancelled ())
+    cancel_output ();
+}
+
+static void
+pipe_usage (void)
+{
+  g_print (_("Usage: pipe [COMMAND] | SHELL_COMMAND\n"
+             "       | [COMMAND] | SHELL_COMMAND\n"
+             "       pipe -d DELIM COMMAND DELIM SHELL_COMMAND\n"));
+}
+
+static void
+bosh_pipe_command (char *args, int from_tty)
+{
+  static char *last_command = NULL;
+  const char *delim = "|";
+  char *delim_buf = NULL;
+  char *command;
+  char *shell_command;
+  char *split;
+  char *argv[4];
+  GError *error = NULL;
+  GPid child;
+  int child_stdin;
+  int saved_stdout;
+  struct sigaction ignore_pipe;
+  struct sigaction saved_sigpipe;
+  int status = 0;
+
+  if (!args || !*args)
+    {
+      pipe_usage ();
+      return;
+    }
+
+  args = g_strchug (args);
+  if (strncmp (args, "-d", 2) == 0 && g_ascii_isspace (args[2]))
+    {
+      char *p = g_strchug (args + 2);
+      char *end = p;
+
+      while (*end && !g_ascii_isspace (*end))
+        end++;
+      if (end == p)
+        {
+          pipe_usage ();
+          return;
+        }
+      delim = delim_buf = g_strndup (p, end - p);
+      args = end;
+    }
+
+  split = strstr (args, delim);
+  if (!split)
+    {
+      g_print (_("Missing delimiter \"%s\" before the shell command.\n"),
+               delim);
+      pipe_usage ();
+      g_free (delim_buf);
+      return;
+    }
+
+  shell_command = g_strstrip (split + strlen (delim));
+  *split = '\0';
+  command = g_strstrip (args);
+  g_free (delim_buf);
+
+  if (!*shell_command)
+    {
+      bosh_command_error_no_argument (_("shell command"));
+      return;
+    }
+
+  /* With no command the last piped command is run again */
+  if (*command)
+    {
+      g_free (last_command);
+      last_command = g_strdup (command);
+    }
+  else if (!last_command)
+    {
+      g_print (_("No previous command to pipe.\n"));
+      return;
+    }
+  command = g_strdup (last_command);
+
+  argv[0] = "/bin/sh";
+  argv[1] = "-c";
+  argv[2] = shell_command;
+  argv[3] = NULL;
+
+  if (!g_spawn_async_with_pipes (NULL, argv, NULL,
+                                 G_SPAWN_DO_NOT_REAP_CHILD,
+                                 NULL, NULL, &child,
+                                 &child_stdin, NULL, NULL, &error))
+    {
+      g_print (_("Failed to run \"%s\": %s\n"), shell_command,
+               error->message);
+      g_error_free (error);
+      g_free (command);
+      return;
+    }
+
+  if (!print_handler_installed)
+    {
+      saved_print_handler = g_set_print_handler (pipe_print);
+      print_handler_installed = TRUE;
+    }
+
+  /* A reader that has gone away should show up as EPIPE, not kill us */
+  memset (&ignore_pipe, 0, sizeof (ignore_pipe));
+  ignore_pipe.sa_handler = SIG_IGN;
+  sigaction (SIGPIPE, &ignore_pipe, &saved_sigpipe);
+
+  fflush (stdout);
+  saved_stdout = dup (STDOUT_FILENO);
+  dup2 (child_stdin, STDOUT_FILENO);
+  close (child_stdin);
+
+  pipe_depth++;
+  bosh_execute_command (command, from_tty);
+  pipe_depth--;
+
+  fflush (stdout);
+  clearerr (stdout);
+  dup2 (saved_stdout, STDOUT_FILENO);
+  close (saved_stdout);
+
+  /* The shell command sees the end of its input now */
+  while (waitpid (child, &status, 0) < 0 && errno == EINTR)
+    ;
+  g_spawn_close_pid (child);
+
+  sigaction (SIGPIPE, &saved_sigpipe, NULL);
+
+  if (WIFEXITED (status) && WEXITSTATUS (status) != 0 && from_tty)
+    g_print (_("\"%s\" exited with status %d.\n"), shell_command,
+             WEXITSTATUS (status));
+
+  g_free (command);
+}
+
+void
+bosh_pipe_init_commands (void)
+{
+  bosh_add_command ("pipe", class_support, bosh_pipe_command,
+                    _("Send the output of a bosh command to a shell "
+                      "command.\n"
+                      "Usage: pipe [COMMAND] | SHELL_COMMAND\n"
+                      "       | [COMMAND] | SHELL_COMMAND\n"
+                      "       pipe -d DELIM COMMAND DELIM SHELL_COMMAND\n"
+                      "\n"
+                      "The output of COMMAND is streamed to the standard "
+                      "input of SHELL_COMMAND,\n"
+                      "which is run with /bin/sh.  If COMMAND is left out "
+                      "the last piped command\n"
+                      "is used.  Use -d to give a different delimiter if "
+                      "COMMAND contains \"|\".\n"
+                      "If SHELL_COMMAND exits before reading all the "
+                      "output, COMMAND is stopped\n"
+                      "early where possible."));
+  bosh_add_command_alias ("|", "pipe", class_support, 0);
+}
@@ -0,0 +1,975 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Direct access to the memory of a local process.
+ *
+ * Going through the debugger backend costs a round trip per request
+ * and the data is hex encoded on the way, which makes reading large
+ * ranges painfully slow.  When the target is a local process that we
+ * are allowed to ptrace we can instead read its memory directly,
+ * with process_vm_readv or pread on /proc/PID/mem.
+ *
+ * All of these fail with a G_FILE_ERROR if direct access isn't
+ * permitted, in which case callers should go through the backend. */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "bosh-procmem.h"
+
+/* Each worker copies this much at a time */
+#define PROCMEM_CHUNK_SIZE (8 * 1024 * 1024)
+/* Ranges smaller than this aren't worth splitting between threads */
+#define PROCMEM_PARALLEL_THRESHOLD (4 * PROCMEM_CHUNK_SIZE)
+#define PROCMEM_MAX_THREADS 8
+
+static void
+set_errno_error (GError **error, int errsv, int pid, guint64 address)
+{
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+               _("Cannot access memory of process %d at address "
+                 "0x%" G_GINT64_MODIFIER "x: %s"),
+               pid, address, g_strerror (errsv));
+}
+
+static int
+open_proc_mem (int pid, int flags, GError **error)
+{
+  char *path = g_strdup_printf ("/proc/%d/mem", pid);
+  int fd = open (path, flags);
+
+  if (fd == -1)
+    {
+      int errsv = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                   _("Failed to open %s: %s"), path, g_strerror (errsv));
+    }
+  g_free (path);
+  return fd;
+}
+
+static gboolean
+pread_all (int fd, guint8 *buf, gsize len, guint64 address, int *errsv)
+{
+  gsize done = 0;
+
+  while (done < len)
+    {
+      ssize_t count = pread (fd, buf + done, len - done, address + done);
+      if (count == -1 && errno == EINTR)
+        continue;
+      if (count <= 0)
+        {
+          *errsv = count == 0 ? EIO : errno;
+          return FALSE;
+        }
+      done += count;
+    }
+  return TRUE;
+}
+
+static gboolean
+pwrite_all (int fd, const guint8 *buf, gsize len, guint64 offset, int *errsv)
+{
+  gsize done = 0;
+
+  while (done < len)
+    {
+      ssize_t count = pwrite (fd, buf + done, len - done, offset + done);
+      if (count == -1 && errno == EINTR)
+        continue;
+      if (count <= 0)
+        {
+          *errsv = count == 0 ? EIO : errno;
+          return FALSE;
+        }
+      done += count;
+    }
+  return TRUE;
+}
+
+gboolean
+bosh_procmem_read (int pid,
+                   guint64 address,
+                   void *buf,
+                   gsize len,
+                   GError **error)
+{
+#ifdef HAVE_PROCESS_VM_READV
+  struct iovec local = { buf, len };
+  struct iovec remote = { (void *)(gulong)address, len };
+#endif
+  ssize_t count = 0;
+  int errsv;
+  int fd;
+  gboolean ret;
+
+  /* process_vm_readv avoids the open and is a single copy, but it can't
+   * read past a page the target hasn't got mapped readable (e.g. a
+   * PROT_NONE guard page that ptrace would be allowed to read) so
+   * anything it doesn't finish is handed to /proc/PID/mem */
+#ifdef HAVE_PROCESS_VM_READV
+  count = process_vm_readv (pid, &local, 1, &remote, 1, 0);
+  if (count == (ssize_t)len)
+    return TRUE;
+  if (count < 0)
+    count = 0;
+#endif
+
+  fd = open_proc_mem (pid, O_RDONLY, error);
+  if (fd == -1)
+    return FALSE;
+
+  ret = pread_all (fd, (guint8 *)buf + count, len - count,
+                   address + count, &errsv);
+  if (!ret)
+    set_errno_error (error, errsv, pid, address);
+  close (fd);
+
+  return ret;
+}
+
+gboolean
+bosh_procmem_write (int pid,
+                    guint64 address,
+                    const void *buf,
+                    gsize len,
+                    GError **error)
+{
+  int errsv;
+  int fd;
+  gboolean ret;
+
+  fd = open_proc_mem (pid, O_WRONLY, error);
+  if (fd == -1)
+    return FALSE;
+
+  ret = pwrite_all (fd, buf, len, address, &errsv);
+  if (!ret)
+    set_errno_error (error, errsv, pid, address);
+  close (fd);
+
+  return ret;
+}
+
+typedef struct _ProcmemCopy
+{
+  int mem_fd;
+  int pid;
+  guint64 address;
+  guint64 len;
+  int out_fd;
+  guint64 out_offset;
+
+  GMutex *lock;
+  guint64 next_offset;
+  /* The first error seen by any of the workers */
+  int errsv;
+  guint64 error_address;
+  gboolean write_failed;
+} ProcmemCopy;
+
+static gpointer
+procmem_copy_thread (gpointer data)
+{
+  ProcmemCopy *copy = data;
+  guint8 *buf = g_malloc (MIN (copy->len, PROCMEM_CHUNK_SIZE));
+
+  while (TRUE)
+    {
+      guint64 offset;
+      gsize len;
+      int errsv;
+
+      g_mutex_lock (copy->lock);
+      offset = copy->next_offset;
+      if (copy->errsv || offset >= copy->len)
+        {
+          g_mutex_unlock (copy->lock);
+          break;
+        }
+      len = MIN (PROCMEM_CHUNK_SIZE, copy->len - offset);
+      copy->next_offset += len;
+      g_mutex_unlock (copy->lock);
+
+      if (!pread_all (copy->mem_fd, buf, len,
+                      copy->address + offset, &errsv))
+        {
+          g_mutex_lock (copy->lock);
+          if (!copy->errsv)
+            {
+              copy->errsv = errsv;
+              copy->error_address = copy->address + offset;
+            }
+          g_mutex_unlock (copy->lock);
+          break;
+        }
+
+      /* Chunks finish out of order, so each is written at its own
+       * offset rather than appended */
+      if (!pwrite_all (copy->out_fd, buf, len,
+                       copy->out_offset + offset, &errsv))
+        {
+          g_mutex_lock (copy->lock);
+          if (!copy->errsv)
+            {
+              copy->errsv = errsv;
+              copy->write_failed = TRUE;
+            }
+          g_mutex_unlock (copy->lock);
+          break;
+        }
+    }
+
+  g_free (buf);
+  return NULL;
+}
+
+/* Copy LEN bytes of process PID's memory starting at ADDRESS to the
+ * file descriptor FD at FD_OFFSET.  Large ranges are split between a
+ * number of threads, each of which reads and writes whole chunks
+ * independently.
+ *
+ * NB: FD must not have been opened with O_APPEND. */
+gboolean
+bosh_procmem_copy_to_fd (int pid,
+                         guint64 address,
+                         guint64 len,
+                         int fd,
+                         guint64 fd_offset,
+                         GError **error)
+{
+  GThread *threads[PROCMEM_MAX_THREADS];
+  ProcmemCopy copy;
+  int n_threads;
+  int i;
+
+  copy.mem_fd = open_proc_mem (pid, O_RDONLY, error);
+  if (copy.mem_fd == -1)
+    return FALSE;
+
+  copy.pid = pid;
+  copy.address = address;
+  copy.len = len;
+  copy.out_fd = fd;
+  copy.out_offset = fd_offset;
+  copy.lock = g_mutex_new ();
+  copy.next_offset = 0;
+  copy.errsv = 0;
+  copy.error_address = 0;
+  copy.write_failed = FALSE;
+
+  if (len < PROCMEM_PARALLEL_THRESHOLD)
+    n_threads = 1;
+  else
+    n_threads = CLAMP (sysconf (_SC_NPROCESSORS_ONLN),
+                       1, PROCMEM_MAX_THREADS);
+
+  if (n_threads == 1)
+    procmem_copy_thread (&copy);
+  else
+    {
+      for (i = 0; i < n_threads; i++)
+        threads[i] = g_thread_create (procmem_copy_thread, &copy, TRUE, NULL);
+      for (i = 0; i < n_threads; i++)
+        g_thread_join (threads[i]);
+    }
+
+  g_mutex_free (copy.lock);
+  close (copy.mem_fd);
+
+  if (copy.errsv)
+    {
+      if (copy.write_failed)
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (copy.errsv),
+                     "%s", g_strerror (copy.errsv));
+      else
+        set_errno_error (error, copy.errsv, pid, copy.error_address);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Whole process images
+ *
+ * An image file starts with a ProcessImageHeader, followed by the
+ * contents of every readable mapping laid out back to back at page
+ * aligned offsets, followed by the region, extent and string tables.
+ *
+ * Only pages that /proc/PID/pagemap says are resident or swapped are
+ * read; the rest of the file is left as holes, as are pages that turn
+ * out to be all zeros, so the image takes up about as much disk as
+ * the process has RSS whatever the size of its address space.  The
+ * tables are in host byte order: an image is only meant to be read
+ * back on the machine that wrote it. */
+
+#define PROCESS_IMAGE_VERSION 1
+
+/* Mappings are split into pieces of this size to share them out
+ * between threads */
+#define PROCESS_DUMP_UNIT_SIZE (64 * 1024 * 1024)
+/* The most that's read from the process at a time */
+#define PROCESS_DUMP_READ_SIZE (1024 * 1024)
+
+#define PAGEMAP_PRESENT (G_GUINT64_CONSTANT (1) << 63)
+#define PAGEMAP_SWAPPED (G_GUINT64_CONSTANT (1) << 62)
+
+typedef struct _ProcessImageHeader
+{
+  char magic[8];
+  guint32 version;
+  guint32 page_size;
+  guint64 n_regions;
+  guint64 regions_offset;
+  guint64 n_extents;
+  guint64 extents_offset;
+  guint64 strings_offset;
+  guint64 strings_size;
+} ProcessImageHeader;
+
+typedef struct _ProcessImageRegionEntry
+{
+  guint64 start;
+  guint64 end;
+  guint64 data_offset;
+  guint64 path_offset;
+  char perms[4];
+  guint32 path_len;
+} ProcessImageRegionEntry;
+
+typedef struct _ProcessDumpUnit
+{
+  BoshProcessImageRegion *region;
+  guint64 start;
+  guint64 end;
+  GArray *extents;
+  guint64 resident;
+  guint64 written;
+} ProcessDumpUnit;
+
+typedef struct _ProcessDump
+{
+  int mem_fd;
+  int pagemap_fd;
+  int out_fd;
+  guint page_size;
+
+  GArray *units;
+
+  GMutex *lock;
+  guint next_unit;
+  int errsv;
+} ProcessDump;
+
+static gboolean
+page_is_zero (const guint8 *page, gsize size)
+{
+  return page[0] == 0 && memcmp (page, page + 1, size - 1) == 0;
+}
+
+static void
+add_extent (GArray *extents, guint64 start, guint64 len, guint64 data_offset)
+{
+  if (extents->len)
+    {
+      BoshProcessImageExtent *last =
+        &g_array_index (extents, BoshProcessImageExtent, extents->len - 1);
+      if (last->start + last->len == start
+          && last->data_offset + last->len == data_offset)
+        {
+          last->len += len;
+          return;
+        }
+    }
+  {
+    BoshProcessImageExtent extent = { start, len, data_offset };
+    g_array_append_val (extents, extent);
+  }
+}
+
+/* Copy the resident pages [START, START+LEN) of UNIT into the image,
+ * skipping zero pages.  Returns FALSE only if writing the image
+ * failed; memory we can't read is simply left out. */
+static gboolean
+process_dump_run (ProcessDump *dump,
+                  ProcessDumpUnit *unit,
+                  guint64 start,
+                  gsize len,
+                  guint8 *buf)
+{
+  BoshProcessImageRegion *region = unit->region;
+  guint64 data_offset = region->data_offset + (start - region->start);
+  gsize page_size = dump->page_size;
+  gsize offset;
+  int errsv;
+
+  if (!pread_all (dump->mem_fd, buf, len, start, &errsv))
+    return TRUE;
+
+  unit->resident += len;
+  add_extent (unit->extents, start, len, data_offset);
+
+  offset = 0;
+  while (offset < len)
+    {
+      gsize run;
+
+      if (page_is_zero (buf + offset, page_size))
+        {
+          offset += page_size;
+          continue;
+        }
+
+      /* Write consecutive non-zero pages with a single pwrite */
+      for (run = page_size;
+           offset + run < len && !page_is_zero (buf + offset + run, page_size);
+           run += page_size)
+        ;
+      if (!pwrite_all (dump->out_fd, buf + offset, run,
+                       data_offset + offset, &errsv))
+        {
+          g_mutex_lock (dump->lock);
+          if (!dump->errsv)
+            dump->errsv = errsv;
+          g_mutex_unlock (dump->lock);
+          return FALSE;
+        }
+      unit->written += run;
+      offset += run;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+process_dump_unit (ProcessDump *dump,
+                   ProcessDumpUnit *unit,
+                   guint64 *pagemap,
+                   guint8 *buf)
+{
+  guint page_size = dump->page_size;
+  guint max_pages = PROCESS_DUMP_READ_SIZE / page_size;
+  guint64 address = unit->start;
+
+  while (address < unit->end)
+    {
+      guint n_pages = MIN (max_pages, (unit->end - address) / page_size);
+      gsize pagemap_size = n_pages * sizeof (guint64);
+      guint i;
+      int errsv;
+
+      if (dump->pagemap_fd == -1
+          || !pread_all (dump->pagemap_fd, (guint8 *)pagemap, pagemap_size,
+                         (address / page_size) * sizeof (guint64), &errsv))
+        {
+          /* Without the pagemap every page has to be assumed present */
+          for (i = 0; i < n_pages; i++)
+            pagemap[i] = PAGEMAP_PRESENT;
+        }
+
+      i = 0;
+      while (i < n_pages)
+        {
+          guint j;
+
+          if (!(pagemap[i] & (PAGEMAP_PRESENT | PAGEMAP_SWAPPED)))
+            {
+              i++;
+              continue;
+            }
+          for (j = i + 1;
+               j < n_pages && pagemap[j] & (PAGEMAP_PRESENT | PAGEMAP_SWAPPED);
+               j++)
+            ;
+          if (!process_dump_run (dump, unit,
+                                 address + (guint64)i * page_size,
+                                 (gsize)(j - i) * page_size, buf))
+            return FALSE;
+          i = j;
+        }
+
+      address += (guint64)n_pages * page_size;
+    }
+
+  return TRUE;
+}
+
+static gpointer
+process_dump_thread (gpointer data)
+{
+  ProcessDump *dump = data;
+  guint64 *pagemap =
+    g_new (guint64, PROCESS_DUMP_READ_SIZE / dump->page_size);
+  guint8 *buf = g_malloc (PROCESS_DUMP_READ_SIZE);
+
+  while (TRUE)
+    {
+      ProcessDumpUnit *unit;
+
+      g_mutex_lock (dump->lock);
+      if (dump->errsv || dump->next_unit >= dump->units->len)
+        {
+          g_mutex_unlock (dump->lock);
+          break;
+        }
+      unit = &g_array_index (dump->units, ProcessDumpUnit, dump->next_unit++);
+      g_mutex_unlock (dump->lock);
+
+      if (!process_dump_unit (dump, unit, pagemap, buf))
+        break;
+    }
+
+  g_free (buf);
+  g_free (pagemap);
+  return NULL;
+}
+
+/* Mappings whose contents we never try to read */
+static gboolean
+skip_mapping (const char *perms, const char *path)
+{
+  /* Includes PROT_NONE guard pages */
+  if (perms[0] != 'r')
+    return TRUE;
+
+  if (strcmp (path, "[vvar]") == 0
+      || strcmp (path, "[vvar_vclock]") == 0
+      || strcmp (path, "[vsyscall]") == 0)
+    return TRUE;
+
+  /* Reading device memory can have side effects */
+  if (g_str_has_prefix (path, "/dev/")
+      && !g_str_has_prefix (path, "/dev/shm/")
+      && strcmp (path, "/dev/zero") != 0)
+    return TRUE;
+
+  return FALSE;
+}
+
+static GArray *
+read_process_maps (int pid, guint page_size, guint *n_skipped, GError **error)
+{
+  char *path = g_strdup_printf ("/proc/%d/maps", pid);
+  FILE *maps = fopen (path, "r");
+  GArray *regions;
+  guint64 data_offset = page_size;
+  char line[4096];
+
+  if (!maps)
+    {
+      int errsv = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                   _("Failed to open %s: %s"), path, g_strerror (errsv));
+      g_free (path);
+      return NULL;
+    }
+  g_free (path);
+
+  regions = g_array_new (FALSE, FALSE, sizeof (BoshProcessImageRegion));
+  *n_skipped = 0;
+
+  while (fgets (line, sizeof (line), maps))
+    {
+      BoshProcessImageRegion region;
+      char perms[5];
+      int path_start = 0;
+      char *end;
+
+      if (sscanf (line, "%" G_GINT64_MODIFIER "x-%" G_GINT64_MODIFIER "x "
+                  "%4s %*x %*s %*u %n",
+                  &region.start, &region.end, perms, &path_start) < 3)
+        continue;
+
+      end = line + strlen (line);
+      while (end > line && g_ascii_isspace (end[-1]))
+        *--end = '\0';
+
+      if (skip_mapping (perms, path_start ? line + path_start : ""))
+        {
+          (*n_skipped)++;
+          continue;
+        }
+
+      memcpy (region.perms, perms, 4);
+      region.path = path_start && line[path_start]
+        ? g_strdup (line + path_start) : NULL;
+      region.data_offset = data_offset;
+      data_offset += region.end - region.start;
+      g_array_append_val (regions, region);
+    }
+
+  fclose (maps);
+  return regions;
+}
+
+static void
+free_regions (GArray *regions)
+{
+  guint i;
+
+  for (i = 0; i < regions->len; i++)
+    g_free (g_array_index (regions, BoshProcessImageRegion, i).path);
+  g_array_free (regions, TRUE);
+}
+
+/* The mappings of process PID that are worth reading, in address
+ * order.  Free with bosh_procmem_free_mappings () */
+GArray *
+bosh_procmem_get_mappings (int pid, GError **error)
+{
+  guint n_skipped;
+
+  return read_process_maps (pid, sysconf (_SC_PAGESIZE), &n_skipped, error);
+}
+
+void
+bosh_procmem_free_mappings (GArray *mappings)
+{
+  free_regions (mappings);
+}
+
+static gboolean
+write_process_image_tables (int fd,
+                            guint page_size,
+                            GArray *regions,
+                            GArray *extents,
+                            guint64 tables_offset,
+                            int *errsv)
+{
+  ProcessImageHeader header;
+  ProcessImageRegionEntry *entries;
+  GString *strings = g_string_new (NULL);
+  guint64 offset = tables_offset;
+  gboolean ret;
+  guint i;
+
+  entries = g_new0 (ProcessImageRegionEntry, regions->len);
+  for (i = 0; i < regions->len; i++)
+    {
+      BoshProcessImageRegion *region =
+        &g_array_index (regions, BoshProcessImageRegion, i);
+
+      entries[i].start = region->start;
+      entries[i].end = region->end;
+      entries[i].data_offset = region->data_offset;
+      memcpy (entries[i].perms, region->perms, 4);
+      if (region->path)
+        {
+          entries[i].path_offset = strings->len;
+          entries[i].path_len = strlen (region->path);
+          g_string_append_len (strings, region->path, entries[i].path_len);
+        }
+      else
+        entries[i].path_offset = G_MAXUINT64;
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, BOSH_PROCESS_IMAGE_MAGIC, 8);
+  header.version = PROCESS_IMAGE_VERSION;
+  header.page_size = page_size;
+  header.n_regions = regions->len;
+  header.regions_offset = offset;
+  offset += regions->len * sizeof (ProcessImageRegionEntry);
+  header.n_extents = extents->len;
+  header.extents_offset = offset;
+  offset += extents->len * sizeof (BoshProcessImageExtent);
+  header.strings_offset = offset;
+  header.strings_size = strings->len;
+
+  ret = (pwrite_all (fd, (guint8 *)entries,
+                     regions->len * sizeof (ProcessImageRegionEntry),
+                     header.regions_offset, errsv)
+         && pwrite_all (fd, (guint8 *)extents->data,
+                        extents->len * sizeof (BoshProcessImageExtent),
+                        header.extents_offset, errsv)
+         && pwrite_all (fd, (guint8 *)strings->str, strings->len,
+                        header.strings_offset, errsv)
+         && pwrite_all (fd, (guint8 *)&header, sizeof (header), 0, errsv));
+
+  g_free (entries);
+  g_string_free (strings, TRUE);
+  return ret;
+}
+
+/* Write the readable memory of process PID to FILENAME as a sparse
+ * image that can be read back with bosh_process_image_open () */
+gboolean
+bosh_procmem_dump_process (int pid,
+                           const char *filename,
+                           BoshProcessImageStats *stats,
+                           GError **error)
+{
+  GThread *threads[PROCMEM_MAX_THREADS];
+  ProcessDump dump;
+  GArray *regions;
+  GArray *extents;
+  guint64 tables_offset;
+  char *pagemap_path;
+  int n_threads;
+  guint n_skipped;
+  guint i;
+  int errsv;
+
+  memset (stats, 0, sizeof (*stats));
+  dump.page_size = sysconf (_SC_PAGESIZE);
+
+  regions = read_process_maps (pid, dump.page_size, &n_skipped, error);
+  if (!regions)
+    return FALSE;
+
+  dump.mem_fd = open_proc_mem (pid, O_RDONLY, error);
+  if (dump.mem_fd == -1)
+    {
+      free_regions (regions);
+      return FALSE;
+    }
+
+  /* Without CAP_SYS_ADMIN the frame numbers are hidden but the present
+   * and swapped bits, which are all we want, are still there */
+  pagemap_path = g_strdup_printf ("/proc/%d/pagemap", pid);
+  dump.pagemap_fd = open (pagemap_path, O_RDONLY);
+  g_free (pagemap_path);
+
+  dump.out_fd = open (filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (dump.out_fd == -1)
+    {
+      errsv = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                   _("Failed to create %s: %s"), filename, g_strerror (errsv));
+      if (dump.pagemap_fd != -1)
+        close (dump.pagemap_fd);
+      close (dump.mem_fd);
+      free_regions (regions);
+      return FALSE;
+    }
+
+  dump.units = g_array_new (FALSE, FALSE, sizeof (ProcessDumpUnit));
+  tables_offset = dump.page_size;
+  for (i = 0; i < regions->len; i++)
+    {
+      BoshProcessImageRegion *region =
+        &g_array_index (regions, BoshProcessImageRegion, i);
+      guint64 start;
+
+      for (start = region->start; start < region->end;
+           start += PROCESS_DUMP_UNIT_SIZE)
+        {
+          ProcessDumpUnit unit;
+
+          unit.region = region;
+          unit.start = start;
+          unit.end = MIN (region->end, start + PROCESS_DUMP_UNIT_SIZE);
+          unit.extents =
+            g_array_new (FALSE, FALSE, sizeof (BoshProcessImageExtent));
+          unit.resident = 0;
+          unit.written = 0;
+          g_array_append_val (dump.units, unit);
+        }
+
+      stats->mapped_bytes += region->end - region->start;
+      tables_offset = region->data_offset + (region->end - region->start);
+    }
+
+  dump.lock = g_mutex_new ();
+  dump.next_unit = 0;
+  dump.errsv = 0;
+
+  n_threads = CLAMP (sysconf (_SC_NPROCESSORS_ONLN), 1, PROCMEM_MAX_THREADS);
+  n_threads = MIN (n_threads, MAX (dump.units->len, 1));
+  for (i = 0; i < n_threads; i++)
+    threads[i] = g_thread_create (process_dump_thread, &dump, TRUE, NULL);
+  for (i = 0; i < n_threads; i++)
+    g_thread_join (threads[i]);
+
+  /* The units were queued in address order so their extents can simply
+   * be concatenated */
+  extents = g_array_new (FALSE, FALSE, sizeof (BoshProcessImageExtent));
+  for (i = 0; i < dump.units->len; i++)
+    {
+      ProcessDumpUnit *unit = &g_array_index (dump.units, ProcessDumpUnit, i);
+      guint j;
+
+      for (j = 0; j < unit->extents->len; j++)
+        {
+          BoshProcessImageExtent *extent =
+            &g_array_index (unit->extents, BoshProcessImageExtent, j);
+          add_extent (extents, extent->start, extent->len,
+                      extent->data_offset);
+        }
+      stats->resident_bytes += unit->resident;
+      stats->written_bytes += unit->written;
+      g_array_free (unit->extents, TRUE);
+    }
+  g_array_free (dump.units, TRUE);
+  g_mutex_free (dump.lock);
+
+  errsv = dump.errsv;
+  if (!errsv)
+    write_process_image_tables (dump.out_fd, dump.page_size,
+                                regions, extents, tables_offset, &errsv);
+
+  stats->n_regions = regions->len;
+  stats->n_skipped = n_skipped;
+
+  g_array_free (extents, TRUE);
+  free_regions (regions);
+  if (dump.pagemap_fd != -1)
+    close (dump.pagemap_fd);
+  close (dump.mem_fd);
+  if (close (dump.out_fd) != 0 && !errsv)
+    errsv = errno;
+
+  if (errsv)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                   _("Failed to write %s: %s"), filename, g_strerror (errsv));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+gboolean
+bosh_process_image_is_image (const char *filename)
+{
+  char magic[8];
+  int fd = open (filename, O_RDONLY);
+  gboolean ret;
+  int errsv;
+
+  if (fd == -1)
+    return FALSE;
+  ret = pread_all (fd, (guint8 *)magic, sizeof (magic), 0, &errsv)
+    && memcmp (magic, BOSH_PROCESS_IMAGE_MAGIC, sizeof (magic)) == 0;
+  close (fd);
+
+  return ret;
+}
+
+BoshProcessImage *
+bosh_process_image_open (const char *filename, GError **error)
+{
+  BoshProcessImage *image;
+  ProcessImageHeader header;
+  ProcessImageRegionEntry *entries = NULL;
+  char *strings = NULL;
+  int errsv;
+  int fd;
+  guint i;
+
+  fd = open (filename, O_RDONLY);
+  if (fd == -1)
+    {
+      errsv = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                   _("Failed to open %s: %s"), filename, g_strerror (errsv));
+      return NULL;
+    }
+
+  if (!pread_all (fd, (guint8 *)&header, sizeof (header), 0, &errsv))
+    goto read_error;
+  if (memcmp (header.magic, BOSH_PROCESS_IMAGE_MAGIC, 8) != 0
+      || header.version != PROCESS_IMAGE_VERSION)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   _("%s is not a process image bosh can read"), filename);
+      close (fd);
+      return NULL;
+    }
+
+  image = g_new0 (BoshProcessImage, 1);
+  image->fd = fd;
+  image->page_size = header.page_size;
+  image->regions = g_array_sized_new (FALSE, FALSE,
+                                      sizeof (BoshProcessImageRegion),
+                                      header.n_regions);
+  image->extents = g_array_sized_new (FALSE, FALSE,
+                                      sizeof (BoshProcessImageExtent),
+                                      header.n_extents);
+
+  entries = g_new (ProcessImageRegionEntry, header.n_regions);
+  strings = g_malloc (header.strings_size + 1);
+  g_array_set_size (image->extents, header.n_extents);
+  if (!pread_all (fd, (guint8 *)entries,
+                  header.n_regions * sizeof (ProcessImageRegionEntry),
+                  header.regions_offset, &errsv)
+      || !pread_all (fd, (guint8 *)image->extents->data,
+                     header.n_extents * sizeof (BoshProcessImageExtent),
+                     header.extents_offset, &errsv)
+      || !pread_all (fd, (guint8 *)strings, header.strings_size,
+                     header.strings_offset, &errsv))
+    {
+      bosh_process_image_free (image);
+      g_free (entries);
+      g_free (strings);
+      fd = -1;
+      goto read_error;
+    }
+
+  for (i = 0; i < header.n_regions; i++)
+    {
+      BoshProcessImageRegion region;
+
+      region.start = entries[i].start;
+      region.end = entries[i].end;
+      region.data_offset = entries[i].data_offset;
+      memcpy (region.perms, entries[i].perms, 4);
+      if (entries[i].path_offset != G_MAXUINT64
+          && entries[i].path_offset + entries[i].path_len
+             <= header.strings_size)
+        region.path = g_strndup (strings + entries[i].path_offset,
+                                 entries[i].path_len);
+      else
+        region.path = NULL;
+      g_array_append_val (image->regions, region);
+    }
+
+  g_free (entries);
+  g_free (strings);
+  return image;
+
+read_error:
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+               _("Failed to read %s: %s"), filename, g_strerror (errsv));
+  if (fd != -1)
+    close (fd);
+  return NULL;
+}
+
+void
+bosh_process_image_free (BoshProcessImage *image)
+{
+  free_regions (image->regions);
+  g_array_free (image->extents, TRUE);
+  close (image->fd);
+  g_free (image);
+}
@@ -0,0 +1,104 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_PROCMEM_H
+#define BOSH_PROCMEM_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gboolean bosh_procmem_read (int pid,
+                            guint64 address,
+                            void *buf,
+                            gsize len,
+                            GError **error);
+
+gboolean bosh_procmem_write (int pid,
+                             guint64 address,
+                             const void *buf,
+                             gsize len,
+                             GError **error);
+
+gboolean bosh_procmem_copy_to_fd (int pid,
+                                  guint64 address,
+                                  guint64 len,
+                                  int fd,
+                                  guint64 fd_offset,
+                                  GError **error);
+
+/* A whole process image written by bosh_procmem_dump_process () */
+
+#define BOSH_PROCESS_IMAGE_MAGIC "BOSHSNAP"
+
+typedef struct _BoshProcessImageRegion
+{
+  guint64 start;
+  guint64 end;
+  /* Where the region's pages start in the image file */
+  guint64 data_offset;
+  /* "rwxp" as in /proc/PID/maps */
+  char perms[4];
+  /* The mapped file, if any */
+  char *path;
+} BoshProcessImageRegion;
+
+/* A run of pages that were resident when the image was taken.  Pages
+ * outside of any extent were never touched by the process and are
+ * left alone on restore; zero pages within an extent are holes in the
+ * file and are restored as zeros. */
+typedef struct _BoshProcessImageExtent
+{
+  guint64 start;
+  guint64 len;
+  guint64 data_offset;
+} BoshProcessImageExtent;
+
+typedef struct _BoshProcessImage
+{
+  int fd;
+  guint32 page_size;
+  GArray *regions;
+  GArray *extents;
+} BoshProcessImage;
+
+typedef struct _BoshProcessImageStats
+{
+  guint n_regions;
+  guint n_skipped;
+  guint64 mapped_bytes;
+  guint64 resident_bytes;
+  guint64 written_bytes;
+} BoshProcessImageStats;
+
+GArray *bosh_procmem_get_mappings (int pid, GError **error);
+void bosh_procmem_free_mappings (GArray *mappings);
+
+gboolean bosh_procmem_dump_process (int pid,
+                                    const char *filename,
+                                    BoshProcessImageStats *stats,
+                                    GError **error);
+
+gboolean bosh_process_image_is_image (const char *filename);
+BoshProcessImage *bosh_process_image_open (const char *filename,
+                                           GError **error);
+void bosh_process_image_free (BoshProcessImage *image);
+
+G_END_DECLS
+
+#endif /* BOSH_PROCMEM_H */
@@ -0,0 +1,736 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* A JSON-RPC 2.0 control socket, for IDEs and scripts that want to
+ * drive bosh without scraping the terminal.
+ *
+ * "bosh --server PATH" listens on a UNIX domain socket.  Each request
+ * and response is one line of JSON, so clients can pipeline as many
+ * requests as they like; they're handled in order as they arrive and
+ * answered in the same order.  Any number of clients are multiplexed
+ * on the main loop along with the terminal.
+ *
+ * The method is looked up in the command table, with params
+ * {"args": "..."} as its arguments, and the result carries the text
+ * the command printed.  A few methods instead return structured
+ * results:
+ *
+ *   execute  {"command": "LINE"}  runs a whole command line
+ *   stack                         the current stack as a list of frames
+ *   state                         the state and source position
+ *
+ * While the target runs, commands that need it stopped are refused
+ * with an error where the terminal would queue them up instead.
+ *
+ * Every change of state is sent to all clients as a "state-changed"
+ * notification. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <json-glib/json-glib.h>
+
+#include <gswat/gswat.h>
+
+#include "cli-decode.h"
+
+#include "bosh-commands.h"
+#include "bosh-inferior.h"
+#include "bosh-main.h"
+#include "bosh-server.h"
+
+/* JSON-RPC 2.0 error codes */
+#define RPC_PARSE_ERROR      -32700
+#define RPC_INVALID_REQUEST  -32600
+#define RPC_METHOD_NOT_FOUND -32601
+#define RPC_INVALID_PARAMS   -32602
+#define RPC_NOT_INTERRUPTED  -32000
+#define RPC_TARGET_BUSY      -32001
+
+typedef struct _ServerClient
+{
+  int fd;
+  GIOChannel *channel;
+  guint in_watch;
+  guint out_watch;
+  GString *in;
+  GString *out;
+  gboolean closing;
+} ServerClient;
+
+static int listen_fd = -1;
+static char *socket_path;
+static GList *clients;
+
+/* While a request is being handled this collects what it prints */
+static GString *capture;
+static GPrintFunc saved_print_handler;
+static gboolean print_handler_installed;
+
+static void client_free (ServerClient *client);
+static gboolean client_out_cb (GIOChannel *channel,
+                               GIOCondition condition,
+                               gpointer data);
+
+static void
+server_print (const gchar *string)
+{
+  if (capture)
+    g_string_append (capture, string);
+  else if (saved_print_handler)
+    saved_print_handler (string);
+  else
+    {
+      fputs (string, stdout);
+      fflush (stdout);
+    }
+}
+
+static const char *
+state_name (GSwatDebuggableState state)
+{
+  switch (state)
+    {
+    case GSWAT_DEBUGGABLE_DISCONNECTED:
+      return "disconnected";
+    case GSWAT_DEBUGGABLE_RUNNING:
+      return "running";
+    case GSWAT_DEBUGGABLE_INTERRUPTED:
+      return "interrupted";
+    }
+  return "unknown";
+}
+
+static char *
+node_to_data (JsonNode *node)
+{
+  JsonGenerator *generator = json_generator_new ();
+  char *data;
+
+  json_generator_set_root (generator, node);
+  data = json_generator_to_data (generator, NULL);
+  g_object_unref (generator);
+  return data;
+}
+
+/* Queues LINE for CLIENT, writing as much as we can straight away */
+static void
+client_send (ServerClient *client, const char *line)
+{
+  if (client->closing)
+    return;
+
+  g_string_append (client->out, line);
+  g_string_append_c (client->out, '\n');
+
+  if (!client->out_watch)
+    client->out_watch = g_io_add_watch (client->channel, G_IO_OUT,
+                                        client_out_cb, client);
+}
+
+static void
+client_send_node (ServerClient *client, JsonNode *node)
+{
+  char *data = node_to_data (node);
+
+  client_send (client, data);
+  g_free (data);
+}
+
+static void
+add_id (JsonBuilder *builder, JsonNode *id)
+{
+  json_builder_set_member_name (builder, "id");
+  if (id)
+    json_builder_add_value (builder, json_node_copy (id));
+  else
+    json_builder_add_null_value (builder);
+}
+
+static void
+add_string (JsonBuilder *builder, const char *name, const char *value)
+{
+  json_builder_set_member_name (builder, name);
+  if (value)
+    json_builder_add_string_value (builder, value);
+  else
+    json_builder_add_null_value (builder);
+}
+
+/* Requests without an id are notifications and get no reply */
+static void
+send_result (ServerClient *client, JsonNode *id, JsonNode *result)
+{
+  JsonBuilder *builder;
+  JsonNode *root;
+
+  if (!id)
+    {
+      json_node_free (result);
+      return;
+    }
+
+  builder = json_builder_new ();
+
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "jsonrpc");
+  json_builder_add_string_value (builder, "2.0");
+  json_builder_set_member_name (builder, "result");
+  json_builder_add_value (builder, result);
+  add_id (builder, id);
+  json_builder_end_object (builder);
+
+  root = json_builder_get_root (builder);
+  client_send_node (client, root);
+  json_node_free (root);
+  g_object_unref (builder);
+}
+
+static void
+send_error (ServerClient *client, JsonNode *id, int code,
+            const char *message, const char *output)
+{
+  JsonBuilder *builder = json_builder_new ();
+  JsonNode *root;
+
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "jsonrpc");
+  json_builder_add_string_value (builder, "2.0");
+  json_builder_set_member_name (builder, "error");
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "code");
+  json_builder_add_int_value (builder, code);
+  json_builder_set_member_name (builder, "message");
+  json_builder_add_string_value (builder, message);
+  if (output)
+    {
+      json_builder_set_member_name (builder, "data");
+      json_builder_add_string_value (builder, output);
+    }
+  json_builder_end_object (builder);
+  add_id (builder, id);
+  json_builder_end_object (builder);
+
+  root = json_builder_get_root (builder);
+  client_send_node (client, root);
+  json_node_free (root);
+  g_object_unref (builder);
+}
+
+/* Appends the source position of DEBUGGABLE to the current object */
+static void
+add_position (JsonBuilder *builder, GSwatDebuggable *debuggable)
+{
+  char *uri = gswat_debuggable_get_source_uri (debuggable);
+
+  add_string (builder, "uri", uri);
+  json_builder_set_member_name (builder, "line");
+  json_builder_add_int_value (builder,
+                              gswat_debuggable_get_source_line (debuggable));
+  g_free (uri);
+}
+
+static JsonNode *
+build_state (GSwatDebuggable *debuggable)
+{
+  JsonBuilder *builder = json_builder_new ();
+  BoshInferior *inferior = bosh_inferior_lookup (debuggable);
+  GSwatDebuggableState state = gswat_debuggable_get_state (debuggable);
+  JsonNode *node;
+
+  json_builder_begin_object (builder);
+  if (inferior)
+    {
+      json_builder_set_member_name (builder, "inferior");
+      json_builder_add_int_value (builder, inferior->num);
+    }
+  json_builder_set_member_name (builder, "state");
+  json_builder_add_string_value (builder, state_name (state));
+  if (state == GSWAT_DEBUGGABLE_INTERRUPTED)
+    add_position (builder, debuggable);
+  json_builder_end_object (builder);
+
+  node = json_builder_get_root (builder);
+  g_object_unref (builder);
+  return node;
+}
+
+static JsonNode *
+build_stack (GSwatDebuggable *debuggable)
+{
+  JsonBuilder *builder = json_builder_new ();
+  GQueue *stack = gswat_debuggable_get_stack (debuggable);
+  JsonNode *node;
+  GList *l;
+
+  json_builder_begin_array (builder);
+  for (l = stack->head; l; l = l->next)
+    {
+      GSwatDebuggableFrame *frame = l->data;
+      GList *a;
+
+      json_builder_begin_object (builder);
+      json_builder_set_member_name (builder, "level");
+      json_builder_add_int_value (builder, frame->level);
+      json_builder_set_member_name (builder, "address");
+      json_builder_add_int_value (builder, frame->address);
+      add_string (builder, "function", frame->function);
+      add_string (builder, "uri", frame->source_uri);
+      json_builder_set_member_name (builder, "line");
+      json_builder_add_int_value (builder, frame->line);
+
+      json_builder_set_member_name (builder, "args");
+      json_builder_begin_array (builder);
+      for (a = frame->arguments; a; a = a->next)
+        {
+          GSwatDebuggableFrameArgument *arg = a->data;
+
+          json_builder_begin_object (builder);
+          add_string (builder, "name", arg->name);
+          add_string (builder, "value", arg->value);
+          json_builder_end_object (builder);
+        }
+      json_builder_end_array (builder);
+
+      json_builder_end_object (builder);
+    }
+  json_builder_end_array (builder);
+  gswat_debuggable_stack_free (stack);
+
+  node = json_builder_get_root (builder);
+  g_object_unref (builder);
+  return node;
+}
+
+/* Returns the string member NAME of PARAMS, or the first element if
+ * PARAMS is an array */
+static const char *
+get_string_param (JsonNode *params, const char *name)
+{
+  JsonNode *node = NULL;
+
+  if (!params)
+    return NULL;
+
+  if (JSON_NODE_HOLDS_OBJECT (params))
+    {
+      JsonObject *object = json_node_get_object (params);
+      if (json_object_has_member (object, name))
+        node = json_object_get_member (object, name);
+    }
+  else if (JSON_NODE_HOLDS_ARRAY (params))
+    {
+      JsonArray *array = json_node_get_array (params);
+      if (json_array_get_length (array) > 0)
+        node = json_array_get_element (array, 0);
+    }
+
+  if (node && JSON_NODE_HOLDS_VALUE (node)
+      && json_node_get_value_type (node) == G_TYPE_STRING)
+    return json_node_get_string (node);
+  return NULL;
+}
+
+/* Runs LINE through the command table, replying with what it printed */
+static void
+handle_command (ServerClient *client, JsonNode *id, const char *line)
+{
+  char *copy = g_strdup (line);
+  char *p = copy;
+  struct cmd_list_element *c;
+  GError *error = NULL;
+  JsonBuilder *builder;
+
+  c = bosh_lookup_command (&p, cmdlist, "", 1, &error);
+  g_free (copy);
+  if (!c)
+    {
+      send_error (client, id, RPC_METHOD_NOT_FOUND,
+                  error ? error->message : _("Unknown command"), NULL);
+      if (error)
+        g_error_free (error);
+      return;
+    }
+
+  /* The reply has to carry the command's output, so a command that
+   * would have to be queued until the target stops is turned away
+   * rather than typed ahead */
+  copy = g_strdup (line);
+  if (bosh_command_must_wait (copy))
+    {
+      g_free (copy);
+      send_error (client, id, RPC_TARGET_BUSY,
+                  _("The program is running; interrupt it first"), NULL);
+      return;
+    }
+  g_free (copy);
+
+  capture = g_string_new (NULL);
+  copy = g_strdup (line);
+  c = bosh_execute_command (copy, 0);
+  g_free (copy);
+
+  builder = json_builder_new ();
+  json_builder_begin_object (builder);
+  add_string (builder, "command", c ? c->name : NULL);
+  add_string (builder, "output", capture->str);
+  json_builder_end_object (builder);
+
+  g_string_free (capture, TRUE);
+  capture = NULL;
+
+  send_result (client, id, json_builder_get_root (builder));
+  g_object_unref (builder);
+}
+
+static void
+handle_request (ServerClient *client, JsonNode *request)
+{
+  GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
+  JsonObject *object;
+  JsonNode *id = NULL;
+  JsonNode *params = NULL;
+  const char *method;
+
+  if (!JSON_NODE_HOLDS_OBJECT (request))
+    {
+      send_error (client, NULL, RPC_INVALID_REQUEST,
+                  _("Request must be an object"), NULL);
+      return;
+    }
+
+  object = json_node_get_object (request);
+  if (json_object_has_member (object, "id"))
+    id = json_object_get_member (object, "id");
+  if (json_object_has_member (object, "params"))
+    params = json_object_get_member (object, "params");
+
+  if (!json_object_has_member (object, "method")
+      || !JSON_NODE_HOLDS_VALUE (json_object_get_member (object, "method"))
+      || json_node_get_value_type (json_object_get_member (object, "method"))
+         != G_TYPE_STRING)
+    {
+      send_error (client, id, RPC_INVALID_REQUEST,
+                  _("Missing method"), NULL);
+      return;
+    }
+  method = json_object_get_string_member (object, "method");
+
+  if (strcmp (method, "execute") == 0)
+    {
+      const char *line = get_string_param (params, "command");
+
+      if (!line)
+        send_error (client, id, RPC_INVALID_PARAMS,
+                    _("execute needs a \"command\" string"), NULL);
+      else
+        handle_command (client, id, line);
+    }
+  else if (strcmp (method, "state") == 0)
+    {
+      if (!debuggable)
+        send_error (client, id, RPC_NOT_INTERRUPTED,
+                    _("No debugging session has been set up yet"), NULL);
+      else
+        send_result (client, id, build_state (debuggable));
+    }
+  else if (strcmp (method, "stack") == 0)
+    {
+      if (!debuggable
+          || gswat_debuggable_get_state (debuggable)
+             != GSWAT_DEBUGGABLE_INTERRUPTED)
+        send_error (client, id, RPC_NOT_INTERRUPTED,
+                    _("The program is not interrupted"), NULL);
+      else
+        send_result (client, id, build_stack (debuggable));
+    }
+  else
+    {
+      const char *args = get_string_param (params, "args");
+      char *line = g_strconcat (method, args ? " " : NULL, args, NULL);
+
+      handle_command (client, id, line);
+      g_free (line);
+    }
+}
+
+static void
+handle_line (ServerClient *client, const char *line)
+{
+  JsonParser *parser = json_parser_new ();
+  GError *error = NULL;
+
+  if (!json_parser_load_from_data (parser, line, -1, &error))
+    {
+      send_error (client, NULL, RPC_PARSE_ERROR, error->message, NULL);
+      g_error_free (error);
+    }
+  else
+    handle_request (client, json_parser_get_root (parser));
+
+  g_object_unref (parser);
+}
+
+static gboolean
+client_out_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+  ServerClient *client = data;
+
+  while (client->out->len)
+    {
+      /* MSG_NOSIGNAL so that a client disconnecting under us gives
+       * EPIPE instead of a SIGPIPE killing bosh */
+      ssize_t n = send (client->fd, client->out->str, client->out->len,
+                        MSG_NOSIGNAL);
+
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          if (errno == EAGAIN)
+            return TRUE;
+
+          /* The client has gone */
+          client->out_watch = 0;
+          client_free (client);
+          return FALSE;
+        }
+      g_string_erase (client->out, 0, n);
+    }
+
+  client->out_watch = 0;
+  return FALSE;
+}
+
+static gboolean
+client_in_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+  ServerClient *client = data;
+  char buf[4096];
+  ssize_t n;
+  char *newline;
+
+  n = read (client->fd, buf, sizeof (buf));
+  if (n < 0 && (errno == EINTR || errno == EAGAIN))
+    return TRUE;
+  if (n <= 0)
+    {
+      client->in_watch = 0;
+      client_free (client);
+      return FALSE;
+    }
+
+  g_string_append_len (client->in, buf, n);
+
+  /* Handle every complete request we've got, in order */
+  while ((newline = memchr (client->in->str, '\n', client->in->len)))
+    {
+      char *line = g_strndup (client->in->str, newline - client->in->str);
+
+      g_string_erase (client->in, 0, newline - client->in->str + 1);
+      if (*g_strstrip (line))
+        handle_line (client, line);
+      g_free (line);
+    }
+
+  return TRUE;
+}
+
+static void
+client_free (ServerClient *client)
+{
+  clients = g_list_remove (clients, client);
+
+  client->closing = TRUE;
+  if (client->in_watch)
+    g_source_remove (client->in_watch);
+  if (client->out_watch)
+    g_source_remove (client->out_watch);
+  g_io_channel_unref (client->channel);
+  close (client->fd);
+  g_string_free (client->in, TRUE);
+  g_string_free (client->out, TRUE);
+  g_free (client);
+}
+
+static gboolean
+server_accept_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+  ServerClient *client;
+  int fd;
+
+  fd = accept (listen_fd, NULL, NULL);
+  if (fd < 0)
+    return TRUE;
+
+  fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+  fcntl (fd, F_SETFD, FD_CLOEXEC);
+
+  client = g_new0 (ServerClient, 1);
+  client->fd = fd;
+  client->channel = g_io_channel_unix_new (fd);
+  client->in = g_string_new (NULL);
+  client->out = g_string_new (NULL);
+  client->in_watch = g_io_add_watch (client->channel,
+                                     G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                     client_in_cb, client);
+  clients = g_list_append (clients, client);
+
+  return TRUE;
+}
+
+static void
+server_stop (void)
+{
+  if (socket_path)
+    unlink (socket_path);
+}
+
+/* TRUE if something is accepting connections on the socket at PATH */
+static gboolean
+socket_in_use (const char *path)
+{
+  struct sockaddr_un addr;
+  gboolean in_use;
+  int fd;
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return FALSE;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+  in_use = connect (fd, (struct sockaddr *)&addr, sizeof (addr)) == 0;
+
+  close (fd);
+  return in_use;
+}
+
+/* Listens for clients on the UNIX domain socket PATH.  A stale socket
+ * left behind at PATH is replaced, but one another server is still
+ * listening on, or any other file, is left alone. */
+gboolean
+bosh_server_start (const char *path, GError **error)
+{
+  struct sockaddr_un addr;
+  struct stat st;
+  GIOChannel *channel;
+  int save_errno;
+
+  if (strlen (path) >= sizeof (addr.sun_path))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NAMETOOLONG,
+                   _("Socket path \"%s\" is too long"), path);
+      return FALSE;
+    }
+
+  if (stat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+    {
+      if (socket_in_use (path))
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_EXIST,
+                       _("Another server is already listening on \"%s\""),
+                       path);
+          return FALSE;
+        }
+      unlink (path);
+    }
+
+  listen_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0)
+    goto error;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+
+  if (bind (listen_fd, (struct sockaddr *)&addr, sizeof (addr)) < 0
+      || listen (listen_fd, 16) < 0)
+    goto error;
+
+  fcntl (listen_fd, F_SETFD, FD_CLOEXEC);
+
+  socket_path = g_strdup (path);
+  atexit (server_stop);
+
+  if (!print_handler_installed)
+    {
+      saved_print_handler = g_set_print_handler (server_print);
+      print_handler_installed = TRUE;
+    }
+
+  channel = g_io_channel_unix_new (listen_fd);
+  g_io_add_watch (channel, G_IO_IN, server_accept_cb, NULL);
+  g_io_channel_unref (channel);
+
+  return TRUE;
+
+error:
+  save_errno = errno;
+  if (listen_fd >= 0)
+    close (listen_fd);
+  listen_fd = -1;
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
+               _("Can't listen on \"%s\": %s"), path,
+               g_strerror (save_errno));
+  return FALSE;
+}
+
+/* Called from the notify::state handler of every inferior */
+void
+bosh_server_state_changed (GSwatDebuggable *debuggable)
+{
+  JsonBuilder *builder;
+  JsonNode *root;
+  char *data;
+  GList *l;
+
+  if (!clients)
+    return;
+
+  builder = json_builder_new ();
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "jsonrpc");
+  json_builder_add_string_value (builder, "2.0");
+  json_builder_set_member_name (builder, "method");
+  json_builder_add_string_value (builder, "state-changed");
+  json_builder_set_member_name (builder, "params");
+  json_builder_add_value (builder, build_state (debuggable));
+  json_builder_end_object (builder);
+
+  root = json_builder_get_root (builder);
+  data = node_to_data (root);
+  for (l = clients; l; l = l->next)
+    client_send (l->data, data);
+
+  g_free (data);
+  json_node_free (root);
+  g_object_unref (builder);
+}
@@ -0,0 +1,556 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* In-memory snapshots of a range of target memory, for finding out
+ * what changed between two stops.
+ *
+ * A snapshot keeps a 64bit hash of each page of the range along with
+ * the page contents.  Pages are shared between snapshots (and within
+ * one) when their contents are identical, so repeatedly saving a
+ * mostly unchanged region is cheap.  Diffing re-reads the current
+ * memory and only looks at the bytes of pages whose hash differs.
+ * Pages whose hash matches are taken to be unchanged unless "set
+ * snapshot-verify" asks for them to be compared as well. */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "cli-decode.h"
+
+#include "bosh-commands.h"
+#include "bosh-memory.h"
+#include "bosh-output.h"
+#include "bosh-snapshot.h"
+
+#define SNAPSHOT_PAGE_SIZE 4096
+/* Memory is read this many pages at a time */
+#define SNAPSHOT_READ_PAGES 256
+/* Only this many changed ranges are listed by "snapshot diff" */
+#define SNAPSHOT_MAX_RANGES_SHOWN 200
+
+typedef struct _SnapshotPage
+{
+  guint64 hash;
+  guint ref_count;
+  gsize len;
+  guint8 data[1];
+} SnapshotPage;
+
+typedef struct _Snapshot
+{
+  char *name;
+  guint64 lo;
+  guint64 hi;
+  guint n_pages;
+  SnapshotPage **pages;
+} Snapshot;
+
+static struct cmd_list_element *snapshotlist;
+
+/* Whether "snapshot diff" compares pages whose hash is unchanged */
+static int snapshot_verify = 0;
+
+/* name -> Snapshot */
+static GHashTable *snapshots;
+/* hash -> SnapshotPage, for sharing identical pages */
+static GHashTable *page_store;
+
+/* XXH64 */
+
+#define PRIME64_1 G_GUINT64_CONSTANT (0x9E3779B185EBCA87)
+#define PRIME64_2 G_GUINT64_CONSTANT (0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 G_GUINT64_CONSTANT (0x165667B19E3779F9)
+#define PRIME64_4 G_GUINT64_CONSTANT (0x85EBCA77C2B2AE63)
+#define PRIME64_5 G_GUINT64_CONSTANT (0x27D4EB2F165667C5)
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline guint64
+read64 (const guint8 *p)
+{
+  guint64 v;
+  memcpy (&v, p, sizeof (v));
+  return GUINT64_FROM_LE (v);
+}
+
+static inline guint32
+read32 (const guint8 *p)
+{
+  guint32 v;
+  memcpy (&v, p, sizeof (v));
+  return GUINT32_FROM_LE (v);
+}
+
+static inline guint64
+hash_round (guint64 acc, guint64 input)
+{
+  acc += input * PRIME64_2;
+  acc = ROTL64 (acc, 31);
+  return acc * PRIME64_1;
+}
+
+static inline guint64
+hash_merge_round (guint64 acc, guint64 val)
+{
+  acc ^= hash_round (0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+/* The XXH64 hash of LEN bytes at DATA.  The four independent lanes of
+ * the main loop have no dependencies on each other so the compiler can
+ * keep them in separate registers (or vector lanes) and the loop runs
+ * at close to memory bandwidth. */
+guint64
+bosh_snapshot_hash (const void *data, gsize len, guint64 seed)
+{
+  const guint8 *p = data;
+  const guint8 *end = p + len;
+  guint64 h;
+
+  if (len >= 32)
+    {
+      const guint8 *limit = end - 32;
+      guint64 v1 = seed + PRIME64_1 + PRIME64_2;
+      guint64 v2 = seed + PRIME64_2;
+      guint64 v3 = seed;
+      guint64 v4 = seed - PRIME64_1;
+
+      do
+        {
+          v1 = hash_round (v1, read64 (p));
+          v2 = hash_round (v2, read64 (p + 8));
+          v3 = hash_round (v3, read64 (p + 16));
+          v4 = hash_round (v4, read64 (p + 24));
+          p += 32;
+        }
+      while (p <= limit);
+
+      h = ROTL64 (v1, 1) + ROTL64 (v2, 7) + ROTL64 (v3, 12) + ROTL64 (v4, 18);
+      h = hash_merge_round (h, v1);
+      h = hash_merge_round (h, v2);
+      h = hash_merge_round (h, v3);
+      h = hash_merge_round (h, v4);
+    }
+  else
+    h = seed + PRIME64_5;
+
+  h += len;
+
+  for (; p + 8 <= end; p += 8)
+    {
+      h ^= hash_round (0, read64 (p));
+      h = ROTL64 (h, 27) * PRIME64_1 + PRIME64_4;
+    }
+  if (p + 4 <= end)
+    {
+      h ^= (guint64)read32 (p) * PRIME64_1;
+      h = ROTL64 (h, 23) * PRIME64_2 + PRIME64_3;
+      p += 4;
+    }
+  for (; p < end; p++)
+    {
+      h ^= *p * PRIME64_5;
+      h = ROTL64 (h, 11) * PRIME64_1;
+    }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+static SnapshotPage *
+page_store_add (const guint8 *data, gsize len, guint64 hash)
+{
+  SnapshotPage *page = g_hash_table_lookup (page_store, &hash);
+
+  if (page && page->len == len && memcmp (page->data, data, len) == 0)
+    {
+      page->ref_count++;
+      return page;
+    }
+
+  page = g_malloc (G_STRUCT_OFFSET (SnapshotPage, data) + len);
+  page->hash = hash;
+  page->ref_count = 1;
+  page->len = len;
+  memcpy (page->data, data, len);
+
+  /* On the (unlikely) event of a collision with different contents the
+   * new page simply isn't shared */
+  if (!g_hash_table_lookup (page_store, &hash))
+    g_hash_table_insert (page_store, &page->hash, page);
+
+  return page;
+}
+
+static void
+page_store_unref (SnapshotPage *page)
+{
+  if (--page->ref_count)
+    return;
+
+  if (g_hash_table_lookup (page_store, &page->hash) == page)
+    g_hash_table_remove (page_store, &page->hash);
+  g_free (page);
+}
+
+static void
+snapshot_free (Snapshot *snapshot)
+{
+  guint i;
+
+  for (i = 0; i < snapshot->n_pages; i++)
+    if (snapshot->pages[i])
+      page_store_unref (snapshot->pages[i]);
+  g_free (snapshot->pages);
+  g_free (snapshot->name);
+  g_free (snapshot);
+}
+
+static gboolean
+parse_address (const char *str, guint64 *address)
+{
+  char *end;
+
+  *address = g_ascii_strtoull (str, &end, 0);
+  return end != str && *end == '\0';
+}
+
+static void
+bosh_snapshot_command (char *args, int from_tty)
+{
+  g_print (_("\"snapshot\" must be followed by the name of a snapshot "
+             "command.\n"));
+  help_list (snapshotlist, "snapshot ", -1, NULL);
+}
+
+/* snapshot save NAME LO HI */
+static void
+bosh_snapshot_save_command (char *args, int from_tty)
+{
+  char **argv = args ? g_strsplit_set (g_strstrip (args), " \t", -1) : NULL;
+  Snapshot *snapshot;
+  GError *error = NULL;
+  guint8 *buf;
+  guint64 lo;
+  guint64 hi;
+  guint64 address;
+  guint i;
+
+  if (!argv || g_strv_length (argv) != 3
+      || !parse_address (argv[1], &lo) || !parse_address (argv[2], &hi))
+    {
+      bosh_command_error_no_argument (_("NAME LO HI"));
+      g_strfreev (argv);
+      return;
+    }
+  if (hi <= lo)
+    {
+      g_print (_("Invalid memory address range (start >= end).\n"));
+      g_strfreev (argv);
+      return;
+    }
+
+  snapshot = g_new0 (Snapshot, 1);
+  snapshot->name = g_strdup (argv[0]);
+  snapshot->lo = lo;
+  snapshot->hi = hi;
+  snapshot->n_pages = (hi - lo + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE;
+  snapshot->pages = g_new0 (SnapshotPage *, snapshot->n_pages);
+  g_strfreev (argv);
+
+  buf = g_malloc (SNAPSHOT_PAGE_SIZE * SNAPSHOT_READ_PAGES);
+  for (address = lo, i = 0; address < hi; )
+    {
+      gsize len = MIN (hi - address, SNAPSHOT_PAGE_SIZE * SNAPSHOT_READ_PAGES);
+      gsize offset;
+
+      if (!bosh_memory_read (address, buf, len, &error))
+        {
+          g_print ("%s\n", error->message);
+          g_error_free (error);
+          g_free (buf);
+          snapshot_free (snapshot);
+          return;
+        }
+
+      for (offset = 0; offset < len; offset += SNAPSHOT_PAGE_SIZE, i++)
+        {
+          gsize page_len = MIN (len - offset, SNAPSHOT_PAGE_SIZE);
+          guint64 hash = bosh_snapshot_hash (buf + offset, page_len, 0);
+          snapshot->pages[i] = page_store_add (buf + offset, page_len, hash);
+        }
+      address += len;
+    }
+  g_free (buf);
+
+  /* Replacing an existing snapshot frees it */
+  g_hash_table_replace (snapshots, snapshot->name, snapshot);
+
+  g_print (_("Saved snapshot \"%s\" of 0x%" G_GINT64_MODIFIER "x-"
+             "0x%" G_GINT64_MODIFIER "x (%u pages, %u stored in total).\n"),
+           snapshot->name, lo, hi, snapshot->n_pages,
+           g_hash_table_size (page_store));
+}
+
+typedef struct _DiffState
+{
+  guint64 range_start;
+  guint64 range_end;
+  guint n_ranges;
+  guint64 changed_bytes;
+} DiffState;
+
+static void
+diff_flush_range (DiffState *state)
+{
+  if (state->range_end == state->range_start)
+    return;
+
+  if (state->n_ranges < SNAPSHOT_MAX_RANGES_SHOWN)
+    g_print ("  0x%" G_GINT64_MODIFIER "x-0x%" G_GINT64_MODIFIER "x "
+             "(%" G_GUINT64_FORMAT " bytes)\n",
+             state->range_start, state->range_end,
+             state->range_end - state->range_start);
+  state->n_ranges++;
+  state->changed_bytes += state->range_end - state->range_start;
+  state->range_start = state->range_end = 0;
+}
+
+/* Record the bytes that differ between OLD and NEW, which are LEN
+ * bytes of memory at ADDRESS, merging ranges that touch */
+static void
+diff_page (DiffState *state, guint64 address,
+           const guint8 *old, const guint8 *new, gsize len)
+{
+  gsize i = 0;
+
+  while (i < len)
+    {
+      gsize start;
+
+      if (old[i] == new[i])
+        {
+          i++;
+          continue;
+        }
+      for (start = i; i < len && old[i] != new[i]; i++)
+        ;
+
+      if (state->range_end != address + start)
+        {
+          diff_flush_range (state);
+          state->range_start = address + start;
+        }
+      state->range_end = address + i;
+    }
+}
+
+/* snapshot diff NAME */
+static void
+bosh_snapshot_diff_command (char *args, int from_tty)
+{
+  Snapshot *snapshot;
+  DiffState state = { 0, };
+  GError *error = NULL;
+  GTimer *timer;
+  guint8 *buf;
+  guint64 address;
+  guint changed_pages = 0;
+  guint i;
+
+  if (!args || !*g_strstrip (args))
+    {
+      bosh_command_error_no_argument (_("snapshot name"));
+      return;
+    }
+
+  snapshot = g_hash_table_lookup (snapshots, args);
+  if (!snapshot)
+    {
+      g_print (_("No snapshot named \"%s\".\n"), args);
+      return;
+    }
+
+  timer = g_timer_new ();
+  buf = g_malloc (SNAPSHOT_PAGE_SIZE * SNAPSHOT_READ_PAGES);
+  for (address = snapshot->lo, i = 0; address < snapshot->hi; )
+    {
+      gsize len = MIN (snapshot->hi - address,
+                       SNAPSHOT_PAGE_SIZE * SNAPSHOT_READ_PAGES);
+      gsize offset;
+
+      if (!bosh_memory_read (address, buf, len, &error))
+        {
+          diff_flush_range (&state);
+          g_print ("%s\n", error->message);
+          g_error_free (error);
+          break;
+        }
+
+      for (offset = 0; offset < len; offset += SNAPSHOT_PAGE_SIZE, i++)
+        {
+          SnapshotPage *page = snapshot->pages[i];
+
+          if (bosh_snapshot_hash (buf + offset, page->len, 0) == page->hash
+              && (!snapshot_verify
+                  || memcmp (buf + offset, page->data, page->len) == 0))
+            continue;
+
+          changed_pages++;
+          diff_page (&state, address + offset,
+                     page->data, buf + offset, page->len);
+        }
+      address += len;
+    }
+  diff_flush_range (&state);
+  g_free (buf);
+
+  if (state.n_ranges > SNAPSHOT_MAX_RANGES_SHOWN)
+    g_print (_("  ... and %u more ranges\n"),
+             state.n_ranges - SNAPSHOT_MAX_RANGES_SHOWN);
+  g_print (_("%u of %u pages changed, %" G_GUINT64_FORMAT " bytes in %u "
+             "ranges (%.1f ms).\n"),
+           changed_pages, snapshot->n_pages, state.changed_bytes,
+           state.n_ranges, g_timer_elapsed (timer, NULL) * 1000);
+  g_timer_destroy (timer);
+}
+
+static void
+bosh_snapshot_delete_command (char *args, int from_tty)
+{
+  if (!args || !*g_strstrip (args))
+    {
+      bosh_command_error_no_argument (_("snapshot name"));
+      return;
+    }
+  if (!g_hash_table_remove (snapshots, args))
+    g_print (_("No snapshot named \"%s\".\n"), args);
+}
+
+static void
+print_snapshot (gpointer key, gpointer value, gpointer user_data)
+{
+  Snapshot *snapshot = value;
+
+  bosh_output_begin_record ("snapshot");
+  bosh_output_field_fmt ("name", "%-16s", snapshot->name);
+  bosh_output_text (" ");
+  bosh_output_field_fmt ("start", "0x%016" G_GINT64_MODIFIER "x",
+                         snapshot->lo);
+  bosh_output_text (" ");
+  bosh_output_field_fmt ("end", "0x%016" G_GINT64_MODIFIER "x",
+                         snapshot->hi);
+  bosh_output_text (" ");
+  bosh_output_field_fmt ("pages", "%8u", snapshot->n_pages);
+  bosh_output_text ("\n");
+  bosh_output_end_record ();
+}
+
+static void
+show_snapshot_verify (GIOChannel *file, int from_tty,
+                      struct cmd_list_element *c, const char *value)
+{
+  g_print (_("Whether snapshot diff compares pages with an unchanged hash "
+             "is %s.\n"), value);
+}
+
+static void
+bosh_info_snapshots_command (char *args, int from_tty)
+{
+  if (g_hash_table_size (snapshots) == 0)
+    {
+      g_print (_("No snapshots.\n"));
+      return;
+    }
+
+  bosh_output_text ("%-16s %-18s %-18s %8s\n", _("Name"), _("Start"),
+                    _("End"), _("Pages"));
+  bosh_output_begin_list ("snapshots");
+  g_hash_table_foreach (snapshots, print_snapshot, NULL);
+  bosh_output_end_list ();
+  bosh_output_text (_("%u distinct pages stored.\n"),
+                    g_hash_table_size (page_store));
+}
+
+void
+bosh_snapshot_init_commands (void)
+{
+  struct cmd_list_element *c;
+
+  snapshots = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                     (GDestroyNotify)snapshot_free);
+  page_store = g_hash_table_new (g_int64_hash, g_int64_equal);
+
+  bosh_command_list_add_prefix (&cmdlist, "snapshot", class_vars,
+                                bosh_snapshot_command,
+                                _("Save and compare snapshots of target "
+                                  "memory."),
+                                &snapshotlist, "snapshot ", 0);
+
+  bosh_command_list_add (&snapshotlist, "save", class_vars,
+                         bosh_snapshot_save_command,
+                         _("Save a snapshot of memory: snapshot save NAME "
+                           "LO HI.\n"
+                           "The memory in the range [LO .. HI) is saved "
+                           "under NAME, replacing any\n"
+                           "earlier snapshot of that name.  Pages that are "
+                           "identical to pages\n"
+                           "already saved are shared rather than copied."));
+
+  bosh_command_list_add (&snapshotlist, "diff", class_vars,
+                         bosh_snapshot_diff_command,
+                         _("Compare memory with a snapshot: snapshot diff "
+                           "NAME.\n"
+                           "The range saved as NAME is read again and the "
+                           "byte ranges that have\n"
+                           "changed since are listed."));
+
+  bosh_command_list_add (&snapshotlist, "delete", class_vars,
+                         bosh_snapshot_delete_command,
+                         _("Delete the snapshot NAME."));
+
+  add_setshow_boolean_cmd ("snapshot-verify", class_vars, &snapshot_verify,
+                           _("Set whether snapshot diff compares pages with "
+                             "an unchanged hash."),
+                           _("Show whether snapshot diff compares pages with "
+                             "an unchanged hash."),
+                           _("By default a page whose 64bit hash matches the "
+                             "snapshot is taken to be\n"
+                             "unchanged.  If set, such pages are compared "
+                             "byte by byte as well, which\n"
+                             "rules out missing a change to a hash collision "
+                             "but makes diffing\n"
+                             "a mostly unchanged range a lot slower."),
+                           NULL,
+                           show_snapshot_verify,
+                           &setlist, &showlist);
+
+  c = bosh_add_info_command ("snapshots", bosh_info_snapshots_command,
+                             _("Saved memory snapshots."));
+  c->flags |= CMD_RUNS_WHILE_BUSY;
+}
@@ -0,0 +1,32 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_SNAPSHOT_H
+#define BOSH_SNAPSHOT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+guint64 bosh_snapshot_hash (const void *data, gsize len, guint64 seed);
+
+void bosh_snapshot_init_commands (void);
+
+G_END_DECLS
+
+#endif /* BOSH_SNAPSHOT_H */
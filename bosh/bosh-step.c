@@ -0,0 +1,641 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Counted and conditional stepping, i.e. "next N", "step N",
+ * "step-until EXPR" and "next-until LOCATION".
+ *
+ * Each stop of the target is seen through the debuggable's
+ * notify::state, and while a count is in progress we swallow the stop
+ * and issue the next step from an idle handler instead of giving back
+ * the prompt.  Nothing is rendered for the intermediate stops; the
+ * final location is printed once the loop is over and then the
+ * journal, batch and prompt handling are told about the final stop, so
+ * they see a single stop for the whole command.  Listeners that have
+ * already seen every stop (the server and pause accounting) aren't
+ * told again. */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib-object.h>
+#include <glib/gi18n.h>
+
+#include <gswat/gswat.h>
+
+#include "cli-decode.h"
+
+#include "bosh-commands.h"
+#include "bosh-main.h"
+#include "bosh-step.h"
+#include "bosh-utils.h"
+
+typedef struct _BoshStepLoop
+{
+  GSwatDebuggable *debuggable;
+  BoshStepKind kind;
+  /* The number of steps to take, or 0 to keep going until UNTIL is
+   * satisfied */
+  guint count;
+  BoshStepUntilFunc until;
+  gpointer until_data;
+  GDestroyNotify until_destroy;
+  gboolean met;
+  /* Stops seen so far */
+  guint done;
+  /* The stack depth at the last stop; see step_stopped_early() */
+  guint depth;
+  gboolean stopped_early;
+  gboolean cancelled;
+  gboolean exited;
+  guint idle_id;
+  GTimer *timer;
+} BoshStepLoop;
+
+static BoshStepLoop *step_loop;
+
+static guint
+get_stack_depth (GSwatDebuggable *debuggable)
+{
+  GQueue *stack = gswat_debuggable_get_stack (debuggable);
+  guint depth = g_queue_get_length (stack);
+
+  gswat_debuggable_stack_free (stack);
+  return depth;
+}
+
+/* Whether the target stopped somewhere a "next" or "step" wouldn't
+ * have taken it, i.e. at a breakpoint or signal in a callee.  gswat
+ * doesn't tell us why the target stopped, so this goes by the stack
+ * depth, which is checked at every stop: a "next" never ends up deeper
+ * than the frame it's stepping through, and a "step" at most one frame
+ * deeper, in the function it stepped into.  After returning to a
+ * caller, the caller becomes the frame we're stepping through. */
+static gboolean
+step_stopped_early (BoshStepLoop *loop)
+{
+  guint depth = get_stack_depth (loop->debuggable);
+  guint limit = loop->depth + (loop->kind == BOSH_STEP_STEP ? 1 : 0);
+
+  if (depth > limit)
+    return TRUE;
+
+  if (loop->kind == BOSH_STEP_STEP || depth < loop->depth)
+    loop->depth = depth;
+  return FALSE;
+}
+
+static void
+step_issue (BoshStepLoop *loop)
+{
+  if (loop->kind == BOSH_STEP_NEXT)
+    gswat_debuggable_next (loop->debuggable);
+  else
+    gswat_debuggable_step (loop->debuggable);
+}
+
+static gboolean
+step_continue_idle (gpointer data)
+{
+  BoshStepLoop *loop = data;
+
+  loop->idle_id = 0;
+  step_issue (loop);
+  return FALSE;
+}
+
+static void
+step_print_location (GSwatDebuggable *debuggable)
+{
+  char *uri = gswat_debuggable_get_source_uri (debuggable);
+  gint line = gswat_debuggable_get_source_line (debuggable);
+
+  if (uri)
+    {
+      bosh_utils_print_file_range (uri, line, line);
+      g_free (uri);
+    }
+
+  bosh_utils_print_current_frame (debuggable);
+}
+
+static gboolean
+step_finish_idle (gpointer data)
+{
+  BoshStepLoop *loop = data;
+  gdouble elapsed = g_timer_elapsed (loop->timer, NULL);
+  const char *what = loop->kind == BOSH_STEP_NEXT ? "next" : "step";
+
+  step_loop = NULL;
+
+  if (!loop->exited)
+    step_print_location (loop->debuggable);
+
+  if (loop->until && !loop->met)
+    g_print (_("Stopped after %u %s commands before the condition was "
+               "met.\n"), loop->done, what);
+  else if (loop->done < loop->count)
+    g_print (_("Stopped after %u of %u %s commands.\n"),
+             loop->done, loop->count, what);
+  g_print (_("%u steps in %.3f seconds (%.0f steps/s).\n"),
+           loop->done, elapsed,
+           elapsed > 0 ? loop->done / elapsed : 0.0);
+
+  /* Now let the usual state handling see the final stop */
+  bosh_main_step_finished (loop->debuggable);
+
+  if (loop->until_destroy)
+    loop->until_destroy (loop->until_data);
+  g_object_unref (loop->debuggable);
+  g_timer_destroy (loop->timer);
+  g_free (loop);
+  return FALSE;
+}
+
+static void
+step_finish (BoshStepLoop *loop)
+{
+  if (loop->idle_id)
+    g_source_remove (loop->idle_id);
+  loop->idle_id = g_idle_add (step_finish_idle, loop);
+}
+
+static void
+step_loop_start (BoshStepLoop *loop,
+                 GSwatDebuggable *debuggable,
+                 BoshStepKind kind)
+{
+  loop->debuggable = g_object_ref (debuggable);
+  loop->kind = kind;
+  loop->depth = get_stack_depth (debuggable);
+  loop->timer = g_timer_new ();
+  step_loop = loop;
+
+  step_issue (loop);
+}
+
+/* Run COUNT "next" or "step" commands as one.  A COUNT of 1 is just
+ * passed straight on to the debuggable. */
+void
+bosh_step_start (GSwatDebuggable *debuggable,
+                 BoshStepKind kind,
+                 guint count)
+{
+  BoshStepLoop *loop;
+
+  g_return_if_fail (step_loop == NULL);
+
+  if (count == 0)
+    return;
+
+  if (count == 1)
+    {
+      if (kind == BOSH_STEP_NEXT)
+        gswat_debuggable_next (debuggable);
+      else
+        gswat_debuggable_step (debuggable);
+      return;
+    }
+
+  loop = g_new0 (BoshStepLoop, 1);
+  loop->count = count;
+  step_loop_start (loop, debuggable, kind);
+}
+
+/* Keep stepping until UNTIL returns TRUE for a stop, the target exits
+ * or the user interrupts.  DESTROY is called on DATA once we're done. */
+void
+bosh_step_start_until (GSwatDebuggable *debuggable,
+                       BoshStepKind kind,
+                       BoshStepUntilFunc until,
+                       gpointer data,
+                       GDestroyNotify destroy)
+{
+  BoshStepLoop *loop;
+
+  g_return_if_fail (step_loop == NULL);
+
+  loop = g_new0 (BoshStepLoop, 1);
+  loop->until = until;
+  loop->until_data = data;
+  loop->until_destroy = destroy;
+  step_loop_start (loop, debuggable, kind);
+}
+
+/* While this is TRUE stops shouldn't be rendered; the final location
+ * is printed when the loop finishes. */
+gboolean
+bosh_step_is_active (void)
+{
+  return step_loop != NULL;
+}
+
+/* Stop at the end of the current step, e.g. for Ctrl-C */
+void
+bosh_step_cancel (void)
+{
+  BoshStepLoop *loop = step_loop;
+
+  if (!loop || loop->cancelled)
+    return;
+
+  loop->cancelled = TRUE;
+
+  /* If we're between steps there's no stop coming to finish on */
+  if (loop->idle_id)
+    step_finish (loop);
+}
+
+/* Called from the debuggable's notify::state handler.  Returns TRUE if
+ * the state change belongs to a counted step that's still going, in
+ * which case nothing else should act on it. */
+gboolean
+bosh_step_state_changed (GSwatDebuggable *debuggable)
+{
+  BoshStepLoop *loop = step_loop;
+  GSwatDebuggableState state;
+
+  if (!loop || loop->debuggable != debuggable)
+    return FALSE;
+
+  state = gswat_debuggable_get_state (debuggable);
+  if (state == GSWAT_DEBUGGABLE_RUNNING)
+    return TRUE;
+
+  /* Already finishing, e.g. cancelled between steps */
+  if (loop->idle_id && (loop->cancelled || loop->exited))
+    return TRUE;
+
+  if (state == GSWAT_DEBUGGABLE_DISCONNECTED)
+    {
+      loop->exited = TRUE;
+      step_finish (loop);
+      return TRUE;
+    }
+
+  loop->done++;
+
+  if (step_stopped_early (loop))
+    loop->stopped_early = TRUE;
+
+  if (loop->until && loop->until (debuggable, loop->until_data))
+    loop->met = TRUE;
+
+  if ((loop->done < loop->count || (loop->until && !loop->met))
+      && !loop->stopped_early
+      && !loop->cancelled)
+    loop->idle_id = g_idle_add (step_continue_idle, loop);
+  else
+    step_finish (loop);
+
+  return TRUE;
+}
+
+/* step-until EXPR
+ *
+ * gswat can't evaluate expressions for us yet, so the conditions are
+ * limited to what the innermost frame tells us: "NAME", meaning NAME is
+ * nonzero, or "NAME OP VALUE" with OP one of == != < <= > >=.  NAME is
+ * an argument of the frame, or $function, $file or $line.  Values are
+ * compared as numbers if they both look like one, else as strings. */
+
+typedef struct _StepUntilExpr
+{
+  char *name;
+  char *op;
+  char *value;
+} StepUntilExpr;
+
+static void
+step_until_expr_free (gpointer data)
+{
+  StepUntilExpr *expr = data;
+
+  g_free (expr->name);
+  g_free (expr->op);
+  g_free (expr->value);
+  g_free (expr);
+}
+
+static StepUntilExpr *
+step_until_expr_parse (const char *text)
+{
+  StepUntilExpr *expr = g_new0 (StepUntilExpr, 1);
+  const char *op;
+  int op_len = 0;
+
+  /* Find the first of == != <= >= < > */
+  for (op = text; *op; op++)
+    {
+      if (strchr ("=!<>", *op) && op[1] == '=')
+        op_len = 2;
+      else if (*op == '<' || *op == '>')
+        op_len = 1;
+      if (op_len)
+        break;
+    }
+
+  if (!op_len)
+    {
+      expr->name = g_strstrip (g_strdup (text));
+      return expr;
+    }
+
+  expr->name = g_strstrip (g_strndup (text, op - text));
+  expr->op = g_strndup (op, op_len);
+  expr->value = g_strstrip (g_strdup (op + op_len));
+
+  if (!*expr->name || !*expr->value)
+    {
+      step_until_expr_free (expr);
+      return NULL;
+    }
+  return expr;
+}
+
+static char *
+step_until_lookup (GSwatDebuggableFrame *frame, const char *name)
+{
+  GList *l;
+
+  if (strcmp (name, "$function") == 0)
+    return g_strdup (frame->function);
+  if (strcmp (name, "$line") == 0)
+    return g_strdup_printf ("%d", frame->line);
+  if (strcmp (name, "$file") == 0)
+    return frame->source_uri ? g_path_get_basename (frame->source_uri)
+                             : NULL;
+
+  for (l = frame->arguments; l; l = l->next)
+    {
+      GSwatDebuggableFrameArgument *arg = l->data;
+      if (strcmp (arg->name, name) == 0)
+        return g_strdup (arg->value);
+    }
+  return NULL;
+}
+
+static gboolean
+parse_number (const char *text, gint64 *number)
+{
+  char *end;
+
+  *number = g_ascii_strtoll (text, &end, 0);
+  return end != text && *end == '\0';
+}
+
+static gboolean
+step_until_expr_check (GSwatDebuggable *debuggable, gpointer data)
+{
+  StepUntilExpr *expr = data;
+  GQueue *stack = gswat_debuggable_get_stack (debuggable);
+  char *value = NULL;
+  gint64 a, b;
+  int cmp;
+  gboolean result = FALSE;
+
+  if (stack->head)
+    value = step_until_lookup (stack->head->data, expr->name);
+  gswat_debuggable_stack_free (stack);
+
+  if (!value)
+    return FALSE;
+
+  if (!expr->op)
+    {
+      result = parse_number (value, &a) ? a != 0 : *value != '\0';
+      g_free (value);
+      return result;
+    }
+
+  if (parse_number (value, &a) && parse_number (expr->value, &b))
+    cmp = (a > b) - (a < b);
+  else
+    cmp = strcmp (value, expr->value);
+  g_free (value);
+
+  if (strcmp (expr->op, "==") == 0)
+    result = cmp == 0;
+  else if (strcmp (expr->op, "!=") == 0)
+    result = cmp != 0;
+  else if (strcmp (expr->op, "<") == 0)
+    result = cmp < 0;
+  else if (strcmp (expr->op, "<=") == 0)
+    result = cmp <= 0;
+  else if (strcmp (expr->op, ">") == 0)
+    result = cmp > 0;
+  else if (strcmp (expr->op, ">=") == 0)
+    result = cmp >= 0;
+
+  return result;
+}
+
+/* next-until LOCATION, where LOCATION is FILE:LINE or just LINE in the
+ * current file. */
+
+typedef struct _StepUntilLocation
+{
+  char *file;
+  int line;
+} StepUntilLocation;
+
+static void
+step_until_location_free (gpointer data)
+{
+  StepUntilLocation *location = data;
+
+  g_free (location->file);
+  g_free (location);
+}
+
+/* Does the source URI name FILE?  FILE may be a basename or any
+ * trailing part of the path. */
+static gboolean
+uri_matches_file (const char *uri, const char *file)
+{
+  char *path = g_filename_from_uri (uri, NULL, NULL);
+  gboolean match = FALSE;
+
+  if (!path)
+    return FALSE;
+
+  if (g_path_is_absolute (file))
+    match = strcmp (path, file) == 0;
+  else
+    {
+      size_t path_len = strlen (path);
+      size_t file_len = strlen (file);
+
+      match = (path_len == file_len && strcmp (path, file) == 0)
+        || (path_len > file_len
+            && path[path_len - file_len - 1] == G_DIR_SEPARATOR
+            && strcmp (path + path_len - file_len, file) == 0);
+    }
+
+  g_free (path);
+  return match;
+}
+
+static gboolean
+step_until_location_check (GSwatDebuggable *debuggable, gpointer data)
+{
+  StepUntilLocation *location = data;
+  char *uri;
+  gboolean match;
+
+  if (gswat_debuggable_get_source_line (debuggable) != location->line)
+    return FALSE;
+
+  uri = gswat_debuggable_get_source_uri (debuggable);
+  if (!uri)
+    return FALSE;
+  match = uri_matches_file (uri, location->file);
+  g_free (uri);
+
+  return match;
+}
+
+static GSwatDebuggable *
+get_interrupted_debuggable (const char *command)
+{
+  GSwatDebuggable *debuggable = bosh_get_default_debuggable ();
+
+  if (!debuggable)
+    {
+      g_print ("Ignoring %s: No debugging session has been set up yet\n",
+               command);
+      return NULL;
+    }
+  if (gswat_debuggable_get_state (debuggable)
+      != GSWAT_DEBUGGABLE_INTERRUPTED)
+    {
+      g_print ("Ignoring %s command while not interrupted\n", command);
+      return NULL;
+    }
+  return debuggable;
+}
+
+static void
+bosh_step_until_command (char *args, int from_tty)
+{
+  GSwatDebuggable *debuggable;
+  StepUntilExpr *expr;
+
+  if (!args || !*args)
+    {
+      bosh_command_error_no_argument (_("expression to stop at"));
+      return;
+    }
+
+  debuggable = get_interrupted_debuggable ("step-until");
+  if (!debuggable)
+    return;
+
+  expr = step_until_expr_parse (args);
+  if (!expr)
+    {
+      g_print (_("Can't parse the condition \"%s\".\n"), args);
+      return;
+    }
+
+  bosh_step_start_until (debuggable, BOSH_STEP_STEP,
+                         step_until_expr_check, expr,
+                         step_until_expr_free);
+}
+
+static void
+bosh_next_until_command (char *args, int from_tty)
+{
+  GSwatDebuggable *debuggable;
+  StepUntilLocation *location;
+  char *colon;
+  char *line;
+  char *end;
+
+  if (!args || !*args)
+    {
+      bosh_command_error_no_argument (_("location to stop at"));
+      return;
+    }
+
+  debuggable = get_interrupted_debuggable ("next-until");
+  if (!debuggable)
+    return;
+
+  location = g_new0 (StepUntilLocation, 1);
+
+  args = g_strstrip (args);
+  colon = strrchr (args, ':');
+  if (colon)
+    {
+      location->file = g_strndup (args, colon - args);
+      line = colon + 1;
+    }
+  else
+    {
+      char *uri = gswat_debuggable_get_source_uri (debuggable);
+
+      location->file = uri ? g_filename_from_uri (uri, NULL, NULL) : NULL;
+      g_free (uri);
+      line = args;
+    }
+
+  location->line = strtol (line, &end, 10);
+  if (end == line || *end != '\0' || location->line <= 0
+      || !location->file || !*location->file)
+    {
+      g_print (_("Can't parse the location \"%s\"; "
+                 "expected FILE:LINE or LINE.\n"), args);
+      step_until_location_free (location);
+      return;
+    }
+
+  bosh_step_start_until (debuggable, BOSH_STEP_NEXT,
+                         step_until_location_check, location,
+                         step_until_location_free);
+}
+
+void
+bosh_step_init_commands (void)
+{
+  bosh_add_command ("step-until", class_run, bosh_step_until_command,
+                    _("Step program until a condition becomes true.\n"
+                      "Usage: step-until NAME [OP VALUE]\n"
+                      "\n"
+                      "NAME is an argument of the current frame, or one of "
+                      "$function, $file\n"
+                      "and $line.  OP is one of == != < <= > >=; without "
+                      "one, stepping stops\n"
+                      "when NAME is nonzero.  Nothing is printed until "
+                      "the condition is met,\n"
+                      "the program stops for another reason or you type "
+                      "Control-C."));
+
+  bosh_add_command ("next-until", class_run, bosh_next_until_command,
+                    _("Step program, proceeding through subroutine calls, "
+                      "until a location is\n"
+                      "reached.\n"
+                      "Usage: next-until FILE:LINE\n"
+                      "       next-until LINE\n"
+                      "\n"
+                      "Nothing is printed until the location is reached, "
+                      "the program stops\n"
+                      "for another reason or you type Control-C."));
+}
@@ -0,0 +1,52 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_STEP_H
+#define BOSH_STEP_H
+
+#include <glib.h>
+#include <gswat/gswat.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  BOSH_STEP_NEXT,
+  BOSH_STEP_STEP
+} BoshStepKind;
+
+typedef gboolean (*BoshStepUntilFunc) (GSwatDebuggable *debuggable,
+                                       gpointer data);
+
+void bosh_step_start (GSwatDebuggable *debuggable,
+                      BoshStepKind kind,
+                      guint count);
+void bosh_step_start_until (GSwatDebuggable *debuggable,
+                            BoshStepKind kind,
+                            BoshStepUntilFunc until,
+                            gpointer data,
+                            GDestroyNotify destroy);
+gboolean bosh_step_is_active (void);
+void bosh_step_cancel (void);
+
+gboolean bosh_step_state_changed (GSwatDebuggable *debuggable);
+
+void bosh_step_init_commands (void);
+
+G_END_DECLS
+
+#endif /* BOSH_STEP_H */
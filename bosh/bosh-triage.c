@@ -0,0 +1,333 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Bulk crash triage.
+ *
+ * Every file in a directory is treated as a core file for the given
+ * executable.  Each core is loaded by its own batch gdb process, driven
+ * from a bounded pool of worker threads, and only the innermost frames
+ * of the crashing thread's backtrace are read back.  Those frames are
+ * normalized into a signature (function names only; addresses,
+ * arguments and source positions are stripped) and cores with the same
+ * signature are counted together. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "bosh-triage.h"
+
+#define BOSH_TRIAGE_DEFAULT_DEPTH 5
+
+typedef struct _BoshTriageBucket
+{
+  char *signature;
+  guint count;
+  char *example;
+} BoshTriageBucket;
+
+typedef struct _BoshTriage
+{
+  BoshTriageOptions *options;
+
+  GMutex *lock;
+  GHashTable *buckets;
+  guint n_triaged;
+  guint n_failed;
+} BoshTriage;
+
+static void
+triage_child_setup (gpointer data)
+{
+  BoshTriage *triage = data;
+  struct rlimit limit;
+
+  if (triage->options->mem_limit <= 0)
+    return;
+
+  limit.rlim_cur = limit.rlim_max =
+    (rlim_t)triage->options->mem_limit * 1024 * 1024;
+  setrlimit (RLIMIT_AS, &limit);
+}
+
+/* Reduce one line of gdb backtrace output, such as:
+ *   #0  0x00007f3a5c1e2d45 in raise () from /lib/libc.so.6
+ *   #3  main (argc=1, argv=0x7ffd5e0c) at main.c:12
+ * to just the function name. Returns NULL if LINE isn't a frame. */
+static char *
+normalize_frame (const char *line)
+{
+  const char *p = line;
+  const char *end;
+
+  if (*p != '#')
+    return NULL;
+
+  /* Skip the frame number */
+  p++;
+  while (g_ascii_isdigit (*p))
+    p++;
+  while (*p == ' ')
+    p++;
+
+  /* Skip the pc address, which is only shown for frames that aren't at
+   * the start of a line */
+  if (p[0] == '0' && p[1] == 'x')
+    {
+      p += 2;
+      while (g_ascii_isxdigit (*p))
+        p++;
+      if (strncmp (p, " in ", 4) == 0)
+        p += 4;
+    }
+
+  if (*p == '<')
+    {
+      /* e.g. <signal handler called> */
+      end = strchr (p, '>');
+      return end ? g_strndup (p, end - p + 1) : g_strdup (p);
+    }
+
+  /* NB: demangled C++ names may contain parentheses but gdb always puts
+   * a space before the argument list. */
+  end = strstr (p, " (");
+  if (!end)
+    end = p + strcspn (p, " \n");
+
+  if (end == p)
+    return g_strdup ("??");
+
+  return g_strndup (p, end - p);
+}
+
+static char *
+triage_core_signature (BoshTriage *triage, const char *core, GError **error)
+{
+  BoshTriageOptions *options = triage->options;
+  char *bt_command = g_strdup_printf ("bt %d", options->depth);
+  char *argv[] = {
+      "gdb", "-nx", "-batch",
+      "-ex", "set width 0",
+      "-ex", bt_command,
+      (char *)options->executable,
+      (char *)core,
+      NULL
+  };
+  GString *signature;
+  GPid pid;
+  int fd_out;
+  FILE *output;
+  char line[4096];
+  int frames = 0;
+  int status;
+
+  if (!g_spawn_async_with_pipes (NULL, argv, NULL,
+                                 G_SPAWN_SEARCH_PATH
+                                 | G_SPAWN_STDERR_TO_DEV_NULL
+                                 | G_SPAWN_DO_NOT_REAP_CHILD,
+                                 triage_child_setup, triage,
+                                 &pid, NULL, &fd_out, NULL, error))
+    {
+      g_free (bt_command);
+      return NULL;
+    }
+  g_free (bt_command);
+
+  /* We only keep the normalized frames around; everything else gdb
+   * prints is discarded a line at a time. */
+  signature = g_string_new ("");
+  output = fdopen (fd_out, "r");
+  while (frames < options->depth && fgets (line, sizeof (line), output))
+    {
+      char *function = normalize_frame (line);
+      if (!function)
+        continue;
+      if (frames++)
+        g_string_append_c (signature, ';');
+      g_string_append (signature, function);
+      g_free (function);
+    }
+  fclose (output);
+
+  while (waitpid (pid, &status, 0) == -1 && errno == EINTR)
+    ;
+  g_spawn_close_pid (pid);
+
+  if (frames == 0)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("No backtrace found in %s"), core);
+      g_string_free (signature, TRUE);
+      return NULL;
+    }
+
+  return g_string_free (signature, FALSE);
+}
+
+static void
+triage_core (gpointer data, gpointer user_data)
+{
+  char *core = data;
+  BoshTriage *triage = user_data;
+  BoshTriageBucket *bucket;
+  GError *error = NULL;
+  char *signature;
+
+  signature = triage_core_signature (triage, core, &error);
+
+  g_mutex_lock (triage->lock);
+  if (!signature)
+    {
+      g_printerr ("%s: %s\n", core, error->message);
+      g_error_free (error);
+      triage->n_failed++;
+      g_mutex_unlock (triage->lock);
+      g_free (core);
+      return;
+    }
+
+  bucket = g_hash_table_lookup (triage->buckets, signature);
+  if (!bucket)
+    {
+      bucket = g_slice_new (BoshTriageBucket);
+      bucket->signature = signature;
+      bucket->count = 0;
+      bucket->example = core;
+      g_hash_table_insert (triage->buckets, signature, bucket);
+    }
+  else
+    {
+      g_free (signature);
+      g_free (core);
+    }
+  bucket->count++;
+  triage->n_triaged++;
+  g_mutex_unlock (triage->lock);
+}
+
+static void
+triage_bucket_free (gpointer data)
+{
+  BoshTriageBucket *bucket = data;
+  g_free (bucket->signature);
+  g_free (bucket->example);
+  g_slice_free (BoshTriageBucket, bucket);
+}
+
+static gint
+compare_buckets (gconstpointer a, gconstpointer b)
+{
+  const BoshTriageBucket *bucket_a = a;
+  const BoshTriageBucket *bucket_b = b;
+
+  if (bucket_a->count != bucket_b->count)
+    return bucket_a->count > bucket_b->count ? -1 : 1;
+  return strcmp (bucket_a->signature, bucket_b->signature);
+}
+
+int
+bosh_triage_run (BoshTriageOptions *options)
+{
+  BoshTriage triage;
+  GThreadPool *pool;
+  GDir *dir;
+  const char *name;
+  GList *buckets, *l;
+  GTimer *timer;
+  GError *error = NULL;
+  double elapsed;
+
+  if (!options->executable)
+    {
+      g_printerr (_("Triage requires an executable (-e EXE)\n"));
+      return 1;
+    }
+  if (options->jobs <= 0)
+    options->jobs = MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+  if (options->depth <= 0)
+    options->depth = BOSH_TRIAGE_DEFAULT_DEPTH;
+
+  dir = g_dir_open (options->directory, 0, &error);
+  if (!dir)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return 1;
+    }
+
+  triage.options = options;
+  triage.lock = g_mutex_new ();
+  triage.buckets = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          NULL, triage_bucket_free);
+  triage.n_triaged = 0;
+  triage.n_failed = 0;
+
+  timer = g_timer_new ();
+
+  pool = g_thread_pool_new (triage_core, &triage, options->jobs, TRUE, NULL);
+  while ((name = g_dir_read_name (dir)))
+    {
+      char *core = g_build_filename (options->directory, name, NULL);
+      if (!g_file_test (core, G_FILE_TEST_IS_REGULAR))
+        {
+          g_free (core);
+          continue;
+        }
+      g_thread_pool_push (pool, core, NULL);
+    }
+  g_dir_close (dir);
+
+  /* Wait for all the queued cores to be processed */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  buckets = g_list_sort (g_hash_table_get_values (triage.buckets),
+                         compare_buckets);
+  for (l = buckets; l; l = l->next)
+    {
+      BoshTriageBucket *bucket = l->data;
+      g_print ("%6u %s\n", bucket->count, bucket->signature);
+      g_print ("       e.g. %s\n", bucket->example);
+    }
+  g_list_free (buckets);
+
+  g_print ("\n%u cores triaged (%u failed) into %u signatures "
+           "in %.1fs: %.1f cores/min\n",
+           triage.n_triaged, triage.n_failed,
+           g_hash_table_size (triage.buckets),
+           elapsed,
+           elapsed > 0 ? (triage.n_triaged + triage.n_failed) * 60 / elapsed
+                       : 0);
+
+  g_hash_table_destroy (triage.buckets);
+  g_mutex_free (triage.lock);
+
+  return triage.n_triaged ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+/*
+   Copyright (C) 2009 Robert Bragg
+
+   This file is part of Bosh
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef BOSH_TRIAGE_H
+#define BOSH_TRIAGE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BoshTriageOptions
+{
+  const char *directory;
+  const char *executable;
+
+  /* Number of cores loaded concurrently; <= 0 means one per CPU */
+  int jobs;
+  /* Number of innermost frames that make up a signature */
+  int depth;
+  /* Address space limit for each backend process, in MiB; 0 disables */
+  int mem_limit;
+} BoshTriageOptions;
+
+int bosh_triage_run (BoshTriageOptions *options);
+
+G_END_DECLS
+
+#endif /* BOSH_TRIAGE_H */
@@ -4,10 +4,16 @@
 
 #include <readline/readline.h>
 
+#include "cli-utils.h"
+
 #include "bosh-utils.h"
+#include "bosh-batch.h"
 #include "bosh-commands.h"
+#include "bosh-output.h"
 
-guint prompt_disable_count = 1;
+/* The prompt starts off disabled until main () enables it */
+static int prompt_disable_count = 1;
+static gboolean prompt_busy;
 
 char *
 bosh_utils_get_simplified_filename (GFile *file)
@@ -28,6 +34,19 @@ bosh_utils_get_simplified_filename (GFile *file)
   return g_file_get_uri (file);
 }
 
+/* Lines typed while the target runs, or while queued commands are
+ * still to run, are typed ahead rather than run.  Readline stays
+ * installed so they can be, but there's no prompt for them. */
+static const char *
+current_prompt (void)
+{
+  prompt_busy = bosh_batch_is_active () || bosh_target_is_busy ();
+  return prompt_busy ? "" : "(bosh) ";
+}
+
+/* Disabling the prompt removes readline altogether, so it must only be
+ * done while nothing is reading the terminal and each disable has to
+ * be paired with an enable before returning to the main loop. */
 void
 bosh_utils_disable_prompt (void)
 {
@@ -39,12 +58,34 @@ bosh_utils_disable_prompt (void)
 void
 bosh_utils_enable_prompt (void)
 {
+  g_return_if_fail (prompt_disable_count > 0);
+
   prompt_disable_count--;
+  if (prompt_disable_count == 0)
+    rl_callback_handler_install (current_prompt (), bosh_readline_cb);
+}
 
-  g_return_if_fail (prompt_disable_count >= 0);
+/* Shows or hides the prompt after the target starts or stops, or the
+ * queued commands have all been run */
+void
+bosh_utils_update_prompt (void)
+{
+  gboolean was_busy = prompt_busy;
+  const char *prompt;
+
+  if (prompt_disable_count > 0)
+    return;
 
-  if (prompt_disable_count == 0);
-    rl_callback_handler_install ("(bosh) ", bosh_readline_cb);
+  prompt = current_prompt ();
+  if (prompt_busy == was_busy)
+    return;
+
+  rl_set_prompt (prompt);
+  if (!prompt_busy)
+    {
+      rl_on_new_line ();
+      rl_redisplay ();
+    }
 }
 
 gboolean
@@ -54,12 +95,14 @@ bosh_utils_print_file_range (const char *uri, gint start, gint end)
   GFileInputStream *stream;
   GDataInputStream *data_stream;
   GError *error = NULL;
+  gboolean ret = TRUE;
   int i;
 
   if (!(stream = g_file_read (file, NULL, &error)))
     {
       g_print ("Failed to open source file %s: %s", uri, error->message);
       g_error_free (error);
+      g_object_unref (file);
       return FALSE;
     }
 
@@ -69,8 +112,9 @@ bosh_utils_print_file_range (const char *uri, gint start, gint end)
   g_data_input_stream_set_newline_type (data_stream,
                                         G_DATA_STREAM_NEWLINE_TYPE_ANY);
 
-  g_print ("\n");
-  for (i = 1; ; i++)
+  bosh_output_text ("\n");
+  bosh_output_begin_list ("source");
+  for (i = 1; !output_cancelled (); i++)
     {
       gsize len = 0;
       char *line =
@@ -78,17 +122,38 @@ bosh_utils_print_file_range (const char *uri, gint start, gint end)
       if (error)
         {
           g_print ("Error reading source file %s: %s\n", uri, error->message);
-          return FALSE;
+          g_error_free (error);
+          ret = FALSE;
+          break;
         }
       if (!line)
-        return FALSE;
+        {
+          ret = FALSE;
+          break;
+        }
       if (i >= start && i <=end)
-        g_print ("%-4d %s\n", i, line);
+        {
+          bosh_output_begin_record ("source-line");
+          bosh_output_field_fmt ("line", "%-4d", i);
+          bosh_output_text (" ");
+          bosh_output_field_string ("text", line);
+          bosh_output_text ("\n");
+          bosh_output_end_record ();
+        }
       else if (i > end)
-        break;
+        {
+          g_free (line);
+          break;
+        }
+      g_free (line);
     }
+  bosh_output_end_list ();
+
+  g_object_unref (data_stream);
+  g_object_unref (stream);
+  g_object_unref (file);
 
-  return TRUE;
+  return ret;
 }
 
 void
@@ -96,32 +161,43 @@ bosh_utils_print_frame (GSwatDebuggableFrame *frame)
 {
   GSwatDebuggableFrameArgument *arg;
   GList *l;
-  GString *args = g_string_new ("");
   GFile *source_file;
   char *short_filename;
 
   /* note: at this point the list is in reverse,
    * so the last in the list is our current frame
    */
-  g_print ("%d) %s (", frame->level, frame->function);
+  bosh_output_begin_record ("frame");
+  bosh_output_field_int ("level", frame->level);
+  bosh_output_text (") ");
+  bosh_output_field_string ("function", frame->function);
+  bosh_output_text (" (");
 
+  bosh_output_begin_list ("args");
   for(l = frame->arguments; l; l = l->next)
     {
       arg = l->data;
-      g_string_append_printf (args, "%s=%s, ", arg->name, arg->value);
+      bosh_output_begin_record ("arg");
+      bosh_output_field_string ("name", arg->name);
+      bosh_output_text ("=");
+      bosh_output_field_string ("value", arg->value);
+      bosh_output_end_record ();
+      if (l->next)
+        bosh_output_text (", ");
     }
-
-  if(args->str[args->len - 2] == ',')
-    args = g_string_truncate (args, args->len - 2);
+  bosh_output_end_list ();
 
   source_file = g_file_new_for_uri (frame->source_uri);
   short_filename = bosh_utils_get_simplified_filename (source_file);
   g_object_unref (source_file);
 
-  g_print ("%s) %s:%d\n", args->str, short_filename, frame->line);
+  bosh_output_text (") ");
+  bosh_output_field_string ("file", short_filename);
+  bosh_output_text (":");
+  bosh_output_field_int ("line", frame->line);
+  bosh_output_text ("\n");
+  bosh_output_end_record ();
   g_free (short_filename);
-
-  g_string_free (args, TRUE);
 }
 
 void
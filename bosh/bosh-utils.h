@@ -10,6 +10,7 @@ char *bosh_utils_get_simplified_filename (GFile *file);
 
 void bosh_utils_enable_prompt (void);
 void bosh_utils_disable_prompt (void);
+void bosh_utils_update_prompt (void);
 
 gboolean bosh_utils_print_file_range (const char *uri, gint start, gint end);
 
@@ -877,7 +877,7 @@ help_all (GIOChannel *stream)
   extern struct cmd_list_element *cmdlist;
   int seen_unclassified = 0;
 
-  for (c = cmdlist; c; c = c->next)
+  for (c = cmdlist; c && !output_cancelled (); c = c->next)
     {
       if (c->abbrev_flag)
         continue;
@@ -894,7 +894,7 @@ help_all (GIOChannel *stream)
      as a safety measure, we'll print commands outside of any
      class at the end.  */
 
-  for (c = cmdlist; c; c = c->next)
+  for (c = cmdlist; c && !output_cancelled (); c = c->next)
     {
       if (c->abbrev_flag)
         continue;
@@ -939,7 +939,7 @@ print_doc_line (GIOChannel *stream, char *str)
   line_buffer[p - str] = '\0';
   if (islower (line_buffer[0]))
     line_buffer[0] = toupper (line_buffer[0]);
-  g_print ("%s", line_buffer);
+  fputs_filtered (line_buffer, stream);
 }
 
 /* Print one-line help for command C.
@@ -984,7 +984,7 @@ help_cmd_list (struct cmd_list_element *list, enum command_class class,
 {
   struct cmd_list_element *c;
 
-  for (c = list; c; c = c->next)
+  for (c = list; c && !output_cancelled (); c = c->next)
     {
       if (c->abbrev_flag == 0 &&
           (class == all_commands
@@ -1039,6 +1039,11 @@ find_command_name_length (const char *text)
      used as a suffix for print, examine and display.
      Note that this is larger than the character set allowed when creating
      user-defined commands.  */
+  /* "|" is a command on its own, so "|bt|wc" works as well as
+     "| bt | wc".  */
+  if (*p == '|')
+    return 1;
+
   while (isalnum (*p) || *p == '-' || *p == '_' ||
          /* Characters used by TUI specific commands.  */
          *p == '+' || *p == '<' || *p == '>' || *p == '$')
@@ -70,6 +70,11 @@ cmd_types;
 #define DEPRECATED_WARN_USER      0x2
 #define MALLOCED_REPLACEMENT      0x4
 
+/* Set on commands that don't need the target to be stopped and don't
+   run other commands, so they can run straight away when typed while
+   the target is running instead of being queued.  */
+#define CMD_RUNS_WHILE_BUSY       0x8
+
 struct cmd_list_element
 {
   /* Points to next command in this list.  */
@@ -131,6 +136,8 @@ struct cmd_list_element
      undeprecated or re-deprecated at runtime we don't want to risk
      calling free on statically allocated memory, so we check this
      flag.
+
+     bit 3: CMD_RUNS_WHILE_BUSY, see above.
      */
   int flags;
 
@@ -278,7 +278,7 @@ do_setshow_command (char *arg, int from_tty, struct cmd_list_element *c)
             val = g_strdup (*(char **) c->var);
 	  break;
 	case var_boolean:
-          val = g_strdup (c->var ? "on" : "off");
+          val = g_strdup (*(int *) c->var ? "on" : "off");
 	  break;
 	case var_auto_boolean:
 	  switch (*(enum auto_boolean*) c->var)
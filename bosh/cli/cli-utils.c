@@ -20,20 +20,163 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include <glib.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <glib/gi18n.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 #include "cli-utils.h"
 
+/* Number of lines per page or UINT_MAX if paging is disabled.  0
+   means use the height of the terminal, which is the default.  */
+unsigned int lines_per_page;
+
+/* Nonzero means do pagination at all.  */
+int pagination_enabled = 1;
+
+/* Where we are on the current page.  */
+static unsigned int lines_printed;
+static unsigned int chars_printed;
+
+/* The size of the page for the current command, if it is paged.  */
+static int pager_active;
+static unsigned int page_height;
+static unsigned int page_width;
+
+/* Set when the rest of the output of the current command isn't
+   wanted, e.g. because the user typed "q" at the pager prompt.  */
+static int cancelled;
+
+/* Called at the start of each command.  Output is only paged for
+   commands typed at the terminal.  */
+
+void
+reinitialize_more_filter (int from_tty)
+{
+  struct winsize size;
+
+  lines_printed = 0;
+  chars_printed = 0;
+  cancelled = 0;
+
+  pager_active = (from_tty && pagination_enabled
+                  && lines_per_page != UINT_MAX
+                  && isatty (STDIN_FILENO) && isatty (STDOUT_FILENO));
+  if (!pager_active)
+    return;
+
+  /* Asking each time means we follow the terminal being resized */
+  if (ioctl (STDOUT_FILENO, TIOCGWINSZ, &size) != 0)
+    {
+      size.ws_row = 24;
+      size.ws_col = 80;
+    }
+  page_height = lines_per_page ? lines_per_page : size.ws_row;
+  page_width = size.ws_col ? size.ws_col : 80;
+  if (page_height < 2)
+    pager_active = 0;
+}
+
+/* Returns nonzero once the rest of the current command's output will
+   be thrown away.  Commands producing a lot of output should check
+   this and stop early, skipping any work (such as requests to the
+   backend) needed to produce the rest.  */
+
+int
+output_cancelled (void)
+{
+  return cancelled;
+}
+
+/* Stop the current command's output from being shown.  */
+
+void
+cancel_output (void)
+{
+  cancelled = 1;
+}
+
+static void
+prompt_for_continue (void)
+{
+  char c = '\0';
+  char first = '\0';
+  ssize_t n;
+
+  g_print (_("--Type <RET> for more, q to quit--"));
+
+  /* The readline handler is removed while a command runs, so the
+     terminal is back in its normal line mode here.  */
+  while ((n = read (STDIN_FILENO, &c, 1)) == 1 || (n < 0 && errno == EINTR))
+    {
+      if (n != 1)
+        continue;
+      if (c == '\n')
+        break;
+      if (!first && c != ' ' && c != '\t')
+        first = c;
+    }
+
+  if (n == 0 || first == 'q' || first == 'Q')
+    {
+      cancelled = 1;
+      g_print (_("Quit\n"));
+    }
+
+  lines_printed = 0;
+  chars_printed = 0;
+}
+
 void
 fputs_filtered (const char *linebuffer, GIOChannel *stream)
 {
+  const char *start = linebuffer;
+  const char *p;
+
+  if (cancelled)
+    return;
+
+  if (!pager_active)
+    {
+      g_print ("%s", linebuffer);
+      return;
+    }
+
+  for (p = linebuffer; *p; )
+    {
+      if (*p == '\n' || ++chars_printed >= page_width)
+        {
+          lines_printed++;
+          chars_printed = 0;
+        }
+      p++;
+
+      if (lines_printed >= page_height - 1)
+        {
+          g_print ("%.*s", (int)(p - start), start);
+          start = p;
+          prompt_for_continue ();
+          if (cancelled)
+            return;
+        }
+    }
+
+  if (*start)
+    g_print ("%s", start);
+}
+
 #if 0
+/* FIXME: The pager above replaced this, but it may be useful for
+   running output through an external pager in the future.  */
+static void
+external_pager (const char *linebuffer)
+{
   GError *error = NULL;
   gchar *less_argv[] = {
       "less",
@@ -82,9 +225,9 @@ fputs_filtered (const char *linebuffer, GIOChannel *stream)
       if (!(ret == -1 && errno == EINTR))
         break;
     }
-#endif
-  g_print ("%s", linebuffer);
 }
+#endif
+
 /* Print a variable number of ARGS using format FORMAT.  If this
    information is going to put the amount written (since the last call
    to REINITIALIZE_MORE_FILTER or the last page break) over the page size,
@@ -102,8 +245,14 @@ fputs_filtered (const char *linebuffer, GIOChannel *stream)
 void
 vfprintf_filtered (GIOChannel *stream, const char *format, va_list args)
 {
-  char *linebuffer = g_strdup_vprintf (format, args);
+  char *linebuffer;
+
+  if (cancelled)
+    return;
+
+  linebuffer = g_strdup_vprintf (format, args);
   fputs_filtered (linebuffer, stream);
+  g_free (linebuffer);
 }
 
 void
@@ -146,6 +295,15 @@ savestring (const char *ptr, size_t size)
 long long
 parse_and_eval_long (char *exp)
 {
+  char *end;
+  long long value = g_ascii_strtoll (exp, &end, 0);
+
+  /* Plain numbers are all the settings need for now */
+  while (*end == ' ' || *end == '\t')
+    end++;
+  if (end != exp && *end == '\0')
+    return value;
+
   g_warning ("FIXME: Get gswat to evaluate this as an expression");
   return 0;
 }
@@ -24,6 +24,19 @@
 
 #include <glib.h>
 
+extern unsigned int lines_per_page;
+
+extern int pagination_enabled;
+
+void
+reinitialize_more_filter (int from_tty);
+
+int
+output_cancelled (void);
+
+void
+cancel_output (void);
+
 void
 fputs_filtered (const char *linebuffer, GIOChannel *stream);
 
@@ -5,6 +5,8 @@
 char *bosh_readline_line_completion_function (const char *text,
                                               int matches);
 
+char **complete_line (const char *text, char *line_buffer, int point);
+
 char **noop_completer (char *, char *);
 
 char **filename_completer (char *, char *);
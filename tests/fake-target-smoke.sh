@@ -0,0 +1,54 @@
+#!/bin/sh
+# Drives bosh in --batch mode against the example scenario and checks
+# that it gets to the end cleanly, in both the text and JSON output
+# formats.
+#
+# BOSH is the bosh binary to test and srcdir where this script lives.
+
+: ${srcdir:=.}
+: ${BOSH:=../bosh/bosh}
+
+scenario="$srcdir/scenarios/simple.scenario"
+
+fail ()
+{
+  echo "FAIL: $1"
+  exit 1
+}
+
+# check NAME OUTPUT EXPECTED...
+check ()
+{
+  name=$1
+  output=$2
+  shift 2
+
+  for expected in "$@"; do
+    case "$output" in
+      *"$expected"*) ;;
+      *)
+        echo "$output"
+        fail "$name: no \"$expected\" in the output"
+        ;;
+    esac
+  done
+}
+
+output=`$BOSH --batch --fake-target "$scenario" \
+          --ex start \
+          --ex backtrace \
+          --ex next \
+          --ex next \
+          --ex "info inferiors" \
+          --ex continue \
+          --ex continue 2>&1` || fail "text: bosh exited with status $?"
+check text "$output" "compute" "main" "n=3" "simple.c"
+
+output=`$BOSH --batch --fake-target "$scenario" \
+          --ex start \
+          --ex "set output-format json" \
+          --ex backtrace \
+          --ex "info inferiors" 2>&1` || fail "json: bosh exited with status $?"
+check json "$output" '{"type":"frame"' '{"type":"inferior"'
+
+exit 0
@@ -0,0 +1,25 @@
+#include <stdio.h>
+
+/* The program that scenarios/simple.scenario pretends to be
+ * debugging.  It is never built, bosh only shows its source. */
+
+static int
+compute (int n)
+{
+  int total = 0;
+  int i;
+
+  for (i = 1; i <= n; i++)
+    total += i * i;
+
+  return total;
+}
+
+int
+main (int argc, char **argv)
+{
+  int result = compute (3);
+
+  printf ("%d\n", result);
+  return 0;
+}